@@ -1,6 +1,7 @@
 
 BINS= $(APP_BINDIR)/base_$(APP_NAME) $(APP_BINDIR)/cmusphinx_$(APP_NAME) \
-$(APP_BINDIR)/ffmpeg_$(APP_NAME) $(APP_BINDIR)/sqrwav_$(APP_NAME) $(APP_BINDIR)/membound_$(APP_NAME)
+$(APP_BINDIR)/ffmpeg_$(APP_NAME) $(APP_BINDIR)/sqrwav_$(APP_NAME) $(APP_BINDIR)/membound_$(APP_NAME) \
+$(APP_BINDIR)/replay_$(APP_NAME)
 
 PeSoRTA_apps: $(BINS)
 
@@ -16,12 +17,15 @@ $(APP_BINDIR)/cmusphinx_$(APP_NAME): $(APP_OBJS) libPeSoRTA
 	$(CC) $(APP_LIBFLAGS1) -L $(PeSoRTA_LIBDIR) -o $(APP_BINDIR)/cmusphinx_$(APP_NAME) \
 	$(APP_OBJS) $(APP_LIBFLAGS2) \
 	-lPeSoRTA_cmusphinx \
-	-lpocketsphinx -lsphinxad -lsphinxbase
+	-lpocketsphinx -lsphinxad -lsphinxbase -lpthread -lrt -luring \
+	-lavformat -lswresample -lswscale -lavcodec -lavfilter -lavutil \
+	-lmp3lame -lopencore-amrnb -lopus -lspeex -lvorbis -lvorbisenc -lvpx \
+	-lx264 -lz -lbz2 -lm
 
 $(APP_BINDIR)/ffmpeg_$(APP_NAME): $(APP_OBJS) libPeSoRTA
 	$(CC) $(APP_LIBFLAGS1) -L $(PeSoRTA_LIBDIR) -o $(APP_BINDIR)/ffmpeg_$(APP_NAME) \
 	$(APP_OBJS) $(APP_LIBFLAGS2) \
-	-lPeSoRTA_ffmpeg \
+	-lPeSoRTA_ffmpeg -lpthread -luring \
 	-lavformat -lswresample -lswscale -lavcodec -lavfilter -lavutil \
 	-lmp3lame -lopencore-amrnb -lopus -lspeex -lvorbis -lvorbisenc -lvpx \
 	-lx264 -lz -lbz2 -lm
@@ -30,12 +34,18 @@ $(APP_BINDIR)/sqrwav_$(APP_NAME): $(APP_OBJS) libPeSoRTA
 	$(CC) $(APP_LIBFLAGS1) -L $(PeSoRTA_LIBDIR) -o $(APP_BINDIR)/sqrwav_$(APP_NAME) \
 	$(APP_OBJS) $(APP_LIBFLAGS2) \
 	-lPeSoRTA_sqrwav \
-	-lrt
+	-lpthread -lrt -lm
 
 $(APP_BINDIR)/membound_$(APP_NAME): $(APP_OBJS) libPeSoRTA
 	$(CC) $(APP_LIBFLAGS1) -L $(PeSoRTA_LIBDIR) -o $(APP_BINDIR)/membound_$(APP_NAME) \
 	$(APP_OBJS) $(APP_LIBFLAGS2) \
 	-lPeSoRTA_membound
+
+$(APP_BINDIR)/replay_$(APP_NAME): $(APP_OBJS) libPeSoRTA
+	$(CC) $(APP_LIBFLAGS1) -L $(PeSoRTA_LIBDIR) -o $(APP_BINDIR)/replay_$(APP_NAME) \
+	$(APP_OBJS) $(APP_LIBFLAGS2) \
+	-lPeSoRTA_replay \
+	-lrt -lm
 	
 libPeSoRTA_clean:
 	$(MAKE) -C $(PeSoRTADIR) clean;
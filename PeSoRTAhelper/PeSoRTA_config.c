@@ -1,6 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "PeSoRTA_helper.h"
 
 int PeSoRTA_getconfigopt(FILE* filep, char *optstring, int *opt_p, char **optarg_p)
@@ -79,11 +85,270 @@ exit0:
     return ret;
 }
 
+/*
+    Single pass config loader
+
+    The config file is mapped privately (copy-on-write) and tokenized in place:
+    the end of every argument is overwritten with '\0', so string options point
+    directly into the mapping and no option needs a heap allocation. The mapping
+    is one byte longer than the file, so the last argument is terminated even if
+    the file does not end with a newline.
+
+    Every line is either empty, a comment starting with '#', or an option of the
+    schema ("-<opt> <argument>").
+*/
+
+static PeSoRTA_config_schema_t* PeSoRTA_config_find(PeSoRTA_config_schema_t *schema,
+                                                    int opt)
+{
+    for(; 0 != schema->opt; schema++)
+    {
+        if(opt == schema->opt)
+        {
+            return schema;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Convert optarg and store it in the destination of the entry. where is the
+    position of the argument ("file:line" or "default") used in error messages.
+*/
+static int PeSoRTA_config_set(PeSoRTA_config_schema_t *entry, char *optarg,
+                              const char *where)
+{
+    char        *endptr;
+    long long   value_ll = 0;
+    double      value = 0.0;
+
+    switch(entry->type)
+    {
+        case PeSoRTA_CONFIG_STRING:
+            *((char**)(entry->dest)) = optarg;
+            return 0;
+
+        case PeSoRTA_CONFIG_CALLBACK:
+            if(entry->callback(optarg, entry->dest) < 0)
+            {
+                fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: invalid argument "
+                                "\"%s\" of option -%c\n", where, optarg, entry->opt);
+                return -1;
+            }
+            return 0;
+
+        case PeSoRTA_CONFIG_INT32:
+        case PeSoRTA_CONFIG_INT64:
+            errno = 0;
+            value_ll = strtoll(optarg, &endptr, 0);
+            if( errno || (endptr == optarg) || ('\0' != *endptr) ||
+                ((PeSoRTA_CONFIG_INT32 == entry->type) &&
+                 ((value_ll < INT32_MIN) || (value_ll > INT32_MAX))))
+            {
+                fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: option -%c expects an "
+                                "integer, got \"%s\"\n", where, entry->opt, optarg);
+                return -1;
+            }
+            value = (double)value_ll;
+            break;
+
+        case PeSoRTA_CONFIG_DOUBLE:
+            errno = 0;
+            value = strtod(optarg, &endptr);
+            if(errno || (endptr == optarg) || ('\0' != *endptr))
+            {
+                fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: option -%c expects a "
+                                "number, got \"%s\"\n", where, entry->opt, optarg);
+                return -1;
+            }
+            break;
+    }
+
+    if((entry->min < entry->max) && ((value < entry->min) || (value > entry->max)))
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: argument \"%s\" of option -%c "
+                        "is out of range [%g, %g]\n", where, optarg, entry->opt,
+                        entry->min, entry->max);
+        return -1;
+    }
+
+    switch(entry->type)
+    {
+        case PeSoRTA_CONFIG_INT32:
+            *((int32_t*)(entry->dest)) = (int32_t)value_ll;
+            break;
+        case PeSoRTA_CONFIG_INT64:
+            *((int64_t*)(entry->dest)) = (int64_t)value_ll;
+            break;
+        default:
+            *((double*)(entry->dest)) = value;
+            break;
+    }
+
+    return 0;
+}
+
+/*Map the file with one extra zeroed byte after its end*/
+static int PeSoRTA_config_map(char *configfile_name, PeSoRTA_config_t *config_p,
+                              size_t *file_size_p)
+{
+    int         fd;
+    struct stat st;
+    char        *map;
+    size_t      map_size;
+
+    fd = open(configfile_name, O_RDONLY);
+    if(fd < 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_config_load) failed to open the config file "
+                        "\"%s\" ", configfile_name);
+        perror("");
+        goto error0;
+    }
+
+    if(0 != fstat(fd, &st))
+    {
+        perror("ERROR: PeSoRTA_config_load) fstat failed");
+        goto error1;
+    }
+    map_size = (size_t)st.st_size + 1;
+
+    /*reserve the whole range, then map the file over the start of it: the byte
+    after the file is zero, whether it lies in the last page of the file or in
+    the reserved page behind it*/
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == map)
+    {
+        perror("ERROR: PeSoRTA_config_load) mmap failed to reserve space");
+        goto error1;
+    }
+
+    if((st.st_size > 0) &&
+       (MAP_FAILED == mmap(map, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_FIXED, fd, 0)))
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_config_load) mmap failed to map the config file "
+                        "\"%s\" ", configfile_name);
+        perror("");
+        goto error2;
+    }
+
+    close(fd);
+
+    config_p->map = map;
+    config_p->map_size = map_size;
+    *file_size_p = (size_t)st.st_size;
+    return 0;
+
+error2:
+    munmap(map, map_size);
+error1:
+    close(fd);
+error0:
+    return -1;
+}
+
+int PeSoRTA_config_load(char *configfile_name, PeSoRTA_config_schema_t *schema,
+                        PeSoRTA_config_t *config_p)
+{
+    PeSoRTA_config_schema_t *entry;
+    size_t  file_size;
+    char    *line;
+    char    *end;
+    char    *next;
+    char    *optarg;
+    int     line_number;
+    char    where[64];
+
+    config_p->map = NULL;
+    config_p->map_size = 0;
+
+    /*apply the defaults*/
+    for(entry = schema; 0 != entry->opt; entry++)
+    {
+        if((NULL != entry->default_value) &&
+           (PeSoRTA_config_set(entry, entry->default_value, "default") < 0))
+        {
+            goto error0;
+        }
+    }
+
+    if(PeSoRTA_config_map(configfile_name, config_p, &file_size) < 0)
+    {
+        goto error0;
+    }
+    end = config_p->map + file_size;
+
+    for(line = config_p->map, line_number = 1; line < end; line = next, line_number++)
+    {
+        next = memchr(line, '\n', end - line);
+        next = (NULL == next)? end : next;
+        /*terminate the line (the byte after the file is already zero)*/
+        *next = '\0';
+        next++;
+
+        line = PeSoRTA_strtriml(line);
+        if(('\0' == line[0]) || ('#' == line[0]))
+        {
+            continue;
+        }
+
+        snprintf(where, sizeof(where), "%s:%i", configfile_name, line_number);
+        if(('-' != line[0]) || ('\0' == line[1]))
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: expected an option, got "
+                            "\"%s\"\n", where, line);
+            goto error1;
+        }
+
+        entry = PeSoRTA_config_find(schema, (int)line[1]);
+        if(NULL == entry)
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: unknown option -%c\n",
+                            where, line[1]);
+            goto error1;
+        }
+
+        optarg = PeSoRTA_strtriml(&line[2]);
+        if('\0' == optarg[0])
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_config_load) %s: option -%c needs an "
+                            "argument\n", where, entry->opt);
+            goto error1;
+        }
+        PeSoRTA_strtrimr(optarg);
+
+        if(PeSoRTA_config_set(entry, optarg, where) < 0)
+        {
+            goto error1;
+        }
+    }
+
+    return 0;
+
+error1:
+    PeSoRTA_config_unload(config_p);
+error0:
+    return -1;
+}
+
+void PeSoRTA_config_unload(PeSoRTA_config_t *config_p)
+{
+    if(NULL != config_p->map)
+    {
+        munmap(config_p->map, config_p->map_size);
+    }
+    config_p->map = NULL;
+    config_p->map_size = 0;
+}
+
 #ifdef TEST_PESORTA_CONFIG
 
 /*
 compile with the following:
- gcc -Wall -DTEST_PESORTA_STRING PeSoRTA_string.c -o test_PeSoRTA_string
+ gcc -Wall -DTEST_PESORTA_CONFIG PeSoRTA_config.c PeSoRTA_string.c -o test_PeSoRTA_config
 */
 
 int main(int argc, char **argv)
@@ -94,6 +359,20 @@ int main(int argc, char **argv)
     char *optstring = "abcdA:B:C:D:";
     int opt;
     char *optarg;
+
+    int32_t A;
+    double  B;
+    char    *C = NULL;
+    int64_t D;
+    PeSoRTA_config_t config;
+    PeSoRTA_config_schema_t schema[] =
+    {
+        {'A', PeSoRTA_CONFIG_INT32,  &A, "1",   0.0, 0.0,   NULL},
+        {'B', PeSoRTA_CONFIG_DOUBLE, &B, "0.5", 0.0, 1.0,   NULL},
+        {'C', PeSoRTA_CONFIG_STRING, &C, NULL,  0.0, 0.0,   NULL},
+        {'D', PeSoRTA_CONFIG_INT64,  &D, "0",   0.0, 100.0, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
         
     if(argc != 2)
     {
@@ -113,6 +392,11 @@ int main(int argc, char **argv)
     while(!feof(file))
     {
         ret = PeSoRTA_getconfigopt(file, optstring, &opt, &optarg);
+        if((ret == -1) && feof(file))
+        {
+            ret = 0;
+            break;
+        }
         if(ret == -1)
         {
             perror("PeSoRTA_getconfigopt failed in main");
@@ -140,6 +424,16 @@ int main(int argc, char **argv)
         }
     }
 
+    printf("\ntesting \"PeSoRTA_config_load\":\n");
+    if(PeSoRTA_config_load(argv[1], schema, &config) < 0)
+    {
+        ret = -1;
+        goto exit1;
+    }
+    printf("\tA = %i, B = %g, C = \"%s\", D = %lli\n",
+           A, B, (NULL == C)? "" : C, (long long)D);
+    PeSoRTA_config_unload(&config);
+
 exit1:
     fclose(file);
 exit0:
@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "PeSoRTA_helper.h"
+
+/*
+    The parts of the driver programs (workload_batch, workload_sweep) that run
+    the jobs of a workload and summarize their times
+*/
+
+uint64_t PeSoRTA_getns(void)
+{
+    struct timespec time;
+    int ret;
+    uint64_t now_ns;
+
+    ret = clock_gettime(CLOCK_MONOTONIC, &time);
+    if(ret == -1)
+    {
+        perror("clock_gettime failed");
+        exit(EXIT_FAILURE);
+    }
+
+    now_ns = time.tv_sec * 1000000000;
+    now_ns = now_ns + time.tv_nsec;
+
+    return now_ns;
+}
+
+static int PeSoRTA_compare_ns(const void *a, const void *b)
+{
+    uint64_t ns_a = *(const uint64_t*)a;
+    uint64_t ns_b = *(const uint64_t*)b;
+
+    return (ns_a > ns_b) - (ns_a < ns_b);
+}
+
+int PeSoRTA_set_realtime(void)
+{
+    struct sched_param sched_param;
+    int max_priority;
+
+    if(-1 == mlockall(MCL_CURRENT))
+    {
+        perror("ERROR: mlock failed in PeSoRTA_set_realtime");
+        return -1;
+    }
+
+    max_priority = sched_get_priority_max(SCHED_FIFO);
+    if(max_priority == -1)
+    {
+        perror("ERROR: sched_get_priority_max failed in PeSoRTA_set_realtime");
+        return -1;
+    }
+
+    sched_param.sched_priority = max_priority;
+    if(-1 == sched_setscheduler(getpid(), SCHED_FIFO, &sched_param))
+    {
+        fprintf(stderr, "ERROR: failed to set real-time priority!\n");
+        perror("ERROR: sched_setsceduler failed in PeSoRTA_set_realtime");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    Run and time up to maxjobs jobs, until job returns 1 (no more jobs) or -1
+    (an error, which is returned). The time of every job is written to log_mem,
+    and the number of jobs that completed to jobs_p.
+*/
+int PeSoRTA_run_jobs(   PeSoRTA_job_t   job,
+                        void            *workload_state,
+                        long            maxjobs,
+                        uint64_t        *log_mem,
+                        long            *jobs_p)
+{
+    int ret = 0;
+    long jobi;
+    uint64_t ns_start, ns_end;
+
+    for(jobi = 0; jobi < maxjobs; jobi++)
+    {
+        /*run and time the next job*/
+        ns_start = PeSoRTA_getns();
+        ret = job(workload_state);
+        ns_end = PeSoRTA_getns();
+
+        if(ret != 0)
+        {
+            /*an error, or no more jobs to perform*/
+            break;
+        }
+
+        log_mem[jobi] = ns_end - ns_start;
+    }
+
+    *jobs_p = jobi;
+    return (ret < 0)? -1 : 0;
+}
+
+/*
+    Sort the job times of log_mem, and summarize them in stats_p
+*/
+void PeSoRTA_summarize_jobs(uint64_t            *log_mem,
+                            long                jobs,
+                            PeSoRTA_job_stats_t *stats_p)
+{
+    long jobi;
+
+    memset(stats_p, 0, sizeof(PeSoRTA_job_stats_t));
+    stats_p->jobs = jobs;
+    if(jobs <= 0)
+    {
+        return;
+    }
+
+    qsort(log_mem, jobs, sizeof(uint64_t), PeSoRTA_compare_ns);
+    for(jobi = 0; jobi < jobs; jobi++)
+    {
+        stats_p->total_ns += log_mem[jobi];
+    }
+    stats_p->min_ns = log_mem[0];
+    stats_p->p50_ns = log_mem[(jobs - 1)/2];
+    stats_p->p99_ns = log_mem[((jobs - 1)*99)/100];
+    stats_p->max_ns = log_mem[jobs - 1];
+}
+
+/*
+    Fork worker_count worker processes which all call worker(arg), worker i is
+    pinned to the ith cpu of the affinity mask (wrapping around) if pin is set,
+    and runs with real-time priority if rflag is set. Returns -1 if a worker
+    could not be started or did not exit successfully.
+*/
+int PeSoRTA_run_workers(PeSoRTA_worker_t    worker,
+                        void                *arg,
+                        unsigned char       rflag,
+                        int                 worker_count,
+                        unsigned char       pin)
+{
+    int         ret = 0;
+    int         i;
+    int         cpu;
+    int         cpu_count = 0;
+    int         allowed_cpus[CPU_SETSIZE];
+    cpu_set_t   mask;
+    pid_t       pid;
+    int         status;
+
+    if(0 != sched_getaffinity(0, sizeof(cpu_set_t), &mask))
+    {
+        perror("ERROR: PeSoRTA_run_workers) sched_getaffinity failed");
+        return -1;
+    }
+    for(cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if(CPU_ISSET(cpu, &mask))
+        {
+            allowed_cpus[cpu_count++] = cpu;
+        }
+    }
+
+    /*the workers must not repeat what is still buffered*/
+    fflush(stdout);
+    fflush(stderr);
+
+    for(i = 0; i < worker_count; i++)
+    {
+        pid = fork();
+        if(pid < 0)
+        {
+            perror("ERROR: PeSoRTA_run_workers) fork failed");
+            ret = -1;
+            break;
+        }
+
+        if(0 == pid)
+        {
+            if(pin)
+            {
+                CPU_ZERO(&mask);
+                CPU_SET(allowed_cpus[i % cpu_count], &mask);
+                if(0 != sched_setaffinity(0, sizeof(cpu_set_t), &mask))
+                {
+                    fprintf(stderr, "WARNING: PeSoRTA_run_workers) failed to pin "
+                                    "worker %i to cpu %i\n", i,
+                                    allowed_cpus[i % cpu_count]);
+                }
+            }
+
+            if((rflag == 1) && (PeSoRTA_set_realtime() < 0))
+            {
+                _exit(EXIT_FAILURE);
+            }
+
+            worker(arg);
+            fflush(stdout);
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    /*wait for all the workers, what a crashed worker claimed is left undone*/
+    while((pid = wait(&status)) > 0)
+    {
+        if(!WIFEXITED(status) || (EXIT_SUCCESS != WEXITSTATUS(status)))
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_run_workers) worker %i failed\n", (int)pid);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
@@ -2,6 +2,7 @@
 #define PeSoRTA_HELPER_INCLUDE
 
 #include <stdio.h>
+#include <stdint.h>
 
 /*** PeSoRTA_string ***/
 char* PeSoRTA_strappend(char* dest, char *src);
@@ -15,8 +16,120 @@ int PeSoRTA_strappendprintf_safe(char **dest_p, const char *format, ...);
 /*** PeSoRTA_config ***/
 int   PeSoRTA_getconfigopt(FILE* filep, char *optstring, int *opt_p, char **optarg_p);
 
+typedef enum
+{
+    PeSoRTA_CONFIG_INT32 = 0,   /*dest is an int32_t*/
+    PeSoRTA_CONFIG_INT64,       /*dest is an int64_t*/
+    PeSoRTA_CONFIG_DOUBLE,      /*dest is a double*/
+    PeSoRTA_CONFIG_STRING,      /*dest is a char*, pointing into the loaded file*/
+    PeSoRTA_CONFIG_CALLBACK     /*callback(optarg, dest) is called for every occurrence*/
+} PeSoRTA_config_type_t;
+
+/*returns <0 if optarg is not a valid argument*/
+typedef int (*PeSoRTA_config_callback_t)(char *optarg, void *dest);
+
+/*
+    One entry of the option table of a workload. The default is parsed like an
+    argument in the config file before the file is read (NULL leaves dest
+    untouched). Numeric values must lie in [min, max], unless min >= max.
+    The table ends with an entry whose opt is 0.
+*/
+typedef struct PeSoRTA_config_schema_s
+{
+    int                         opt;
+    PeSoRTA_config_type_t       type;
+    void                        *dest;
+    char                        *default_value;
+    double                      min;
+    double                      max;
+    PeSoRTA_config_callback_t   callback;
+} PeSoRTA_config_schema_t;
+
+#define PeSoRTA_CONFIG_SCHEMA_END {0, PeSoRTA_CONFIG_INT32, NULL, NULL, 0.0, 0.0, NULL}
+
+/*the loaded config file, string options point into it until it is unloaded*/
+typedef struct PeSoRTA_config_s
+{
+    char    *map;
+    size_t  map_size;
+} PeSoRTA_config_t;
+
+int   PeSoRTA_config_load(char *configfile_name, PeSoRTA_config_schema_t *schema,
+                          PeSoRTA_config_t *config_p);
+void  PeSoRTA_config_unload(PeSoRTA_config_t *config_p);
+
+/*** PeSoRTA_sweep ***/
+#define PeSoRTA_SWEEP_MAX_AXES      (16)
+#define PeSoRTA_SWEEP_MAX_VALUES    (64)
+
+/*one swept option, either a range or a list of values*/
+typedef struct PeSoRTA_sweep_axis_s
+{
+    int32_t line;
+    int     opt;
+    int32_t value_count;
+
+    int     is_list;
+    char    *items[PeSoRTA_SWEEP_MAX_VALUES];
+
+    int     is_integer;
+    int     is_geometric;
+    double  start;
+    double  stop;
+    double  step;
+} PeSoRTA_sweep_axis_t;
+
+typedef struct PeSoRTA_sweep_s
+{
+    char    *text;
+    char    **lines;
+    int32_t line_count;
+
+    PeSoRTA_sweep_axis_t axes[PeSoRTA_SWEEP_MAX_AXES];
+    int32_t axis_count;
+    int64_t point_count;
+} PeSoRTA_sweep_t;
+
+int  PeSoRTA_sweep_load(char *configfile_name, PeSoRTA_sweep_t *sweep_p);
+int  PeSoRTA_sweep_value(PeSoRTA_sweep_t *sweep_p, int32_t axis, int64_t point,
+                         char *value, size_t value_size);
+int  PeSoRTA_sweep_write(PeSoRTA_sweep_t *sweep_p, int64_t point, FILE *filep);
+void PeSoRTA_sweep_free(PeSoRTA_sweep_t *sweep_p);
+
 /*** PeSoRTA_vector ***/
 int PeSoRTA_vector_writeCSVF(char* fileName, int32_t input_size, double* data);
 int PeSoRTA_vector_readCSVF(char* fileName, int32_t *input_size_p, double* *data_p);
 
+/*** PeSoRTA_pool ***/
+typedef struct PeSoRTA_pool_s PeSoRTA_pool_t;
+typedef int (*PeSoRTA_pool_task_t)(void *arg, int32_t index);
+int PeSoRTA_pool_init(PeSoRTA_pool_t **pool_p, int32_t worker_count, int pin);
+int PeSoRTA_pool_run(PeSoRTA_pool_t *pool, PeSoRTA_pool_task_t task, void *arg,
+                     int32_t task_count);
+void PeSoRTA_pool_free(PeSoRTA_pool_t **pool_p);
+
+/*** PeSoRTA_driver ***/
+/*the job time statistics of one run of a workload*/
+typedef struct PeSoRTA_job_stats_s
+{
+    long        jobs;
+    uint64_t    total_ns;
+    uint64_t    min_ns;
+    uint64_t    p50_ns;
+    uint64_t    p99_ns;
+    uint64_t    max_ns;
+} PeSoRTA_job_stats_t;
+
+/*perform_job of the workload*/
+typedef int (*PeSoRTA_job_t)(void *workload_state);
+typedef void (*PeSoRTA_worker_t)(void *arg);
+
+uint64_t PeSoRTA_getns(void);
+int  PeSoRTA_set_realtime(void);
+int  PeSoRTA_run_jobs(PeSoRTA_job_t job, void *workload_state, long maxjobs,
+                      uint64_t *log_mem, long *jobs_p);
+void PeSoRTA_summarize_jobs(uint64_t *log_mem, long jobs, PeSoRTA_job_stats_t *stats_p);
+int  PeSoRTA_run_workers(PeSoRTA_worker_t worker, void *arg, unsigned char rflag,
+                         int worker_count, unsigned char pin);
+
 #endif
@@ -0,0 +1,276 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "PeSoRTA_helper.h"
+
+/*
+    A pool of pinned worker threads that spin (rather than block) while waiting
+    for work, so that handing a batch of tasks to the workers inside a job costs
+    no system calls. The calling thread takes part in every batch, so a pool of
+    worker_count threads runs worker_count + 1 tasks in parallel.
+*/
+
+/*next_task value between batches, large enough to stop any claim*/
+#define PeSoRTA_POOL_CLOSED (INT32_MAX/2)
+
+struct PeSoRTA_pool_s
+{
+    int32_t     worker_count;
+    pthread_t   *threads;
+    int         *cpus;
+
+    /*the current batch, published by incrementing generation*/
+    PeSoRTA_pool_task_t task;
+    void                *arg;
+    int32_t             task_count;
+    int32_t             next_task;
+    int32_t             done_tasks;
+    int32_t             failed_tasks;
+    uint32_t            generation;
+
+    int32_t             stop;
+};
+
+typedef struct PeSoRTA_pool_worker_s
+{
+    PeSoRTA_pool_t  *pool;
+    int32_t         index;
+} PeSoRTA_pool_worker_t;
+
+/*spins before a waiting thread yields the cpu, which only happens when there
+are more threads than cpus*/
+#define PeSoRTA_POOL_SPINS (4096)
+
+static inline void PeSoRTA_pool_relax(uint32_t *spins_p)
+{
+    if(++(*spins_p) >= PeSoRTA_POOL_SPINS)
+    {
+        *spins_p = 0;
+        sched_yield();
+        return;
+    }
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*Claim and run tasks of the current batch until there are none left*/
+static void PeSoRTA_pool_drain(PeSoRTA_pool_t *pool)
+{
+    int32_t index;
+
+    while(1)
+    {
+        index = __atomic_fetch_add(&(pool->next_task), 1, __ATOMIC_ACQ_REL);
+        if(index >= pool->task_count)
+        {
+            break;
+        }
+
+        if(pool->task(pool->arg, index) < 0)
+        {
+            __atomic_fetch_add(&(pool->failed_tasks), 1, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_add(&(pool->done_tasks), 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void* PeSoRTA_pool_worker(void *arg)
+{
+    PeSoRTA_pool_t  *pool = ((PeSoRTA_pool_worker_t*)arg)->pool;
+    int32_t         index = ((PeSoRTA_pool_worker_t*)arg)->index;
+    uint32_t        seen = 0;
+    uint32_t        generation;
+    uint32_t        spins = 0;
+    cpu_set_t       cpu_mask;
+
+    free(arg);
+
+    if(pool->cpus[index] >= 0)
+    {
+        CPU_ZERO(&cpu_mask);
+        CPU_SET(pool->cpus[index], &cpu_mask);
+        if(0 != pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_mask))
+        {
+            fprintf(stderr, "WARNING: PeSoRTA_pool_worker) failed to pin worker %i to "
+                            "cpu %i\n", index, pool->cpus[index]);
+        }
+    }
+
+    while(1)
+    {
+        generation = __atomic_load_n(&(pool->generation), __ATOMIC_ACQUIRE);
+        if(generation == seen)
+        {
+            if(__atomic_load_n(&(pool->stop), __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+            PeSoRTA_pool_relax(&spins);
+            continue;
+        }
+
+        seen = generation;
+        spins = 0;
+        PeSoRTA_pool_drain(pool);
+    }
+
+    return NULL;
+}
+
+/*
+    Start worker_count workers. If pin is set, worker i is pinned to the
+    (i+1)th cpu of the affinity mask of the caller (wrapping around), which
+    leaves the first cpu to the calling thread.
+*/
+int PeSoRTA_pool_init(PeSoRTA_pool_t **pool_p, int32_t worker_count, int pin)
+{
+    int ret;
+    int32_t i;
+    int cpu;
+    int cpu_count = 0;
+    int *allowed_cpus = NULL;
+    cpu_set_t original_mask;
+    PeSoRTA_pool_t *pool;
+    PeSoRTA_pool_worker_t *worker;
+
+    pool = (PeSoRTA_pool_t*)calloc(1, sizeof(PeSoRTA_pool_t));
+    if(NULL == pool)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_pool_init) calloc failed to allocate a "
+                        "PeSoRTA_pool_t object\n");
+        goto error0;
+    }
+    pool->next_task = PeSoRTA_POOL_CLOSED;
+
+    pool->threads = (pthread_t*)calloc((worker_count > 0)? worker_count : 1,
+                                        sizeof(pthread_t));
+    pool->cpus = (int*)calloc((worker_count > 0)? worker_count : 1, sizeof(int));
+    allowed_cpus = (int*)calloc(CPU_SETSIZE, sizeof(int));
+    if((NULL == pool->threads) || (NULL == pool->cpus) || (NULL == allowed_cpus))
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_pool_init) calloc failed to allocate the "
+                        "worker arrays\n");
+        goto error1;
+    }
+
+    if(pin)
+    {
+        if(0 != sched_getaffinity(0, sizeof(cpu_set_t), &original_mask))
+        {
+            perror("ERROR: PeSoRTA_pool_init) sched_getaffinity failed");
+            goto error1;
+        }
+        for(cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if(CPU_ISSET(cpu, &original_mask))
+            {
+                allowed_cpus[cpu_count++] = cpu;
+            }
+        }
+    }
+
+    for(i = 0; i < worker_count; i++)
+    {
+        pool->cpus[i] = (cpu_count > 0)? allowed_cpus[(i + 1) % cpu_count] : -1;
+    }
+
+    for(pool->worker_count = 0; pool->worker_count < worker_count; pool->worker_count++)
+    {
+        worker = (PeSoRTA_pool_worker_t*)malloc(sizeof(PeSoRTA_pool_worker_t));
+        if(NULL == worker)
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_pool_init) malloc failed\n");
+            goto error2;
+        }
+        worker->pool = pool;
+        worker->index = pool->worker_count;
+
+        ret = pthread_create(   &(pool->threads[pool->worker_count]),
+                                NULL,
+                                PeSoRTA_pool_worker,
+                                worker);
+        if(0 != ret)
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_pool_init) pthread_create failed (%s)\n",
+                            strerror(ret));
+            free(worker);
+            goto error2;
+        }
+    }
+
+    free(allowed_cpus);
+    *pool_p = pool;
+    return 0;
+
+error2:
+    PeSoRTA_pool_free(&pool);
+    goto error0;
+error1:
+    free(allowed_cpus);
+    free(pool->cpus);
+    free(pool->threads);
+    free(pool);
+error0:
+    *pool_p = NULL;
+    return -1;
+}
+
+/*
+    Run task(arg, i) for i = 0 .. task_count-1 on the workers and the calling
+    thread, and return once all of them are done. Returns -1 if any task failed.
+*/
+int PeSoRTA_pool_run(PeSoRTA_pool_t *pool, PeSoRTA_pool_task_t task, void *arg,
+                     int32_t task_count)
+{
+    uint32_t spins = 0;
+
+    pool->task = task;
+    pool->arg = arg;
+    pool->task_count = task_count;
+    pool->done_tasks = 0;
+    pool->failed_tasks = 0;
+    __atomic_store_n(&(pool->next_task), 0, __ATOMIC_RELEASE);
+
+    /*publish the batch*/
+    __atomic_fetch_add(&(pool->generation), 1, __ATOMIC_RELEASE);
+
+    PeSoRTA_pool_drain(pool);
+
+    while(__atomic_load_n(&(pool->done_tasks), __ATOMIC_ACQUIRE) < task_count)
+    {
+        PeSoRTA_pool_relax(&spins);
+    }
+
+    /*workers that are still draining must not claim tasks of the next batch
+    before it is set up*/
+    __atomic_store_n(&(pool->next_task), PeSoRTA_POOL_CLOSED, __ATOMIC_RELEASE);
+
+    return (0 == pool->failed_tasks)? 0 : -1;
+}
+
+void PeSoRTA_pool_free(PeSoRTA_pool_t **pool_p)
+{
+    PeSoRTA_pool_t *pool = *pool_p;
+    int32_t i;
+
+    if(NULL == pool)
+    {
+        return;
+    }
+
+    __atomic_store_n(&(pool->stop), 1, __ATOMIC_RELEASE);
+    for(i = 0; i < pool->worker_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    free(pool->cpus);
+    free(pool->threads);
+    free(pool);
+    *pool_p = NULL;
+}
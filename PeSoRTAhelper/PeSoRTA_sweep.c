@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "PeSoRTA_helper.h"
+
+/*
+    Parameter sweeps over config files
+
+    A sweep config file is a workload config file in which the argument of any
+    option may be a set of values instead of a single value:
+        -b 300000..2000000:x2   geometric range (start..stop:xfactor)
+        -g 10..60:+10           arithmetic range (start..stop:+step, or :step)
+        -w 1..4                 arithmetic range with a step of 1
+        -g {10,30,60}           list of values (any text without ',')
+    The sweep is the cartesian product of all the sets (the last one varies the
+    fastest). Every point of the sweep is a plain config file, in which each set
+    is replaced by one of its values.
+*/
+
+/*Split the file into lines, in place*/
+static int PeSoRTA_sweep_split(PeSoRTA_sweep_t *sweep_p, size_t text_length)
+{
+    size_t  i;
+    int32_t line_count = 1;
+
+    for(i = 0; i < text_length; i++)
+    {
+        line_count += ('\n' == sweep_p->text[i]);
+    }
+
+    sweep_p->lines = (char**)calloc(line_count, sizeof(char*));
+    if(NULL == sweep_p->lines)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_sweep_load) calloc failed to allocate the "
+                        "line array\n");
+        return -1;
+    }
+
+    sweep_p->line_count = 0;
+    sweep_p->lines[sweep_p->line_count++] = sweep_p->text;
+    for(i = 0; i < text_length; i++)
+    {
+        if('\n' == sweep_p->text[i])
+        {
+            sweep_p->text[i] = '\0';
+            sweep_p->lines[sweep_p->line_count++] = &(sweep_p->text[i + 1]);
+        }
+    }
+
+    return 0;
+}
+
+/*
+    Parse one number of a range, the number must be followed by one of the
+    characters in terminators or the end of the string
+*/
+static int PeSoRTA_sweep_number(char **str_p, char *terminators, double *value_p,
+                                int *is_integer_p)
+{
+    char *endptr;
+
+    errno = 0;
+    *value_p = strtod(*str_p, &endptr);
+    if(errno || (endptr == *str_p) || (NULL == strchr(terminators, *endptr)))
+    {
+        return -1;
+    }
+
+    /*the value is kept as an integer, unless the text is not*/
+    if(NULL != memchr(*str_p, '.', endptr - *str_p) ||
+       NULL != memchr(*str_p, 'e', endptr - *str_p) ||
+       NULL != memchr(*str_p, 'E', endptr - *str_p))
+    {
+        *is_integer_p = 0;
+    }
+
+    *str_p = endptr;
+    return 0;
+}
+
+/*
+    Parse a range "start..stop[:[x|+]step]", returns 1 if the argument is a
+    range, 0 if it is not and -1 if it is an empty or endless range
+*/
+static int PeSoRTA_sweep_range(char *arg, PeSoRTA_sweep_axis_t *axis_p)
+{
+    char    *str = arg;
+    char    *dots;
+    double  value;
+    double  tolerance;
+    int     is_integer = 1;
+    int     ret;
+
+    axis_p->is_geometric = 0;
+    axis_p->step = 1.0;
+
+    /*strtod would take the first '.' of ".." as the decimal point of start*/
+    dots = strstr(arg, "..");
+    if(NULL == dots)
+    {
+        return 0;
+    }
+    *dots = '\0';
+    ret = PeSoRTA_sweep_number(&str, "", &(axis_p->start), &is_integer);
+    *dots = '.';
+    if(ret < 0)
+    {
+        return 0;
+    }
+    str = dots + 2;
+
+    if(PeSoRTA_sweep_number(&str, ":", &(axis_p->stop), &is_integer) < 0)
+    {
+        return 0;
+    }
+
+    if(':' == *str)
+    {
+        str++;
+        if(('x' == *str) || ('*' == *str))
+        {
+            axis_p->is_geometric = 1;
+            str++;
+        }
+        else if('+' == *str)
+        {
+            str++;
+        }
+
+        if(PeSoRTA_sweep_number(&str, "", &(axis_p->step), &is_integer) < 0)
+        {
+            return 0;
+        }
+    }
+    axis_p->is_integer = is_integer;
+
+    if( (axis_p->stop < axis_p->start) ||
+        ((0 == axis_p->is_geometric) && (axis_p->step <= 0.0)) ||
+        ((0 != axis_p->is_geometric) && ((axis_p->step <= 1.0) ||
+                                         (axis_p->start <= 0.0))))
+    {
+        return -1;
+    }
+
+    /*count the values, allowing for rounding errors at the stop value*/
+    tolerance = 1e-9 * ((axis_p->stop < 0.0)? -axis_p->stop : axis_p->stop);
+    axis_p->value_count = 0;
+    value = axis_p->start;
+    while(value <= axis_p->stop + tolerance)
+    {
+        if(axis_p->value_count >= PeSoRTA_SWEEP_MAX_VALUES)
+        {
+            return -1;
+        }
+        axis_p->value_count++;
+        value = (axis_p->is_geometric)? (value * axis_p->step) :
+                                        (axis_p->start +
+                                            axis_p->step * axis_p->value_count);
+    }
+
+    return 1;
+}
+
+/*Parse a list "{a,b,c}", in place, returns 1 if the argument is a list*/
+static int PeSoRTA_sweep_list(char *arg, PeSoRTA_sweep_axis_t *axis_p)
+{
+    size_t  length = strlen(arg);
+    char    *item;
+    int32_t i;
+
+    if((length < 2) || ('{' != arg[0]) || ('}' != arg[length - 1]))
+    {
+        return 0;
+    }
+    arg[length - 1] = '\0';
+
+    axis_p->value_count = 0;
+    item = &(arg[1]);
+    while(1)
+    {
+        if(axis_p->value_count >= PeSoRTA_SWEEP_MAX_VALUES)
+        {
+            return -1;
+        }
+        axis_p->items[axis_p->value_count++] = PeSoRTA_strtriml(item);
+
+        item = strchr(item, ',');
+        if(NULL == item)
+        {
+            break;
+        }
+        *item = '\0';
+        item++;
+    }
+
+    for(i = 0; i < axis_p->value_count; i++)
+    {
+        if('\0' != axis_p->items[i][0])
+        {
+            PeSoRTA_strtrimr(axis_p->items[i]);
+        }
+    }
+
+    return 1;
+}
+
+int PeSoRTA_sweep_load(char *configfile_name, PeSoRTA_sweep_t *sweep_p)
+{
+    FILE    *filep;
+    long    text_length;
+    int32_t i;
+    char    *line;
+    char    *arg;
+    int     ret;
+    PeSoRTA_sweep_axis_t *axis_p;
+
+    memset(sweep_p, 0, sizeof(PeSoRTA_sweep_t));
+
+    /*read the whole file*/
+    filep = fopen(configfile_name, "r");
+    if(NULL == filep)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_sweep_load) failed to open the config file "
+                        "\"%s\" ", configfile_name);
+        perror("");
+        goto error0;
+    }
+
+    if((0 != fseek(filep, 0, SEEK_END)) || ((text_length = ftell(filep)) < 0) ||
+       (0 != fseek(filep, 0, SEEK_SET)))
+    {
+        perror("ERROR: PeSoRTA_sweep_load) failed to get the size of the config file");
+        goto error1;
+    }
+
+    sweep_p->text = (char*)malloc(text_length + 1);
+    if(NULL == sweep_p->text)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_sweep_load) malloc failed to allocate %li "
+                        "bytes\n", text_length + 1);
+        goto error1;
+    }
+
+    if(fread(sweep_p->text, 1, text_length, filep) != (size_t)text_length)
+    {
+        perror("ERROR: PeSoRTA_sweep_load) fread failed");
+        goto error2;
+    }
+    sweep_p->text[text_length] = '\0';
+    fclose(filep);
+    filep = NULL;
+
+    if(PeSoRTA_sweep_split(sweep_p, (size_t)text_length) < 0)
+    {
+        goto error2;
+    }
+
+    /*find the sets of values*/
+    sweep_p->point_count = 1;
+    for(i = 0; i < sweep_p->line_count; i++)
+    {
+        line = PeSoRTA_strtriml(sweep_p->lines[i]);
+        if(('-' != line[0]) || ('\0' == line[1]))
+        {
+            continue;
+        }
+
+        arg = PeSoRTA_strtriml(&line[2]);
+        if('\0' == arg[0])
+        {
+            continue;
+        }
+        PeSoRTA_strtrimr(arg);
+
+        if(sweep_p->axis_count >= PeSoRTA_SWEEP_MAX_AXES)
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_sweep_load) %s:%i: more than %i swept "
+                            "options\n", configfile_name, i + 1, PeSoRTA_SWEEP_MAX_AXES);
+            goto error3;
+        }
+        axis_p = &(sweep_p->axes[sweep_p->axis_count]);
+        memset(axis_p, 0, sizeof(PeSoRTA_sweep_axis_t));
+
+        axis_p->is_list = 1;
+        ret = PeSoRTA_sweep_list(arg, axis_p);
+        if(0 == ret)
+        {
+            axis_p->is_list = 0;
+            ret = PeSoRTA_sweep_range(arg, axis_p);
+        }
+
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: PeSoRTA_sweep_load) %s:%i: \"%s\" is not a valid "
+                            "set of values (at most %i values)\n", configfile_name, i + 1,
+                            arg, PeSoRTA_SWEEP_MAX_VALUES);
+            goto error3;
+        }
+        if(0 == ret)
+        {
+            continue;
+        }
+
+        /*the line is written as its prefix ("-b ") followed by the value*/
+        axis_p->line = i;
+        axis_p->opt = (int)line[1];
+        arg[0] = '\0';
+        sweep_p->point_count *= axis_p->value_count;
+        sweep_p->axis_count++;
+    }
+
+    return 0;
+
+error3:
+    free(sweep_p->lines);
+error2:
+    free(sweep_p->text);
+error1:
+    if(NULL != filep)
+    {
+        fclose(filep);
+    }
+error0:
+    memset(sweep_p, 0, sizeof(PeSoRTA_sweep_t));
+    return -1;
+}
+
+int PeSoRTA_sweep_value(PeSoRTA_sweep_t *sweep_p, int32_t axis, int64_t point,
+                        char *value, size_t value_size)
+{
+    PeSoRTA_sweep_axis_t *axis_p = &(sweep_p->axes[axis]);
+    int64_t stride = 1;
+    int32_t i;
+    int32_t index;
+    double  number;
+
+    for(i = axis + 1; i < sweep_p->axis_count; i++)
+    {
+        stride *= sweep_p->axes[i].value_count;
+    }
+    index = (int32_t)((point / stride) % axis_p->value_count);
+
+    if(axis_p->is_list)
+    {
+        return snprintf(value, value_size, "%s", axis_p->items[index]);
+    }
+
+    number = axis_p->start;
+    if(axis_p->is_geometric)
+    {
+        for(i = 0; i < index; i++)
+        {
+            number *= axis_p->step;
+        }
+    }
+    else
+    {
+        number += axis_p->step * index;
+    }
+
+    if(axis_p->is_integer)
+    {
+        return snprintf(value, value_size, "%lli",
+                        (long long)((number < 0.0)? (number - 0.5) : (number + 0.5)));
+    }
+
+    return snprintf(value, value_size, "%.10g", number);
+}
+
+int PeSoRTA_sweep_write(PeSoRTA_sweep_t *sweep_p, int64_t point, FILE *filep)
+{
+    int32_t i;
+    int32_t axis = 0;
+    char    value[256];
+
+    for(i = 0; i < sweep_p->line_count; i++)
+    {
+        if((axis < sweep_p->axis_count) && (sweep_p->axes[axis].line == i))
+        {
+            PeSoRTA_sweep_value(sweep_p, axis, point, value, sizeof(value));
+            if(fprintf(filep, "%s%s\n", sweep_p->lines[i], value) < 0)
+            {
+                return -1;
+            }
+            axis++;
+        }
+        else if(fprintf(filep, "%s\n", sweep_p->lines[i]) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void PeSoRTA_sweep_free(PeSoRTA_sweep_t *sweep_p)
+{
+    free(sweep_p->lines);
+    free(sweep_p->text);
+    memset(sweep_p, 0, sizeof(PeSoRTA_sweep_t));
+}
@@ -25,74 +25,25 @@ char *workload_name(void)
 static int PeSoRTA_base_parse_config(  char *configfile_name, 
                                        int32_t *job_count)
 {
-    int ret = 0;
-    FILE *configfile_p;
-
-	/*parsing variables*/
-    char *optstring = "J:";
-    int  opt;
-    char *optarg;
+    int ret;
+    PeSoRTA_config_t config;
 
-    /*Open the config file*/
-    configfile_p = fopen(configfile_name, "r");
-    if(NULL == configfile_p)
+    PeSoRTA_config_schema_t schema[] =
     {
-        fprintf(stderr, "ERROR: PeSoRTA_base_parse_config) fopen failed\n");
-        ret = -1;
-        goto exit0;
-    }
+        {'J', PeSoRTA_CONFIG_INT32, job_count, NULL, 0.0, INT32_MAX, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
 
-    /*Parse the file, line by line*/
-    while(!feof(configfile_p))
+    ret = PeSoRTA_config_load(configfile_name, schema, &config);
+    if(ret < 0)
     {
-        ret = PeSoRTA_getconfigopt(configfile_p, optstring, &opt, &optarg);
-        if(ret == -1)
-        {
-            if(!feof(configfile_p))
-            {
-                fprintf(stderr, "ERROR: PeSoRTA_base_parse_config) "
-                                "PeSoRTA_getconfigopt failed\n");
-                ret = -1;
-                goto exit1;
-            }
-            else
-            {
-                ret = 0;
-                continue;
-            }
-        }
-        
-        if(opt == -1)
-        {
-                fprintf(stderr, "ERROR: PeSoRTA_base_parse_config) config file "
-                                "contains bad line:\n\t\"%s\"\n", optarg);                
-                ret = -1;
-                free(optarg);
-                goto exit1;
-        }
+        fprintf(stderr, "ERROR: PeSoRTA_base_parse_config) PeSoRTA_config_load "
+                        "failed\n");
+        return -1;
+    }
 
-        if(optarg == NULL)
-        {
-            fprintf(stderr, "ERROR: PeSoRTA_base_parse_config) config file contains "
-                            "valid option (%c) without argument!\n", (int)opt);
-            ret = -1;
-            goto exit1;
-        }
-        
-        switch(opt)
-        {
-            case 'J':
-                *job_count = (int32_t)strtol(optarg, NULL, 0);
-                free(optarg);
-                break;
-        }/*switch(opt)*/
-    }/*while(!feof(configfile_p))*/
-    
-exit1:
-    fclose(configfile_p);
-    
-exit0:
-    return ret;
+    PeSoRTA_config_unload(&config);
+    return 0;
 }
 
 /*
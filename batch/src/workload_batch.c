@@ -0,0 +1,697 @@
+// workload_batch
+//
+// a generic program to run the repetitions of a list of experiments on a PeSoRTA
+// workload, and to collect their job time statistics in one results database
+//
+// The manifest has one experiment per line (lines starting with '#' are ignored):
+//     <workload> <config file> <repetitions> [<maxjobs>]
+// Config files are relative to the directory of the workload (<root>/<workload>).
+// Only the lines of the workload the program is built for are run, so a manifest
+// that mixes workloads is run by starting the batch program of every workload on it.
+//
+// Every finished repetition is appended to the results database as one line:
+//     workload,config,repetition,status,cpu,jobs,total_ns,mean_ns,min_ns,p50_ns,
+//     p99_ns,max_ns,start_s
+// Repetitions that are already in the database with status "ok" are skipped, so an
+// interrupted batch is resumed by starting it again.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <stdint.h>
+
+#include <errno.h>
+
+#include <fcntl.h>
+
+#include <sched.h>
+
+#include <sys/mman.h>
+
+#include <sys/types.h>
+
+#include <time.h>
+
+#include "PeSoRTA.h"
+#include "PeSoRTA_helper.h"
+
+#define BATCH_MAX_NAME (1024)
+
+/*one repetition of an experiment of the manifest*/
+typedef struct batch_run_s
+{
+    char    config[BATCH_MAX_NAME];
+    int32_t repetition;
+    long    maxjobs;
+} batch_run_t;
+
+/*the runs, shared with the worker processes*/
+typedef struct batch_shared_s
+{
+    /*the next run to be claimed by a worker*/
+    int64_t     next_run;
+    int64_t     failed_runs;
+    int64_t     run_count;
+    batch_run_t runs[];
+} batch_shared_t;
+
+/*what a worker needs to run the runs*/
+typedef struct batch_worker_s
+{
+    batch_shared_t  *shared_p;
+    int             db_fd;
+    char            *log_dir;
+} batch_worker_t;
+
+char *usage_string
+	= "-M <manifest> [-D <results database>] [-R <PeSoRTA root directory>] "
+	  "[-L <job log directory>] [-r] [-N <worker processes>] [-P]";
+char *optstring = "M:D:R:L:rN:P";
+
+static int compare_keys(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+    Read the keys ("<config>,<repetition>") of the completed runs of this workload
+    from the results database, sorted for bsearch
+*/
+static int load_completed(char *db_name, char ***keys_p, size_t *key_count_p)
+{
+    FILE    *db_h;
+    char    *line = NULL;
+    size_t  line_size = 0;
+    char    **keys = NULL;
+    char    **new_keys;
+    size_t  key_count = 0;
+    size_t  key_capacity = 0;
+
+    char    *workload;
+    char    *config;
+    char    *repetition;
+    char    *status;
+
+    *keys_p = NULL;
+    *key_count_p = 0;
+
+    db_h = fopen(db_name, "r");
+    if(NULL == db_h)
+    {
+        if(ENOENT == errno)
+        {
+            return 0;
+        }
+        fprintf(stderr, "ERROR: load_completed) failed to open the results database "
+                        "\"%s\" ", db_name);
+        perror("");
+        return -1;
+    }
+
+    while(getline(&line, &line_size, db_h) > 0)
+    {
+        workload = strtok(line, ",\n");
+        config = strtok(NULL, ",\n");
+        repetition = strtok(NULL, ",\n");
+        status = strtok(NULL, ",\n");
+        if((NULL == status) || (0 != strcmp(workload, workload_name())) ||
+           (0 != strcmp(status, "ok")))
+        {
+            continue;
+        }
+
+        if(key_count == key_capacity)
+        {
+            key_capacity = (0 == key_capacity)? 64 : 2*key_capacity;
+            new_keys = (char**)realloc(keys, key_capacity * sizeof(char*));
+            if(NULL == new_keys)
+            {
+                fprintf(stderr, "ERROR: load_completed) realloc failed\n");
+                goto error0;
+            }
+            keys = new_keys;
+        }
+
+        if(asprintf(&(keys[key_count]), "%s,%s", config, repetition) < 0)
+        {
+            fprintf(stderr, "ERROR: load_completed) asprintf failed\n");
+            goto error0;
+        }
+        key_count++;
+    }
+
+    free(line);
+    fclose(db_h);
+
+    if(key_count > 0)
+    {
+        qsort(keys, key_count, sizeof(char*), compare_keys);
+    }
+    *keys_p = keys;
+    *key_count_p = key_count;
+    return 0;
+
+error0:
+    while(key_count > 0)
+    {
+        free(keys[--key_count]);
+    }
+    free(keys);
+    free(line);
+    fclose(db_h);
+    return -1;
+}
+
+/*
+    Read the manifest, and list the runs of this workload that are not completed
+*/
+static int load_manifest(   char            *manifest_name,
+                            char            **keys,
+                            size_t          key_count,
+                            batch_shared_t  **shared_p,
+                            size_t          *shared_size_p,
+                            int64_t         *skipped_p)
+{
+    FILE    *manifest_h;
+    char    *line = NULL;
+    size_t  line_size = 0;
+    int     line_number = 0;
+
+    char    *workload;
+    char    *config;
+    char    *repetitions_s;
+    char    *maxjobs_s;
+    char    *endptr;
+    long    repetitions;
+    long    maxjobs;
+    long    r;
+
+    char    key[BATCH_MAX_NAME + 32];
+    char    *key_p = key;
+
+    batch_shared_t  *shared = NULL;
+    batch_shared_t  *new_shared;
+    int64_t         run_capacity = 0;
+    int64_t         run_count = 0;
+    batch_run_t     *run_p;
+
+    *skipped_p = 0;
+
+    manifest_h = fopen(manifest_name, "r");
+    if(NULL == manifest_h)
+    {
+        fprintf(stderr, "ERROR: load_manifest) failed to open the manifest \"%s\" ",
+                        manifest_name);
+        perror("");
+        return -1;
+    }
+
+    while(getline(&line, &line_size, manifest_h) > 0)
+    {
+        line_number++;
+
+        workload = strtok(line, " \t\r\n");
+        if((NULL == workload) || ('#' == workload[0]))
+        {
+            continue;
+        }
+        config = strtok(NULL, " \t\r\n");
+        repetitions_s = strtok(NULL, " \t\r\n");
+        maxjobs_s = strtok(NULL, " \t\r\n");
+
+        if((NULL == repetitions_s) || (strlen(config) >= BATCH_MAX_NAME) ||
+           (NULL != strchr(config, ',')))
+        {
+            fprintf(stderr, "ERROR: load_manifest) %s:%i: expected \"<workload> "
+                            "<config file> <repetitions> [<maxjobs>]\"\n",
+                            manifest_name, line_number);
+            goto error0;
+        }
+
+        errno = 0;
+        repetitions = strtol(repetitions_s, &endptr, 10);
+        if(errno || ('\0' != *endptr) || (repetitions < 1))
+        {
+            fprintf(stderr, "ERROR: load_manifest) %s:%i: invalid number of "
+                            "repetitions \"%s\"\n", manifest_name, line_number,
+                            repetitions_s);
+            goto error0;
+        }
+
+        /*0 runs all the jobs of the workload*/
+        maxjobs = 0;
+        if(NULL != maxjobs_s)
+        {
+            errno = 0;
+            maxjobs = strtol(maxjobs_s, &endptr, 10);
+            if(errno || ('\0' != *endptr) || (maxjobs < 1))
+            {
+                fprintf(stderr, "ERROR: load_manifest) %s:%i: invalid number of jobs "
+                                "\"%s\"\n", manifest_name, line_number, maxjobs_s);
+                goto error0;
+            }
+        }
+
+        if(0 != strcmp(workload, workload_name()))
+        {
+            continue;
+        }
+
+        for(r = 1; r <= repetitions; r++)
+        {
+            snprintf(key, sizeof(key), "%s,%li", config, r);
+            if((key_count > 0) &&
+               (NULL != bsearch(&key_p, keys, key_count, sizeof(char*), compare_keys)))
+            {
+                (*skipped_p)++;
+                continue;
+            }
+
+            if(run_count == run_capacity)
+            {
+                run_capacity = (0 == run_capacity)? 64 : 2*run_capacity;
+                new_shared = (batch_shared_t*)realloc(shared, sizeof(batch_shared_t) +
+                                                    run_capacity * sizeof(batch_run_t));
+                if(NULL == new_shared)
+                {
+                    fprintf(stderr, "ERROR: load_manifest) realloc failed\n");
+                    goto error0;
+                }
+                shared = new_shared;
+            }
+
+            run_p = &(shared->runs[run_count++]);
+            strcpy(run_p->config, config);
+            run_p->repetition = (int32_t)r;
+            run_p->maxjobs = maxjobs;
+        }
+    }
+
+    /*move the runs to memory that is shared with the worker processes*/
+    *shared_size_p = sizeof(batch_shared_t) + run_count * sizeof(batch_run_t);
+    *shared_p = (batch_shared_t*)mmap(NULL, *shared_size_p, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == *shared_p)
+    {
+        perror("ERROR: load_manifest) mmap failed");
+        goto error0;
+    }
+    if(run_count > 0)
+    {
+        memcpy((*shared_p)->runs, shared->runs, run_count * sizeof(batch_run_t));
+    }
+    (*shared_p)->next_run = 0;
+    (*shared_p)->failed_runs = 0;
+    (*shared_p)->run_count = run_count;
+
+    free(shared);
+    free(line);
+    fclose(manifest_h);
+    return 0;
+
+error0:
+    free(shared);
+    free(line);
+    fclose(manifest_h);
+    return -1;
+}
+
+/*
+    Write the job times of a run, like workload_timing does
+*/
+static int write_log(char *log_dir, batch_run_t *run_p, uint64_t *log_mem, long jobs)
+{
+    char    log_name[2*BATCH_MAX_NAME];
+    char    *config_base;
+    int     config_length;
+    FILE    *log_h;
+    long    jobi;
+
+    /*the name of the config, as in timing.<workload>.<config>.<repetition>.csv*/
+    config_base = strrchr(run_p->config, '/');
+    config_base = (NULL == config_base)? run_p->config : (config_base + 1);
+    config_length = (int)strlen(config_base);
+    if((config_length > 7) && (0 == strcmp(&config_base[config_length - 7], ".config")))
+    {
+        config_length -= 7;
+    }
+    snprintf(log_name, sizeof(log_name), "%s/timing.%s.%.*s.%i.csv", log_dir,
+             workload_name(), config_length, config_base, run_p->repetition);
+
+    log_h = fopen(log_name, "w");
+    if(NULL == log_h)
+    {
+        fprintf(stderr, "ERROR: Failed to open log file \"%s\"!\n", log_name);
+        perror("ERROR: fopen failed in write_log");
+        return -1;
+    }
+
+    for(jobi = 0; jobi < jobs; jobi++)
+    {
+        if(fprintf(log_h, "%lu,\n", log_mem[jobi]) < 0)
+        {
+            fprintf(stderr, "ERROR: Failed to write log index %li to log file!\n", jobi);
+            fclose(log_h);
+            return -1;
+        }
+    }
+
+    if(0 != fclose(log_h))
+    {
+        perror("ERROR: fclose failed in write_log");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    Run the workload on the config file of the run, and append the job time
+    statistics to the results database
+*/
+static int run_one( batch_run_t *run_p,
+                    int         db_fd,
+                    char        *log_dir)
+{
+    int ret;
+
+    void    *workload_state = NULL;
+    long    possiblejobs;
+    long    maxjobs;
+    long    jobs;
+    uint64_t *log_mem = NULL;
+    PeSoRTA_job_stats_t stats;
+    time_t  start_s;
+
+    char    record[2*BATCH_MAX_NAME];
+    int     record_length;
+
+    start_s = time(NULL);
+    jobs = 0;
+
+    /*Initialize the workload*/
+    ret = workload_init(run_p->config, &workload_state, &possiblejobs);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) run_one) workload_init failed for \"%s\"\n",
+                        workload_name(), run_p->config);
+        goto failed;
+    }
+
+    /*Check if the workload returned a valid possiblejobs*/
+    if(possiblejobs < 0)
+    {
+        /*Set it to an arbitrarily high value*/
+        possiblejobs = 10000;
+    }
+    maxjobs = (run_p->maxjobs > 0)? run_p->maxjobs : possiblejobs;
+
+	/*Allocate space for the timing log_mem*/
+    log_mem = (uint64_t*)malloc(((maxjobs > 0)? maxjobs : 1) * sizeof(uint64_t));
+    if(NULL == log_mem)
+    {
+        fprintf(stderr, "ERROR: failed to allocate memory for timing log_mem\n");
+        perror("ERROR: malloc failed in run_one");
+        workload_uninit(workload_state);
+        goto failed;
+    }
+
+	/* the main job loop */
+    ret = PeSoRTA_run_jobs(perform_job, workload_state, maxjobs, log_mem, &jobs);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: run_one) (%s) perform_job returned -1 for job %li of "
+                        "\"%s\"\n", workload_name(), jobs, run_p->config);
+        workload_uninit(workload_state);
+        goto failed;
+    }
+
+    /*a workload that could not complete its output fails the run too*/
+    ret = workload_uninit(workload_state);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: run_one) (%s) workload_uninit failed for \"%s\"\n",
+                        workload_name(), run_p->config);
+        goto failed;
+    }
+
+    if((NULL != log_dir) && (write_log(log_dir, run_p, log_mem, jobs) < 0))
+    {
+        goto failed;
+    }
+
+    /*summarize the job times*/
+    PeSoRTA_summarize_jobs(log_mem, jobs, &stats);
+
+    record_length = snprintf(record, sizeof(record),
+                             "%s,%s,%i,ok,%i,%li,%lu,%.1f,%lu,%lu,%lu,%lu,%li\n",
+                             workload_name(), run_p->config, run_p->repetition,
+                             sched_getcpu(), jobs, stats.total_ns,
+                             (jobs > 0)? ((double)stats.total_ns/(double)jobs) : 0.0,
+                             stats.min_ns, stats.p50_ns, stats.p99_ns, stats.max_ns,
+                             (long)start_s);
+    free(log_mem);
+    log_mem = NULL;
+    goto append;
+
+failed:
+    free(log_mem);
+    log_mem = NULL;
+    record_length = snprintf(record, sizeof(record),
+                             "%s,%s,%i,failed,%i,%li,,,,,,,%li\n",
+                             workload_name(), run_p->config, run_p->repetition,
+                             sched_getcpu(), jobs, (long)start_s);
+    ret = -1;
+
+append:
+    /*a single write to a file opened with O_APPEND, so that the records of
+    concurrent workers (and batch programs) are not interleaved*/
+    if(write(db_fd, record, record_length) != record_length)
+    {
+        perror("ERROR: run_one) failed to append to the results database");
+        ret = -1;
+    }
+
+    return (ret < 0)? -1 : 0;
+}
+
+/*
+    Run runs, until there are none left
+*/
+static void run_all(void *arg)
+{
+    batch_worker_t  *worker_p = (batch_worker_t*)arg;
+    batch_shared_t  *shared_p = worker_p->shared_p;
+    int64_t         run;
+
+    while(1)
+    {
+        run = __atomic_fetch_add(&(shared_p->next_run), 1, __ATOMIC_RELAXED);
+        if(run >= shared_p->run_count)
+        {
+            break;
+        }
+
+        if(run_one(&(shared_p->runs[run]), worker_p->db_fd, worker_p->log_dir) < 0)
+        {
+            __atomic_fetch_add(&(shared_p->failed_runs), 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int main (int argc, char * const * argv)
+{
+	int ret;
+
+    /*variables for parsing options*/
+    unsigned char rflag = 0;
+    unsigned char pflag = 0;
+    int worker_count = 1;
+
+    char *manifest_name = NULL;
+    char *db_name = "results.csv";
+    char *root_dir = "..";
+    char *log_dir = NULL;
+
+    /*working directory*/
+    char    cwd_name[4096];
+    char    *workload_dir = NULL;
+
+    /*completed runs and runs to do*/
+    char            **keys = NULL;
+    size_t          key_count = 0;
+    size_t          i;
+    batch_shared_t  *shared_p = NULL;
+    size_t          shared_size = 0;
+    int64_t         skipped = 0;
+    int             db_fd;
+    batch_worker_t  worker;
+
+	/* process input arguments */
+	while ((ret = getopt(argc, argv, optstring)) != -1)
+	{
+		switch(ret)
+		{
+            case 'M':
+                manifest_name = optarg;
+                break;
+
+            case 'D':
+                db_name = optarg;
+                break;
+
+            case 'R':
+                root_dir = optarg;
+                break;
+
+            case 'L':
+                log_dir = optarg;
+                break;
+
+            case 'r':
+                rflag = 1;
+                break;
+
+            case 'N':
+                worker_count = (int)strtol(optarg, NULL, 10);
+                if(worker_count < 1)
+                {
+                    fprintf(stderr, "ERROR: the number of workers must be positive\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'P':
+                pflag = 1;
+                break;
+
+			default:
+				fprintf(stderr, "ERROR: Bad option %c!\nUsage %s %s!\n",
+				                (char)ret, argv[0], usage_string);
+				ret = -EINVAL;
+				goto exit0;
+		}
+	}
+
+	if((optind != argc) || (NULL == manifest_name))
+	{
+		fprintf(stderr, "ERROR: Usage %s %s!\n", argv[0], usage_string);
+		ret = -EINVAL;
+		goto exit0;
+	}
+
+    ret = load_completed(db_name, &keys, &key_count);
+    if(ret < 0)
+    {
+        goto exit0;
+    }
+
+    ret = load_manifest(manifest_name, keys, key_count, &shared_p, &shared_size,
+                        &skipped);
+    if(ret < 0)
+    {
+        goto exit1;
+    }
+
+    fprintf(stderr, "%s: %lli runs to do, %lli already completed\n", workload_name(),
+                    (long long)shared_p->run_count, (long long)skipped);
+    if(0 == shared_p->run_count)
+    {
+        goto exit2;
+    }
+
+    /*the database and the log directory are opened before changing to the
+    directory of the workload, so that their names are relative to the current
+    directory*/
+    db_fd = open(db_name, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if(db_fd < 0)
+    {
+        fprintf(stderr, "ERROR: Failed to open the results database \"%s\" ", db_name);
+        perror("");
+        ret = -1;
+        goto exit2;
+    }
+    if(0 == lseek(db_fd, 0, SEEK_END))
+    {
+        dprintf(db_fd, "workload,config,repetition,status,cpu,jobs,total_ns,mean_ns,"
+                       "min_ns,p50_ns,p99_ns,max_ns,start_s\n");
+    }
+
+    if((NULL == getcwd(cwd_name, sizeof(cwd_name))) ||
+       ((NULL != log_dir) && ('/' != log_dir[0]) &&
+        (asprintf(&log_dir, "%s/%s", cwd_name, log_dir) < 0)))
+    {
+        perror("ERROR: main) failed to get the current directory");
+        ret = -1;
+        goto exit3;
+    }
+
+    /*Change to the directory of the workload*/
+    if(asprintf(&workload_dir, "%s/%s", root_dir, workload_name()) < 0)
+    {
+        workload_dir = NULL;
+        ret = -1;
+        goto exit3;
+    }
+    ret = chdir(workload_dir);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) main)  chdir failed to change the current working "
+                        "directory to the workload directory \"%s\" ",
+                        workload_name(), workload_dir);
+        perror("");
+        ret = -1;
+        goto exit3;
+    }
+
+    worker.shared_p = shared_p;
+    worker.db_fd    = db_fd;
+    worker.log_dir  = log_dir;
+
+    if(1 == worker_count)
+    {
+        /*run every repetition in this process*/
+        if((rflag == 1) && (PeSoRTA_set_realtime() < 0))
+        {
+            ret = -1;
+            goto exit3;
+        }
+        run_all(&worker);
+        if(rflag == 1)
+        {
+            munlockall();
+        }
+        ret = 0;
+    }
+    else
+    {
+        /*the runs of a crashed worker are not recorded and are run again when
+        the batch is resumed*/
+        ret = PeSoRTA_run_workers(run_all, &worker, rflag, worker_count, pflag);
+    }
+
+    if(shared_p->failed_runs > 0)
+    {
+        fprintf(stderr, "ERROR: (%s) main) %lli of %lli runs failed\n",
+                        workload_name(), (long long)shared_p->failed_runs,
+                        (long long)shared_p->run_count);
+        ret = -1;
+    }
+
+    /*undo everything*/
+exit3:
+    close(db_fd);
+exit2:
+    munmap(shared_p, shared_size);
+exit1:
+    for(i = 0; i < key_count; i++)
+    {
+        free(keys[i]);
+    }
+    free(keys);
+exit0:
+	return (ret < 0)? EXIT_FAILURE : EXIT_SUCCESS;
+}
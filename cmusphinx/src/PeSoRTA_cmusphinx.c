@@ -2,23 +2,95 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <float.h>
 #include "PeSoRTA.h"
 #include "PeSoRTA_helper.h"
 
 #include "sphinxwrapper.h"
 #include "sw_wav.h"
+#include "sw_stream.h"
+#include "sw_avinput.h"
+#include "sw_calib_cache.h"
 
-typedef struct PeSoRTA_cmusphinx_s
+/*upper limit of concurrently decoded streams*/
+#define PeSoRTA_CMUSPHINX_MAX_STREAMS (1024)
+
+/*upper limit of frame lengths in a sweep*/
+#define PeSoRTA_CMUSPHINX_MAX_SWEEP (64)
+
+typedef struct PeSoRTA_cmusphinx_stream_s
 {
     sw_data_t   *sw_data_p;
-    
-    int16_t     *data;
+
+    /*the samples are streamed from the input file in bounded windows*/
+    sw_stream_t stream;
     size_t      total_read;
     size_t      total_decoded;
-    
+
+    /*per frame decoding latency (ns)*/
+    uint64_t    frames;
+    uint64_t    busy_ns;
+    uint64_t    max_ns;
+
+    /*the resident memory that the decoder of the stream added when it was
+    initialized, on the heap and in file mappings (kB)*/
+    long        decoder_kb;
+    long        mapped_kb;
+} PeSoRTA_cmusphinx_stream_t;
+
+/*A frame length of the sweep and the cost of the jobs that used it*/
+typedef struct PeSoRTA_cmusphinx_sweep_s
+{
     size_t      frame_length;
+    long        jobs;
+    uint64_t    busy_ns;
+    uint64_t    max_ns;
+    size_t      samples;
+} PeSoRTA_cmusphinx_sweep_t;
+
+typedef struct PeSoRTA_cmusphinx_s
+{
+    /*one decoder per stream, each stream decodes its own part of the input*/
+    PeSoRTA_cmusphinx_stream_t  *streams;
+    int32_t                     stream_count;
+
+    size_t      frame_length;
+
+    /*the input is decoded once per frame length of the sweep, in order*/
+    PeSoRTA_cmusphinx_sweep_t   sweep[PeSoRTA_CMUSPHINX_MAX_SWEEP];
+    int32_t                     sweep_count;
+    int32_t                     sweep_index;
+
+    /*with more than one stream, every job decodes one frame of each stream on
+    the workers of the pool*/
+    PeSoRTA_pool_t  *pool;
+    uint64_t        wall_ns;
 } PeSoRTA_cmusphinx_t;
 
+typedef struct PeSoRTA_cmusphinx_options_s
+{
+    char    *input_file_name;
+    char    *config_file_name;
+    char    *calib_cache_name;
+    double  silence_thresh;
+    double  frame_rate;
+    double  window_length;
+    int32_t stream_count;
+    int32_t pin_workers;
+    int64_t hyp_buffer_size;
+    char    *sweep_list;
+    char    *mode_name;
+    char    *grammar_file_name;
+    char    *keyphrases;
+    int32_t nbest_count;
+    /*the loaded config file, which holds the option strings*/
+    PeSoRTA_config_t config;
+} PeSoRTA_cmusphinx_options_t;
+
 /*
     - a simple function that returns the name and any description of the workload as a static string
 */
@@ -27,105 +99,367 @@ char *workload_name(void)
     return "cmusphinx";
 }
 
+static inline uint64_t PeSoRTA_cmusphinx_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
 /*
-"-I: input file name (file name) \n"\
+"-I: input file name (a 16kHz mono WAV file, or any audio file ffmpeg can decode) \n"\
 "-C: config file name for cmusphinx \n"\
 "-s: the silence threshold (ms)\n"\
 "-f: frame-rate (frames per second)\n"\
+"-W: length of the resident sample window (s, 0 keeps the whole file resident)\n"\
+"-K: silence filter calibration cache file (file name, reused across runs)\n"\
+"-N: number of concurrently decoded streams (the input is split between them)\n"\
+"-P: pin the stream workers to separate cpus (0 or 1, default 1)\n"\
+"-H: size of the preallocated hypothesis buffer of each decoder (bytes, 0 skips the hypothesis extraction)\n"\
+"-F: frame length sweep, the input is decoded once per frame length (comma separated list of ms, replaces -f)\n"\
+"-M: decoding mode (lm, jsgf, kws, nbest or lattice, default lm)\n"\
+"-G: JSGF grammar file (file name, for the jsgf mode)\n"\
+"-k: keyphrases to spot ('|' separated list, for the kws mode)\n"\
+"-n: length of the N-best list at the end of each utterance (for the nbest mode, default 10)\n"\
 */
-static int PeSoRTA_cmusphinx_parse_config(  char *configfile_name, 
-                                            char **input_file_name,
-                                            char **config_file_name,
-                                            double *silence_thresh,
-                                            double *frame_rate)
+static int PeSoRTA_cmusphinx_parse_config(  char *configfile_name,
+                                            PeSoRTA_cmusphinx_options_t *options_p)
 {
     int ret = 0;
-    FILE *configfile_p;
 
-	/*parsing variables*/
-    char *optstring = "I:C:s:f:";
-    int  opt;
-    char *optarg;
+    /*by default the whole file is resident, and a single stream is decoded on the
+    calling thread*/
+    PeSoRTA_config_schema_t schema[] =
+    {
+        {'I', PeSoRTA_CONFIG_STRING, &(options_p->input_file_name), NULL,
+                                                0.0, 0.0, NULL},
+        {'C', PeSoRTA_CONFIG_STRING, &(options_p->config_file_name), NULL,
+                                                0.0, 0.0, NULL},
+        {'s', PeSoRTA_CONFIG_DOUBLE, &(options_p->silence_thresh), "50",
+                                                1.0/(double)SW_DEFAULT_SAMPLE_RATE,
+                                                HUGE_VAL, NULL},
+        {'f', PeSoRTA_CONFIG_DOUBLE, &(options_p->frame_rate), "20",
+                                                DBL_MIN, HUGE_VAL, NULL},
+        {'W', PeSoRTA_CONFIG_DOUBLE, &(options_p->window_length), "0",
+                                                0.0, HUGE_VAL, NULL},
+        {'K', PeSoRTA_CONFIG_STRING, &(options_p->calib_cache_name), NULL,
+                                                0.0, 0.0, NULL},
+        {'N', PeSoRTA_CONFIG_INT32, &(options_p->stream_count), "1",
+                                                1.0, PeSoRTA_CMUSPHINX_MAX_STREAMS, NULL},
+        {'P', PeSoRTA_CONFIG_INT32, &(options_p->pin_workers), "1",
+                                                0.0, 1.0, NULL},
+        {'H', PeSoRTA_CONFIG_INT64, &(options_p->hyp_buffer_size), NULL,
+                                                0.0, INT32_MAX, NULL},
+        {'F', PeSoRTA_CONFIG_STRING, &(options_p->sweep_list), NULL,
+                                                0.0, 0.0, NULL},
+        {'M', PeSoRTA_CONFIG_STRING, &(options_p->mode_name), NULL,
+                                                0.0, 0.0, NULL},
+        {'G', PeSoRTA_CONFIG_STRING, &(options_p->grammar_file_name), NULL,
+                                                0.0, 0.0, NULL},
+        {'k', PeSoRTA_CONFIG_STRING, &(options_p->keyphrases), NULL,
+                                                0.0, 0.0, NULL},
+        {'n', PeSoRTA_CONFIG_INT32, &(options_p->nbest_count), NULL,
+                                                1.0, INT32_MAX, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
 
     /*Set initial values of the output variables*/
-    *input_file_name = NULL;
-    *config_file_name = NULL;
-    
-    /*Leave silence_thresh and frame rate untouched*/
+    options_p->input_file_name = NULL;
+    options_p->config_file_name = NULL;
+    options_p->calib_cache_name = NULL;
+    options_p->sweep_list = NULL;
+    options_p->mode_name = NULL;
+    options_p->grammar_file_name = NULL;
+    options_p->keyphrases = NULL;
+    options_p->hyp_buffer_size = SW_DEFAULT_HYP_BUFFER_SIZE;
+    options_p->nbest_count = SW_DEFAULT_NBEST_COUNT;
 
-    /*Open the config file*/
-    configfile_p = fopen(configfile_name, "r");
-    if(NULL == configfile_p)
+    /*the option strings point into the loaded config file*/
+    ret = PeSoRTA_config_load(configfile_name, schema, &(options_p->config));
+    if(ret < 0)
     {
-        fprintf(stderr, "ERROR: PeSoRTA_cmusphinx_parse_config) fopen failed\n");
-        ret = -1;
-        goto exit0;
+        fprintf(stderr, "ERROR: PeSoRTA_cmusphinx_parse_config) PeSoRTA_config_load "
+                        "failed\n");
     }
 
-    /*Parse the file, line by line*/
-    while(!feof(configfile_p))
+    return ret;
+}
+
+static void PeSoRTA_cmusphinx_free_options(PeSoRTA_cmusphinx_options_t *options_p)
+{
+    PeSoRTA_config_unload(&(options_p->config));
+}
+
+/*Create a temporary file in $TMPDIR (or /tmp), returns its descriptor*/
+static int PeSoRTA_cmusphinx_mktemp(char *temp_name, size_t temp_name_size)
+{
+    int     fd;
+    char    *tmpdir;
+
+    tmpdir = getenv("TMPDIR");
+    tmpdir = (NULL == tmpdir)? "/tmp" : tmpdir;
+    snprintf(temp_name, temp_name_size, "%s/PeSoRTA_cmusphinx_XXXXXX", tmpdir);
+
+    fd = mkstemp(temp_name);
+    if(fd < 0)
     {
-        ret = PeSoRTA_getconfigopt(configfile_p, optstring, &opt, &optarg);
-        if(ret == -1)
-        {
-            if(!feof(configfile_p))
+        fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_mktemp) failed to "
+                        "create the temporary file \"%s\"\n", temp_name);
+        perror("ERROR: (cmusphinx) PeSoRTA_cmusphinx_mktemp) mkstemp failed");
+    }
+
+    return fd;
+}
+
+/*
+    Select the search of the decoders. The grammar of the kws mode is written to
+    a temporary file (named in kws_name), which the caller unlinks once the 
+    decoders are initialized.
+*/
+static int PeSoRTA_cmusphinx_set_search(cmd_ln_t                    *psconfig,
+                                        PeSoRTA_cmusphinx_options_t *options_p,
+                                        sw_mode_t                   mode,
+                                        char                        *kws_name,
+                                        size_t                      kws_name_size,
+                                        int                         *kws_linked_p)
+{
+    int     fd;
+    FILE    *filep;
+    int     ret;
+
+    *kws_linked_p = 0;
+
+    switch(mode)
+    {
+        case SW_MODE_JSGF:
+            if(NULL == options_p->grammar_file_name)
+            {
+                fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_set_search) the "
+                                "jsgf mode needs a grammar file (-G)\n");
+                return -1;
+            }
+            cmd_ln_set_str_r(psconfig, "-lm", NULL);
+            cmd_ln_set_str_r(psconfig, "-jsgf", options_p->grammar_file_name);
+            break;
+
+        case SW_MODE_KWS:
+            if(NULL == options_p->keyphrases)
+            {
+                fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_set_search) the "
+                                "kws mode needs keyphrases (-k)\n");
+                return -1;
+            }
+
+            /*the garbage of the grammar is picked from the dictionary*/
+            if(NULL == cmd_ln_str_r(psconfig, "-dict"))
+            {
+                fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_set_search) the "
+                                "kws mode needs the dictionary (-dict) of the decoder "
+                                "configuration\n");
+                return -1;
+            }
+
+            fd = PeSoRTA_cmusphinx_mktemp(kws_name, kws_name_size);
+            if(fd < 0)
             {
-                fprintf(stderr, "ERROR: PeSoRTA_cmusphinx_parse_config) "
-                                "PeSoRTA_getconfigopt failed\n");
-                ret = -1;
-                goto exit1;
+                return -1;
             }
-            else
+            *kws_linked_p = 1;
+
+            filep = fdopen(fd, "w");
+            if(NULL == filep)
             {
-                ret = 0;
-                continue;
+                perror("ERROR: (cmusphinx) PeSoRTA_cmusphinx_set_search) fdopen failed");
+                close(fd);
+                return -1;
             }
+            ret = sw_write_kws_grammar(filep, options_p->keyphrases,
+                                       cmd_ln_str_r(psconfig, "-dict"));
+            if((0 != fclose(filep)) || (ret < 0))
+            {
+                fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_set_search) "
+                                "failed to write the keyphrase grammar\n");
+                return -1;
+            }
+
+            cmd_ln_set_str_r(psconfig, "-lm", NULL);
+            cmd_ln_set_str_r(psconfig, "-jsgf", kws_name);
+            break;
+
+        default:
+            /*the language model of the configuration*/
+            break;
+    }
+
+    return 0;
+}
+
+/*
+    Decode an input that is not a 16kHz mono WAV file into a temporary file of
+    raw samples (named in temp_name). The caller unlinks the file once the
+    streams have opened it.
+*/
+static int PeSoRTA_cmusphinx_decode_input(  char    *input_file_name,
+                                            char    *temp_name,
+                                            size_t  temp_name_size,
+                                            size_t  *total_samples_p)
+{
+    int     ret;
+    int     fd;
+
+    fd = PeSoRTA_cmusphinx_mktemp(temp_name, temp_name_size);
+    if(fd < 0)
+    {
+        goto error0;
+    }
+
+    ret = sw_avinput_convert(input_file_name, fd, total_samples_p);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_decode_input) "
+                        "sw_avinput_convert failed to decode \"%s\"\n", input_file_name);
+        goto error1;
+    }
+
+    close(fd);
+    return 0;
+
+error1:
+    close(fd);
+    unlink(temp_name);
+error0:
+    return -1;
+}
+
+/*
+    Parse the comma separated list of frame lengths (ms) of a sweep into 
+    frame lengths in samples
+*/
+static int PeSoRTA_cmusphinx_parse_sweep(   char                        *sweep_list,
+                                            PeSoRTA_cmusphinx_sweep_t   *sweep,
+                                            int32_t                     *sweep_count_p)
+{
+    char    *current = sweep_list;
+    char    *end;
+    double  length_ms;
+    int32_t count = 0;
+
+    while('\0' != *current)
+    {
+        length_ms = strtod(current, &end);
+        if((end == current) || (length_ms <= 0.0))
+        {
+            fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_parse_sweep) bad frame "
+                            "length in \"%s\"\n", sweep_list);
+            return -1;
         }
-        
-        if(opt == -1)
+
+        if(count >= PeSoRTA_CMUSPHINX_MAX_SWEEP)
         {
-                fprintf(stderr, "ERROR: PeSoRTA_cmusphinx_parse_config) config file "
-                                "contains bad line:\n\t\"%s\"\n", optarg);                
-                ret = -1;
-                free(optarg);
-                goto exit1;
+            fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_parse_sweep) a sweep "
+                            "can contain at most %i frame lengths\n",
+                            PeSoRTA_CMUSPHINX_MAX_SWEEP);
+            return -1;
         }
 
-        if(optarg == NULL)
+        memset(&(sweep[count]), 0, sizeof(PeSoRTA_cmusphinx_sweep_t));
+        sweep[count].frame_length = (size_t)(length_ms * 
+                                            (double)SW_DEFAULT_SAMPLE_RATE / 1000.0);
+        if(0 == sweep[count].frame_length)
         {
-            fprintf(stderr, "ERROR: PeSoRTA_cmusphinx_parse_config) config file contains "
-                            "valid option (%c) without argument!\n", (int)opt);
-            ret = -1;
-            goto exit1;
+            fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_parse_sweep) the "
+                            "frame length %fms is too short\n", length_ms);
+            return -1;
         }
-        
-        switch(opt)
+        count++;
+
+        current = end;
+        while((',' == *current) || (' ' == *current) || ('\t' == *current) ||
+              ('\n' == *current))
         {
-            case 'I':
-                *input_file_name = optarg;
-                break;
-
-            case 'C':
-                *config_file_name = optarg;
-                break;
-                
-            case 's':
-                *silence_thresh = (double)strtod(optarg, NULL);
-                free(optarg);
-                break;
-            
-            case 'f':
-                *frame_rate = (double)strtod(optarg, NULL);
-                free(optarg);
-                break;
-        }/*switch(opt)*/
-    }/*while(!feof(configfile_p))*/
-    
-exit1:
-    fclose(configfile_p);
-    
-exit0:
-    return ret;
+            current++;
+        }
+    }
+
+    if(0 == count)
+    {
+        fprintf(stderr, "ERROR: (cmusphinx) PeSoRTA_cmusphinx_parse_sweep) the sweep "
+                        "\"%s\" is empty\n", sweep_list);
+        return -1;
+    }
+
+    *sweep_count_p = count;
+    return 0;
+}
+
+static size_t PeSoRTA_cmusphinx_gcd(size_t a, size_t b)
+{
+    size_t t;
+
+    while(0 != b)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/*
+    The resident memory of the process that is not backed by a file, and the
+    resident memory that is (kB)
+*/
+static int PeSoRTA_cmusphinx_resident_kb(long *anon_kb_p, long *file_kb_p)
+{
+    FILE *statm_h;
+    long size, resident, shared;
+    long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+    statm_h = fopen("/proc/self/statm", "r");
+    if(NULL == statm_h)
+    {
+        return -1;
+    }
+    if(3 != fscanf(statm_h, "%li %li %li", &size, &resident, &shared))
+    {
+        fclose(statm_h);
+        return -1;
+    }
+    fclose(statm_h);
+
+    *anon_kb_p = (resident - shared) * page_kb;
+    *file_kb_p = shared * page_kb;
+    return 0;
+}
+
+/*Release the decoders and sample stores of all streams*/
+static void PeSoRTA_cmusphinx_free_streams(PeSoRTA_cmusphinx_t *workload_state)
+{
+    int32_t i;
+    PeSoRTA_cmusphinx_stream_t *stream_p;
+
+    if(NULL == workload_state->streams)
+    {
+        return;
+    }
+
+    for(i = 0; i < workload_state->stream_count; i++)
+    {
+        stream_p = &(workload_state->streams[i]);
+        if(NULL != stream_p->sw_data_p)
+        {
+            free_sw_data(&(stream_p->sw_data_p));
+        }
+        if(NULL != stream_p->stream.window[0])
+        {
+            sw_stream_close(&(stream_p->stream));
+        }
+    }
+
+    free(workload_state->streams);
+    workload_state->streams = NULL;
 }
 
 /*
@@ -137,25 +471,47 @@ exit0:
 int workload_init(char *configfile, void **state_p, long *job_count_p)
 {
     int ret = 0;
-    
+
     PeSoRTA_cmusphinx_t *workload_state;
-    
-    char    *input_file_name;
-    char    *config_file_name;
-        
-    /*default values for the frame rate and silence threshold*/
-    double  silence_thresh = 50.0;
-    double  frame_rate = 20.0;
-    
+    PeSoRTA_cmusphinx_options_t options;
+    PeSoRTA_cmusphinx_stream_t  *stream_p;
+    int32_t i;
+
     /*Local variables for processing the wave file*/
     FILE* filep;
     sw_wavheader_t wavheader;
     int16_t *buffer = NULL;
     size_t ret_size;
-    size_t buffer_size = 0;
     size_t total_read = 0;
+    size_t frame_length;
+    /*windows and streams are made of whole frames of every frame length*/
+    size_t frame_quantum;
+    size_t window_samples;
+    int    is_wav;
+    char   *stream_file_name;
+    off_t  data_offset;
+    char   temp_name[4096];
+    int    temp_linked = 0;
 
-    sw_data_t *p_sw_data = NULL;
+    /*partitioning of the input between the streams*/
+    size_t stream_samples;
+    size_t stream_start;
+
+    /*silence filter calibration cache*/
+    sw_calib_t  calib;
+    uint64_t    calib_key = 0;
+    int         calib_found;
+
+    /*the decoder configuration is shared by all streams*/
+    cmd_ln_t    *psconfig;
+    sw_mode_t   mode = SW_MODE_LM;
+    char        kws_name[4096];
+    int         kws_linked = 0;
+
+    /*the resident memory before a decoder is initialized*/
+    long        anon_kb = 0;
+    long        file_kb = 0;
+    int         resident_ok;
 
     /*allocate space for the workload state*/
     workload_state = calloc(1, sizeof(PeSoRTA_cmusphinx_t));
@@ -166,156 +522,359 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
         ret = -1;
         goto error0;
     }
-    
+
     /*read the config file*/
-    ret = PeSoRTA_cmusphinx_parse_config(   configfile, 
-                                            &input_file_name,
-                                            &config_file_name,
-                                            &silence_thresh,
-                                            &frame_rate);
+    ret = PeSoRTA_cmusphinx_parse_config(configfile, &options);
     if(ret < 0)
     {
         fprintf(stderr, "ERROR: (cmusphinx) workload_init) "
                         "PeSoRTA_cmusphinx_parse_config failed\n");
         goto error1;
     }
-    
+
     /*Validate the obtained argument*/
-    if(NULL == input_file_name)
+    if(NULL == options.input_file_name)
     {
         fprintf(stderr, "ERROR: (cmusphinx) workload_init) "
                         "the PeSoRTA_cmusphinx config file must specify an input wav "
                         "file\n");
         goto error2;
     }
-    
-    if(silence_thresh < (1.0/(double)SW_DEFAULT_SAMPLE_RATE))
+
+    /*the ranges of the numeric options are checked by PeSoRTA_config_load*/
+    if((NULL != options.mode_name) && (sw_parse_mode(options.mode_name, &mode) < 0))
     {
-        fprintf(stderr, "ERROR: (cmusphinx) workload_init) the PeSoRTA_cmusphinx config "
-                        "file must specify an input wav file\n");
+        fprintf(stderr, "ERROR: (cmusphinx) workload_init) unknown decoding mode "
+                        "\"%s\"\n", options.mode_name);
         goto error2;
     }
-    
+
     /*Open the input file*/
-    filep = fopen(input_file_name, "r");
+    filep = fopen(options.input_file_name, "r");
     if(NULL == filep)
     {
         fprintf(stderr, "ERROR: (cmusphinx) workload_init) Failed to open the input file "
-                        "\"%s\"\n", input_file_name);
+                        "\"%s\"\n", options.input_file_name);
         perror("ERROR: (cmusphinx) workload_init) fopen failed");
         goto error2;
     }
-    
-    /*Read the WAV header*/
-    ret_size = fread(&wavheader, sizeof(sw_wavheader_t), 1, filep);
-    if(ret_size < 1)
+
+    if(NULL != options.sweep_list)
     {
-        fprintf(stderr, "ERROR: (cmusphinx) workload_init) failed to read the header "
-                        "from the wav file \"%s\"\n", input_file_name);
-        if(ret_size < 0)
+        ret = PeSoRTA_cmusphinx_parse_sweep(options.sweep_list,
+                                            workload_state->sweep,
+                                            &(workload_state->sweep_count));
+        if(ret < 0)
         {
-            perror("ERROR: (cmusphinx) workload_init) fread failed");
+            goto error3;
         }
-        goto error3;
     }
-    
-    /*Verify the wav header*/
-    ret = sw_verify_wav(&wavheader);
-    if(ret < 0)
+    else
     {
-        fprintf(stderr, "ERROR: (cmusphinx) workload_init) the wav file, \"%s\" is not "
-                        "properly formatted.\n", input_file_name);
-        goto error3;
+        frame_length = (size_t)(((double)SW_DEFAULT_SAMPLE_RATE)/options.frame_rate);
+        if(0 == frame_length)
+        {
+            fprintf(stderr, "ERROR: (cmusphinx) workload_init) the frame rate %f is too "
+                            "high\n", options.frame_rate);
+            goto error3;
+        }
+        memset(&(workload_state->sweep[0]), 0, sizeof(PeSoRTA_cmusphinx_sweep_t));
+        workload_state->sweep[0].frame_length = frame_length;
+        workload_state->sweep_count = 1;
     }
+    frame_length = workload_state->sweep[0].frame_length;
 
-    /*Allocate space for the buffer*/
-    buffer_size = sw_get_wav_samples(&wavheader);
-    buffer = (int16_t*)malloc(buffer_size*sizeof(int16_t));
-    if(NULL == buffer)
+    /*least common multiple of the frame lengths*/
+    frame_quantum = frame_length;
+    for(i = 1; i < workload_state->sweep_count; i++)
     {
-        fprintf(stderr, "ERROR: (cmusphinx) workload_init) Failed to allocate space to"
-                        " read in samples from the wav file.\n");
-        perror("ERROR: (cmusphinx) workload_init) malloc failed");
-        goto error3;
+        frame_quantum = (frame_quantum / PeSoRTA_cmusphinx_gcd(frame_quantum,
+                                            workload_state->sweep[i].frame_length))
+                        * workload_state->sweep[i].frame_length;
     }
-    
-    /*Read the samples into the buffer*/
-    ret_size = fread(   buffer, 
-                        sizeof(int16_t), 
-                        buffer_size, 
-                        filep);
-    if(ret_size < buffer_size)
+
+    /*Round the window up to whole frames so that no frame straddles two windows*/
+    window_samples = (size_t)(options.window_length * (double)SW_DEFAULT_SAMPLE_RATE);
+    window_samples = ((window_samples + frame_quantum - 1)/frame_quantum)*frame_quantum;
+
+    /*A 16kHz mono WAV file is streamed directly, anything else is decoded and
+    resampled by ffmpeg first*/
+    ret_size = fread(&wavheader, sizeof(sw_wavheader_t), 1, filep);
+    is_wav = (1 == ret_size) && (0 == sw_verify_wav(&wavheader));
+
+    if(is_wav)
     {
-        fprintf(stderr, "ERROR: (cmusphinx) workload_init) fread failed to read %li "
-                        "samples\n", buffer_size);
-        if(ret_size < 0)
+        total_read = sw_get_wav_samples(&wavheader);
+        stream_file_name = options.input_file_name;
+        data_offset = (off_t)sizeof(sw_wavheader_t);
+    }
+    else
+    {
+        ret = PeSoRTA_cmusphinx_decode_input(   options.input_file_name,
+                                                temp_name,
+                                                sizeof(temp_name),
+                                                &total_read);
+        if(ret < 0)
         {
-            perror("ERROR: (cmusphinx) workload_init) fread failed");
+            goto error3;
         }
+        stream_file_name = temp_name;
+        data_offset = 0;
+        temp_linked = 1;
+    }
+
+    /*Split the input into one run of whole frames per stream*/
+    stream_samples = (total_read + frame_quantum - 1)/frame_quantum;
+    stream_samples = ((stream_samples + options.stream_count - 1)/options.stream_count);
+    stream_samples = stream_samples * frame_quantum;
+    if((size_t)(options.stream_count - 1) * stream_samples >= total_read)
+    {
+        fprintf(stderr, "ERROR: (cmusphinx) workload_init) \"%s\" is too short to be "
+                        "split into %i streams\n", options.input_file_name,
+                        options.stream_count);
         goto error4;
     }
 
-    total_read = total_read + ret_size;
-    
-    /*Initialize the sw_data_t object*/
-    ret = allocate_sw_data( &p_sw_data, 
-                            config_file_name, 
-                            (int32_t)((double)SW_DEFAULT_SAMPLE_RATE * silence_thresh / 1000.0));
-    if(ret < 0)
+    workload_state->streams = (PeSoRTA_cmusphinx_stream_t*)calloc(
+                                            options.stream_count,
+                                            sizeof(PeSoRTA_cmusphinx_stream_t));
+    if(NULL == workload_state->streams)
     {
-        fprintf(stderr, "ERROR (cmusphinx) workload_init): allocate_sw_data failed\n");
+        fprintf(stderr, "ERROR: (cmusphinx) workload_init) calloc failed to allocate "
+                        "%i streams\n", options.stream_count);
         goto error4;
     }
+    workload_state->stream_count = options.stream_count;
 
-    /*Callibrate the silence filter*/
-    ret = sw_calib_silence(p_sw_data, buffer, total_read);
-    if(ret < 0)
+    for(i = 0; i < options.stream_count; i++)
+    {
+        stream_p = &(workload_state->streams[i]);
+        stream_start = (size_t)i * stream_samples;
+        stream_p->total_read = total_read - stream_start;
+        stream_p->total_read = (stream_p->total_read > stream_samples)?
+                                stream_samples : stream_p->total_read;
+
+        ret = sw_stream_open(   &(stream_p->stream),
+                                stream_file_name,
+                                data_offset + (off_t)(stream_start * sizeof(int16_t)),
+                                stream_p->total_read,
+                                window_samples);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: (cmusphinx) workload_init) failed to stream the "
+                            "samples of \"%s\"\n", options.input_file_name);
+            goto error5;
+        }
+    }
+
+    /*the streams keep the decoded samples open*/
+    if(temp_linked)
     {
-        fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_calib_silence failed\n");
+        unlink(temp_name);
+        temp_linked = 0;
+    }
+
+    /*Initialize the sw_data_t objects. ps_init loads its own acoustic model,
+    dictionary and language model, and the API has no way to hand them to a
+    second decoder, so every stream pays for a full copy. With -mmap the senone
+    weights of all decoders map the same pages of the model files, the rest of
+    the footprint of every decoder is measured and reported*/
+    psconfig = sw_load_psconfig(options.config_file_name);
+    if(NULL == psconfig)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_load_psconfig failed\n");
         goto error5;
     }
+    if(options.stream_count > 1)
+    {
+        cmd_ln_set_boolean_r(psconfig, "-mmap", TRUE);
+    }
 
-    /*free up and close used and unnecessary objects*/
-    fclose(filep);
+    ret = PeSoRTA_cmusphinx_set_search( psconfig, 
+                                        &options, 
+                                        mode,
+                                        kws_name,
+                                        sizeof(kws_name),
+                                        &kws_linked);
+    if(ret < 0)
+    {
+        goto error6;
+    }
+
+    for(i = 0; i < options.stream_count; i++)
+    {
+        stream_p = &(workload_state->streams[i]);
+        resident_ok = (0 == PeSoRTA_cmusphinx_resident_kb(&anon_kb, &file_kb));
+
+        ret = allocate_sw_data_config(  &(workload_state->streams[i].sw_data_p),
+                                        psconfig,
+                                        (int32_t)((double)SW_DEFAULT_SAMPLE_RATE *
+                                                    options.silence_thresh / 1000.0));
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): allocate_sw_data_config "
+                            "failed for stream %i\n", i);
+            goto error6;
+        }
+
+        if(resident_ok &&
+           (0 == PeSoRTA_cmusphinx_resident_kb(&(stream_p->decoder_kb),
+                                               &(stream_p->mapped_kb))))
+        {
+            stream_p->decoder_kb -= anon_kb;
+            stream_p->mapped_kb  -= file_kb;
+        }
+        else
+        {
+            fprintf(stderr, "WARNING: (cmusphinx) workload_init) failed to read the "
+                            "resident memory of the decoder of stream %i\n", i);
+            stream_p->decoder_kb = 0;
+            stream_p->mapped_kb  = 0;
+        }
+
+        /*The hypotheses are written to a buffer allocated here, outside of the
+        jobs*/
+        ret = sw_set_hyp_buffer_size(   workload_state->streams[i].sw_data_p,
+                                        (size_t)options.hyp_buffer_size);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_set_hyp_buffer_size "
+                            "failed\n");
+            goto error6;
+        }
+
+        sw_set_mode(workload_state->streams[i].sw_data_p, mode, options.nbest_count);
+        if((SW_MODE_KWS == mode) &&
+           (sw_set_keyphrases(workload_state->streams[i].sw_data_p,
+                              options.keyphrases) < 0))
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_set_keyphrases "
+                            "failed\n");
+            goto error6;
+        }
+    }
+
+    /*the decoders have read the keyphrase grammar*/
+    if(kws_linked)
+    {
+        unlink(kws_name);
+        kws_linked = 0;
+    }
+
+    /*the silence filter is calibrated on the first window of the first stream*/
+    stream_p = &(workload_state->streams[0]);
+    buffer = sw_stream_get( &(stream_p->stream),
+                            0,
+                            stream_p->stream.window_valid[0]);
 
-    if(NULL != input_file_name)
-    {   
-        free(input_file_name);
+    /*Reuse the calibration of a previous run on the same input if there is one*/
+    calib_found = 0;
+    if(NULL != options.calib_cache_name)
+    {
+        calib_key = sw_calib_cache_key( buffer,
+                                        stream_p->stream.window_valid[0],
+                                        total_read,
+                                        options.silence_thresh);
+        calib_found = sw_calib_cache_load(options.calib_cache_name, calib_key, &calib);
+        if(calib_found < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_calib_cache_load "
+                            "failed\n");
+            goto error6;
+        }
     }
 
-    if(NULL != config_file_name)
-    {  
-        free(config_file_name);
+    if(!calib_found)
+    {
+        /*Callibrate the silence filter*/
+        ret = sw_calib_silence( stream_p->sw_data_p,
+                                buffer,
+                                stream_p->stream.window_valid[0]);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_calib_silence failed\n");
+            goto error6;
+        }
+        sw_get_calib(stream_p->sw_data_p, &calib);
+
+        if(NULL != options.calib_cache_name)
+        {
+            ret = sw_calib_cache_store(options.calib_cache_name, calib_key, &calib);
+            if(ret < 0)
+            {
+                fprintf(stderr, "WARNING: (cmusphinx) workload_init) failed to save the "
+                                "calibration cache \"%s\"\n", options.calib_cache_name);
+            }
+        }
     }
-    
+
+    /*All decoders share the same calibration*/
+    for(i = (calib_found)? 0 : 1; i < options.stream_count; i++)
+    {
+        ret = sw_set_calib(workload_state->streams[i].sw_data_p, &calib);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): sw_set_calib failed\n");
+            goto error6;
+        }
+    }
+
+    /*The calling thread decodes one of the streams*/
+    if(options.stream_count > 1)
+    {
+        ret = PeSoRTA_pool_init(&(workload_state->pool),
+                                options.stream_count - 1,
+                                options.pin_workers);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) workload_init): PeSoRTA_pool_init "
+                            "failed\n");
+            goto error6;
+        }
+    }
+
+    /*free up and close used and unnecessary objects, the samples are read by the
+    streams*/
+    cmd_ln_free_r(psconfig);
+    fclose(filep);
+
+    PeSoRTA_cmusphinx_free_options(&options);
+
     /*Setup the workload_state data structure*/
-    workload_state->sw_data_p = p_sw_data;
-    workload_state->data = buffer;
-    workload_state->total_read = total_read;
-    workload_state->total_decoded = 0;
-    workload_state->frame_length = (int32_t)(((double)SW_DEFAULT_SAMPLE_RATE)/frame_rate);
-    
+    workload_state->frame_length = frame_length;
+    workload_state->sweep_index = 0;
+    workload_state->wall_ns = 0;
+
     *state_p = workload_state;
-    /*Total number of frames rounded up*/
-    *job_count_p = (total_read + (workload_state->frame_length) - 1)/(workload_state->frame_length);
-    
+    /*Total number of frames of the longest (first) stream rounded up, for every 
+    frame length of the sweep*/
+    *job_count_p = 0;
+    for(i = 0; i < workload_state->sweep_count; i++)
+    {
+        *job_count_p += (workload_state->streams[0].total_read + 
+                            workload_state->sweep[i].frame_length - 1)/
+                        workload_state->sweep[i].frame_length;
+    }
+
     return 0;
+error6:
+    if(kws_linked)
+    {
+        unlink(kws_name);
+    }
+    cmd_ln_free_r(psconfig);
 error5:
-    free_sw_data(&p_sw_data);
+    PeSoRTA_cmusphinx_free_streams(workload_state);
 error4:
-    free(buffer);
+    if(temp_linked)
+    {
+        unlink(temp_name);
+    }
 error3:
     fclose(filep);
 error2:
     /*free the options strings*/
-    if(NULL != input_file_name)
-    {   
-        free(input_file_name);
-    }
-    if(NULL != config_file_name)
-    {  
-        free(config_file_name);
-    }
+    PeSoRTA_cmusphinx_free_options(&options);
 error1:
     free(workload_state);
 error0:
@@ -325,47 +884,53 @@ error0:
 }
 
 /*
-    Do the actual "computation"
+    Decode the next frame of a stream, returns 1 if the stream has no samples
+    left, 0 on success and -1 on error
 */
-int perform_job(void *state)
+static int PeSoRTA_cmusphinx_decode_frame(  PeSoRTA_cmusphinx_stream_t  *stream_p,
+                                            size_t                      frame_length)
 {
     int ret = 0;
-    
-    PeSoRTA_cmusphinx_t *workload_state = (PeSoRTA_cmusphinx_t*)state;
+
     sw_data_t *p_sw_data;
 
     int16_t *data;
     size_t total_read;
     size_t total_decoded;
-    
+
     size_t samples_remaining;
-    size_t frame_length;
-    
-    char *hyp;
-    
-    /*Check that the obtained state is valid*/
-    if(NULL == workload_state)
+
+    /*points into the hypothesis buffer of the decoder*/
+    char const *hyp;
+
+    /*Unpack the structure*/
+    p_sw_data = stream_p->sw_data_p;
+
+    total_read = stream_p->total_read;
+    total_decoded = stream_p->total_decoded;
+
+    samples_remaining = total_read - total_decoded;
+    if(0 == samples_remaining)
     {
-        ret = -1;
+        ret = 1;
         goto exit0;
     }
-    
-    /*Unpack the structure*/
-    p_sw_data = workload_state->sw_data_p;
 
-    data = workload_state->data;
-    total_read = workload_state->total_read;
-    total_decoded = workload_state->total_decoded;
-    
-    samples_remaining = total_read - total_decoded;
-    frame_length = workload_state->frame_length;
-    
     /*Reduce the frame length if there are not enough samples left to decode*/
     frame_length =  (frame_length > samples_remaining)?
                           samples_remaining : frame_length;
-    
+
+    /*Get the frame from the resident window*/
+    data = sw_stream_get(&(stream_p->stream), total_decoded, frame_length);
+    if(NULL == data)
+    {
+        fprintf(stderr, "ERROR (sphinx main) perform_job) sw_stream_get failed\n");
+        ret = -1;
+        goto exit0;
+    }
+
     /*Decode the frame*/
-    ret = sw_decode_speech(p_sw_data, &(data[total_decoded]), frame_length, &hyp);
+    ret = sw_decode_speech(p_sw_data, data, frame_length, &hyp);
     if(ret < 0)
     {
         fprintf(stderr, "ERROR (sphinx main) perform_job) sw_decode_speech failed\n");
@@ -373,15 +938,9 @@ int perform_job(void *state)
         goto exit0;
     }
 
-    /*If a hyp was obtained, free it*/
-    if(NULL != hyp)
-    {
-        free(hyp);
-    }
-    
     /*Update the number of samples decoded so far*/
     total_decoded = total_decoded + frame_length;
-    
+
     /*If the all the samples have been decoded extract the last hyp*/
     if(total_decoded == total_read)
     {
@@ -393,46 +952,247 @@ int perform_job(void *state)
             ret = -1;
             goto exit0;
         }
-    
-        /*If a hyp was obtained, free it*/
-        if(NULL != hyp)
+    }
+
+    /*Update the stream state*/
+    stream_p->total_decoded = total_decoded;
+
+exit0:
+    return ret;
+}
+
+/*Pool task, decodes the next frame of stream index and records its latency*/
+static int PeSoRTA_cmusphinx_stream_task(void *arg, int32_t index)
+{
+    int ret;
+    PeSoRTA_cmusphinx_t *workload_state = (PeSoRTA_cmusphinx_t*)arg;
+    PeSoRTA_cmusphinx_stream_t *stream_p = &(workload_state->streams[index]);
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+
+    start_ns = PeSoRTA_cmusphinx_now_ns();
+    ret = PeSoRTA_cmusphinx_decode_frame(stream_p, workload_state->frame_length);
+    if(0 != ret)
+    {
+        /*a finished stream is not an error*/
+        return (ret < 0)? -1 : 0;
+    }
+    elapsed_ns = PeSoRTA_cmusphinx_now_ns() - start_ns;
+
+    stream_p->frames++;
+    stream_p->busy_ns += elapsed_ns;
+    stream_p->max_ns = (elapsed_ns > stream_p->max_ns)? elapsed_ns : stream_p->max_ns;
+
+    return 0;
+}
+
+/*
+    Do the actual "computation"
+*/
+int perform_job(void *state)
+{
+    int ret = 0;
+
+    PeSoRTA_cmusphinx_t *workload_state = (PeSoRTA_cmusphinx_t*)state;
+    PeSoRTA_cmusphinx_sweep_t *sweep_p;
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+    size_t   decoded_before = 0;
+    size_t   decoded_after = 0;
+    int32_t i;
+
+    /*Check that the obtained state is valid*/
+    if(NULL == workload_state)
+    {
+        ret = -1;
+        goto exit0;
+    }
+
+    for(i = 0; i < workload_state->stream_count; i++)
+    {
+        decoded_before += workload_state->streams[i].total_decoded;
+    }
+
+    start_ns = PeSoRTA_cmusphinx_now_ns();
+
+    if(1 == workload_state->stream_count)
+    {
+        ret = PeSoRTA_cmusphinx_decode_frame(   &(workload_state->streams[0]),
+                                                workload_state->frame_length);
+        ret = (ret < 0)? -1 : 0;
+    }
+    else
+    {
+        /*One frame of every stream, in parallel*/
+        ret = PeSoRTA_pool_run( workload_state->pool,
+                                PeSoRTA_cmusphinx_stream_task,
+                                workload_state,
+                                workload_state->stream_count);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (sphinx main) perform_job) decoding a stream "
+                            "failed\n");
+            ret = -1;
+        }
+    }
+
+    elapsed_ns = PeSoRTA_cmusphinx_now_ns() - start_ns;
+    if(ret < 0)
+    {
+        goto exit0;
+    }
+
+    /*Once the streams are exhausted on the last frame length, the remaining
+    jobs do nothing and would skew its statistics*/
+    for(i = 0; i < workload_state->stream_count; i++)
+    {
+        decoded_after += workload_state->streams[i].total_decoded;
+    }
+    sweep_p = &(workload_state->sweep[workload_state->sweep_index]);
+    if(decoded_after != decoded_before)
+    {
+        workload_state->wall_ns += elapsed_ns;
+
+        sweep_p->jobs++;
+        sweep_p->busy_ns += elapsed_ns;
+        sweep_p->max_ns = (elapsed_ns > sweep_p->max_ns)? elapsed_ns : sweep_p->max_ns;
+    }
+
+    /*Once the first (longest) stream is done, start over with the next frame 
+    length of the sweep*/
+    if( (workload_state->streams[0].total_decoded == workload_state->streams[0].total_read)
+        && ((workload_state->sweep_index + 1) < workload_state->sweep_count))
+    {
+        for(i = 0; i < workload_state->stream_count; i++)
         {
-            free(hyp);
+            sweep_p->samples += workload_state->streams[i].total_decoded;
+            workload_state->streams[i].total_decoded = 0;
         }
+        workload_state->sweep_index++;
+        workload_state->frame_length = 
+                        workload_state->sweep[workload_state->sweep_index].frame_length;
     }
-    
-    /*Update the workload state*/
-    workload_state->total_decoded = total_decoded;
-    
+
 exit0:
     return ret;
 }
 
+/*
+    Per stream latency and the real-time factor (processing time over audio time)
+    of each stream and of all streams together
+*/
+static void PeSoRTA_cmusphinx_report(PeSoRTA_cmusphinx_t *workload_state)
+{
+    int32_t i;
+    PeSoRTA_cmusphinx_stream_t *stream_p;
+    double audio_s;
+    double total_audio_s = 0.0;
+
+    printf("cmusphinx: %i streams\n", workload_state->stream_count);
+    printf("stream,frames,mean_latency_us,max_latency_us,rtf,decoder_kb,mapped_kb\n");
+    for(i = 0; i < workload_state->stream_count; i++)
+    {
+        stream_p = &(workload_state->streams[i]);
+        audio_s = (double)stream_p->total_decoded / (double)SW_DEFAULT_SAMPLE_RATE;
+        total_audio_s += audio_s;
+
+        printf("%i,%llu,%.1f,%.1f,%.4f,%li,%li\n",
+                i,
+                (unsigned long long)stream_p->frames,
+                (0 == stream_p->frames)? 0.0 :
+                    ((double)stream_p->busy_ns / (double)stream_p->frames) / 1000.0,
+                (double)stream_p->max_ns / 1000.0,
+                (audio_s > 0.0)? ((double)stream_p->busy_ns / 1e9) / audio_s : 0.0,
+                stream_p->decoder_kb,
+                stream_p->mapped_kb);
+    }
+
+    printf("aggregate: %.1fs of audio in %.3fs, rtf %.4f\n",
+            total_audio_s,
+            (double)workload_state->wall_ns / 1e9,
+            (total_audio_s > 0.0)?
+                ((double)workload_state->wall_ns / 1e9) / total_audio_s : 0.0);
+}
+
+/*
+    Cost of the jobs for every frame length of the sweep: mean and worst-case job
+    and the throughput (seconds of audio decoded per second of processing)
+*/
+static void PeSoRTA_cmusphinx_report_sweep(PeSoRTA_cmusphinx_t *workload_state)
+{
+    int32_t i;
+    PeSoRTA_cmusphinx_sweep_t *sweep_p;
+    double busy_s;
+    double audio_s;
+
+    /*the samples of the last frame length have not been collected yet*/
+    sweep_p = &(workload_state->sweep[workload_state->sweep_index]);
+    for(i = 0; i < workload_state->stream_count; i++)
+    {
+        sweep_p->samples += workload_state->streams[i].total_decoded;
+    }
+
+    printf("cmusphinx: frame length sweep\n");
+    printf("frame_length_ms,jobs,mean_job_us,max_job_us,audio_s_per_s\n");
+    for(i = 0; i <= workload_state->sweep_index; i++)
+    {
+        sweep_p = &(workload_state->sweep[i]);
+        busy_s = (double)sweep_p->busy_ns / 1e9;
+        audio_s = (double)sweep_p->samples / (double)SW_DEFAULT_SAMPLE_RATE;
+
+        printf("%.1f,%li,%.1f,%.1f,%.2f\n",
+                (double)sweep_p->frame_length * 1000.0 / (double)SW_DEFAULT_SAMPLE_RATE,
+                sweep_p->jobs,
+                (0 == sweep_p->jobs)? 0.0 :
+                    ((double)sweep_p->busy_ns / (double)sweep_p->jobs) / 1000.0,
+                (double)sweep_p->max_ns / 1000.0,
+                (busy_s > 0.0)? audio_s / busy_s : 0.0);
+    }
+}
+
 /*
 
 */
 int workload_uninit(void *state)
 {
     PeSoRTA_cmusphinx_t *workload_state = (PeSoRTA_cmusphinx_t*)state;
-    
+    int32_t i;
+
     if(NULL == workload_state)
     {
         goto exit0;
     }
 
-    /*Free the sphinx wrapper object*/
-    free_sw_data(&(workload_state->sw_data_p));
+    /*Stop the workers before the decoders go away*/
+    if(NULL != workload_state->pool)
+    {
+        PeSoRTA_pool_free(&(workload_state->pool));
+        PeSoRTA_cmusphinx_report(workload_state);
+    }
 
-    /*Free the samples*/
-    if(NULL != workload_state->data)
+    if(workload_state->sweep_count > 1)
     {
-        free(workload_state->data);
+        PeSoRTA_cmusphinx_report_sweep(workload_state);
     }
 
+    for(i = 0; i < workload_state->stream_count; i++)
+    {
+        if(workload_state->streams[i].sw_data_p->hyp_truncated > 0)
+        {
+            fprintf(stderr, "WARNING: (cmusphinx) workload_uninit) %llu hypotheses of "
+                            "stream %i were truncated, consider a larger -H\n",
+                            (unsigned long long)
+                                workload_state->streams[i].sw_data_p->hyp_truncated,
+                            i);
+        }
+    }
+
+    /*Free the sphinx wrapper objects and the samples*/
+    PeSoRTA_cmusphinx_free_streams(workload_state);
+
     /*Free the main workload_state data structure*/
-    free(workload_state);       
+    free(workload_state);
 
 exit0:
     return 0;
 }
-
@@ -1,51 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include "sphinxwrapper.h"
 
-/*If reentrancy is expected, a lock should be applied to these variables before 
-calling a function that uses sw_ad_read*/
-static int16_t *sw_ad_buffer = NULL;
-static int32_t  sw_ad_buffer_size = 0;
+static char const* sw_mode_names[SW_MODE_COUNT] = 
+{
+    "lm",
+    "jsgf",
+    "kws",
+    "nbest",
+    "lattice"
+};
 
+/*The a/d record is embedded in the sw_data_t object, so every decoder reads its
+own samples and several decoders can run concurrently*/
 static int32_t sw_ad_read(ad_rec_t * ad, int16_t * buf, int32_t max)
 {
+    sw_data_t *p_sw_data = (sw_data_t*)((char*)ad - offsetof(sw_data_t, ad_rec));
     size_t read_amount = 0;
     
-    read_amount = (max < sw_ad_buffer_size)? max : sw_ad_buffer_size;
-    memcpy(buf, sw_ad_buffer, read_amount * sizeof(int16_t));
+    read_amount = (max < p_sw_data->ad_buffer_size)? max : p_sw_data->ad_buffer_size;
+    memcpy(buf, p_sw_data->ad_buffer, read_amount * sizeof(int16_t));
     
-    sw_ad_buffer_size = sw_ad_buffer_size - read_amount;
-    if(sw_ad_buffer_size > 0)
+    p_sw_data->ad_buffer_size = p_sw_data->ad_buffer_size - read_amount;
+    if(p_sw_data->ad_buffer_size > 0)
     {
-        sw_ad_buffer = &(sw_ad_buffer[read_amount]);
+        p_sw_data->ad_buffer = &(p_sw_data->ad_buffer[read_amount]);
     }
     else
     {
-        sw_ad_buffer = NULL;
+        p_sw_data->ad_buffer = NULL;
     }
     
     return read_amount;
 }
 
-int allocate_sw_data(   sw_data_t   **pp_sw_data, 
-                        char    *psconfig_filename,
-                        int32_t silence_thresh)
+/*
+    Append the hyp_size characters of a hypothesis to the hypothesis buffer,
+    separated from the one of the previous utterance by a space, truncating it if
+    it does not fit
+*/
+static void sw_append_hyp(sw_data_t *p_sw_data, char const *hyp, size_t hyp_size)
 {
-    sw_data_t *p_sw_data;
-    cmd_ln_t *config;
-    
-    p_sw_data = (sw_data_t*)calloc(1, sizeof(sw_data_t));
-    if(NULL == p_sw_data)
+    size_t space = p_sw_data->hyp_buffer_size - p_sw_data->hyp_length - 1;
+
+    if(0 == hyp_size)
     {
-        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data): calloc failed to allocate "
-                        "memory for an sw_data_t object");
-        perror("");
-        goto error0;
+        return;
     }
 
-    p_sw_data->state = SW_STATE_SILENCE;
-    p_sw_data->last_speech_sample = -1;
-    p_sw_data->silence_thresh = silence_thresh;
-    
+    if(p_sw_data->hyp_length > 0)
+    {
+        if(0 == space)
+        {
+            p_sw_data->hyp_truncated++;
+            return;
+        }
+        p_sw_data->hyp_buffer[p_sw_data->hyp_length] = ' ';
+        p_sw_data->hyp_length++;
+        space--;
+    }
+
+    if(hyp_size > space)
+    {
+        hyp_size = space;
+        p_sw_data->hyp_truncated++;
+    }
+
+    memcpy(&(p_sw_data->hyp_buffer[p_sw_data->hyp_length]), hyp, hyp_size);
+    p_sw_data->hyp_length += hyp_size;
+    p_sw_data->hyp_buffer[p_sw_data->hyp_length] = '\0';
+}
+
+/*
+    Build the decoder configuration, which can be shared by several decoders.
+    The caller releases it with cmd_ln_free_r.
+*/
+cmd_ln_t* sw_load_psconfig(char *psconfig_filename)
+{
+    cmd_ln_t *config;
+
     /* Disable all the logging */
     err_set_logfp(NULL);
 
@@ -54,8 +89,8 @@ int allocate_sw_data(   sw_data_t   **pp_sw_data,
     config = cmd_ln_init(NULL, ps_args(), TRUE, NULL);
     if(NULL == config)
     {
-        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data): cmd_ln_init failed\n");
-        goto error1;
+        fprintf(stderr, "ERROR (cmusphinx) sw_load_psconfig): cmd_ln_init failed\n");
+        goto error0;
     }
     
     /*If a separate config file was provided, use it*/
@@ -63,18 +98,71 @@ int allocate_sw_data(   sw_data_t   **pp_sw_data,
     {
         if(NULL == cmd_ln_parse_file_r(config, ps_args(), psconfig_filename, TRUE))
         {
-            fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data): cmd_ln_parse_file_r "
+            fprintf(stderr, "ERROR (cmusphinx) sw_load_psconfig): cmd_ln_parse_file_r "
                             "failed\n");
-            goto error2;
+            goto error1;
         }
     }
+
+    return config;
+
+error1:
+    cmd_ln_free_r(config);
+error0:
+    return NULL;
+}
+
+int allocate_sw_data(   sw_data_t   **pp_sw_data, 
+                        char    *psconfig_filename,
+                        int32_t silence_thresh)
+{
+    int ret;
+    cmd_ln_t *config;
+
+    config = sw_load_psconfig(psconfig_filename);
+    if(NULL == config)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data): sw_load_psconfig "
+                        "failed\n");
+        return -1;
+    }
+
+    ret = allocate_sw_data_config(pp_sw_data, config, silence_thresh);
+
+    /*the decoder keeps its own reference to the configuration*/
+    cmd_ln_free_r(config);
+
+    return ret;
+}
+
+int allocate_sw_data_config(sw_data_t   **pp_sw_data, 
+                            cmd_ln_t    *config,
+                            int32_t     silence_thresh)
+{
+    int ret;
+    sw_data_t *p_sw_data;
+    void    *filter_buffer;
+    size_t  filter_bytes;
+    
+    p_sw_data = (sw_data_t*)calloc(1, sizeof(sw_data_t));
+    if(NULL == p_sw_data)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data_config): calloc failed to "
+                        "allocate memory for an sw_data_t object");
+        perror("");
+        goto error0;
+    }
+
+    p_sw_data->state = SW_STATE_SILENCE;
+    p_sw_data->last_speech_sample = -1;
+    p_sw_data->silence_thresh = silence_thresh;
     
     /*Initialize the decoder with the above configuration options*/
     p_sw_data->ps = ps_init(config);
     if(NULL == p_sw_data->ps)
     {
-        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data): ps_init failed\n");
-        goto error2;
+        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data_config): ps_init failed\n");
+        goto error1;
     }
     
     /*Initialize the fake a/d device*/
@@ -85,23 +173,43 @@ int allocate_sw_data(   sw_data_t   **pp_sw_data,
     p_sw_data->cont = cont_ad_init(&(p_sw_data->ad_rec), sw_ad_read);
     if(NULL == p_sw_data->cont)
     {
-        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data): calloc failed to allocate "
-                        "memory for an sw_data_t object\n");
+        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data_config): cont_ad_init "
+                        "failed\n");
+        goto error2;
+    }
+
+    /*Allocate the cache-aligned filter buffer*/
+    filter_bytes = (size_t)p_sw_data->cont->spf * sizeof(int16_t);
+    filter_bytes = ((filter_bytes + SW_CACHE_LINE_SIZE - 1)/SW_CACHE_LINE_SIZE)*
+                    SW_CACHE_LINE_SIZE;
+    ret = posix_memalign(&filter_buffer, SW_CACHE_LINE_SIZE, filter_bytes);
+    if(0 != ret)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) allocate_sw_data_config): posix_memalign "
+                        "failed to allocate a filter buffer of %zu bytes\n", filter_bytes);
         goto error3;
     }
-    
-    /*Initialization is done*/
-    cmd_ln_free_r(config);
+    memset(filter_buffer, 0, filter_bytes);
+    p_sw_data->filter_buffer = (int16_t*)filter_buffer;
+    p_sw_data->filter_buffer_size = p_sw_data->cont->spf;
+
+    ret = sw_set_hyp_buffer_size(p_sw_data, SW_DEFAULT_HYP_BUFFER_SIZE);
+    if(ret < 0)
+    {
+        goto error4;
+    }
     
     /*Set the output variable *pp_sw_data to the allocated and configured object*/
     *pp_sw_data = p_sw_data;
     
     return 0;
 
+error4:
+    free(p_sw_data->filter_buffer);
 error3:
-    ps_free(p_sw_data->ps);
+    cont_ad_close(p_sw_data->cont);
 error2:
-    cmd_ln_free_r(config);
+    ps_free(p_sw_data->ps);
 error1:
     free(p_sw_data);
 error0:
@@ -110,12 +218,376 @@ error0:
 
 void free_sw_data(sw_data_t **pp_sw_data)
 {
+    free((*pp_sw_data)->hyp_buffer);
+    free((*pp_sw_data)->keyphrases);
+    free((*pp_sw_data)->filter_buffer);
     cont_ad_close((*pp_sw_data)->cont);
     ps_free((*pp_sw_data)->ps);
     free(*pp_sw_data);
     *pp_sw_data = NULL;
 }
 
+/*
+    (Re)allocate the hypothesis buffer, this must not be called while decoding. 
+    A size of 0 disables the extraction of hypotheses.
+*/
+int sw_set_hyp_buffer_size(sw_data_t *p_sw_data, size_t hyp_buffer_size)
+{
+    char *hyp_buffer = NULL;
+
+    if(hyp_buffer_size > 0)
+    {
+        hyp_buffer = (char*)malloc(hyp_buffer_size);
+        if(NULL == hyp_buffer)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) sw_set_hyp_buffer_size) malloc failed "
+                            "to allocate a hypothesis buffer of %zu bytes\n", 
+                            hyp_buffer_size);
+            return -1;
+        }
+        hyp_buffer[0] = '\0';
+    }
+
+    free(p_sw_data->hyp_buffer);
+    p_sw_data->hyp_buffer = hyp_buffer;
+    p_sw_data->hyp_buffer_size = hyp_buffer_size;
+    p_sw_data->hyp_length = 0;
+
+    return 0;
+}
+
+int sw_parse_mode(char *mode_name, sw_mode_t *mode_p)
+{
+    int32_t i;
+
+    for(i = 0; i < SW_MODE_COUNT; i++)
+    {
+        if(0 == strcmp(mode_name, sw_mode_names[i]))
+        {
+            *mode_p = (sw_mode_t)i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+char const* sw_mode_name(sw_mode_t mode)
+{
+    return ((mode >= 0) && (mode < SW_MODE_COUNT))? sw_mode_names[mode] : "unknown";
+}
+
+/*characters that can not be part of a word of a JSGF grammar*/
+#define SW_JSGF_SPECIALS "=;|*+<>()[]{}/\\\"#"
+
+/*
+    Returns 1 if the length characters at word are one of the words of the '|'
+    separated keyphrases
+*/
+static int sw_kws_is_keyword(char const *keyphrases, char const *word, size_t length)
+{
+    char const *token = keyphrases;
+    size_t token_length;
+
+    while('\0' != *token)
+    {
+        token += strspn(token, " \t|");
+        token_length = strcspn(token, " \t|");
+        if((token_length == length) && (0 == strncmp(token, word, length)))
+        {
+            return 1;
+        }
+        token += token_length;
+    }
+
+    return 0;
+}
+
+/*
+    Pick the garbage words of the keyphrase grammar from the dictionary: for every
+    phone that words start with, the word with the fewest phones. Together they
+    make a rough phone loop that absorbs the speech around the keyphrases.
+    Alternate pronunciations, fillers and the words of the keyphrases are left
+    out. Returns the number of words, or -1 if the dictionary can not be read.
+*/
+static int32_t sw_kws_garbage(  char const  *dict_filename,
+                                char const  *keyphrases,
+                                char        words[][SW_KWS_MAX_WORD],
+                                int32_t     max_words)
+{
+    FILE    *dict_h;
+    char    *line = NULL;
+    size_t  line_size = 0;
+    char    phones[SW_KWS_MAX_GARBAGE][SW_KWS_MAX_WORD];
+    int32_t phone_counts[SW_KWS_MAX_GARBAGE];
+    int32_t count = 0;
+    int32_t i;
+
+    char    *word;
+    char    *phone;
+    char    *first_phone;
+    int32_t phone_count;
+    size_t  length;
+
+    dict_h = fopen(dict_filename, "r");
+    if(NULL == dict_h)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_kws_garbage) failed to open the "
+                        "dictionary \"%s\" ", dict_filename);
+        perror("");
+        return -1;
+    }
+
+    max_words = (max_words > SW_KWS_MAX_GARBAGE)? SW_KWS_MAX_GARBAGE : max_words;
+
+    while(getline(&line, &line_size, dict_h) > 0)
+    {
+        word = strtok(line, " \t\r\n");
+        first_phone = strtok(NULL, " \t\r\n");
+        if((NULL == first_phone) || ('#' == word[0]))
+        {
+            continue;
+        }
+
+        length = strlen(word);
+        if((length >= SW_KWS_MAX_WORD) || (strlen(first_phone) >= SW_KWS_MAX_WORD) ||
+           (length != strcspn(word, SW_JSGF_SPECIALS)) ||
+           sw_kws_is_keyword(keyphrases, word, length))
+        {
+            continue;
+        }
+
+        for(phone_count = 1; NULL != (phone = strtok(NULL, " \t\r\n")); phone_count++);
+
+        for(i = 0; (i < count) && (0 != strcmp(phones[i], first_phone)); i++);
+        if(i == count)
+        {
+            if(count == max_words)
+            {
+                continue;
+            }
+            strcpy(phones[count], first_phone);
+            count++;
+        }
+        else if(phone_count >= phone_counts[i])
+        {
+            continue;
+        }
+
+        strcpy(words[i], word);
+        phone_counts[i] = phone_count;
+    }
+
+    free(line);
+    fclose(dict_h);
+    return count;
+}
+
+/*
+    pocketsphinx 0.8 has no keyphrase search, so keyphrase spotting is emulated 
+    with a grammar that loops over the keyphrases and over garbage words from
+    the dictionary dict_filename, which absorb the speech that is not a
+    keyphrase. The garbage is weighted down (SW_KWS_GARBAGE_WEIGHT), so that a
+    keyphrase wins where it fits. keyphrases is a '|' separated list of phrases,
+    every word must be in the dictionary.
+*/
+int sw_write_kws_grammar(FILE *filep, char *keyphrases, char const *dict_filename)
+{
+    char    *phrase = keyphrases;
+    char    *end;
+    size_t  length;
+    int32_t count = 0;
+    char    garbage[SW_KWS_MAX_GARBAGE][SW_KWS_MAX_WORD];
+    int32_t garbage_count;
+    int32_t i;
+
+    garbage_count = sw_kws_garbage(dict_filename, keyphrases, garbage,
+                                   SW_KWS_MAX_GARBAGE);
+    if(garbage_count < 0)
+    {
+        return -1;
+    }
+
+    fprintf(filep, "#JSGF V1.0;\n\ngrammar sw_kws;\n\n");
+    if(garbage_count > 0)
+    {
+        fprintf(filep, "<garbage> = %s", garbage[0]);
+        for(i = 1; i < garbage_count; i++)
+        {
+            fprintf(filep, " | %s", garbage[i]);
+        }
+        fprintf(filep, ";\n\npublic <keyphrases> = ( /%g/ <garbage>",
+                SW_KWS_GARBAGE_WEIGHT);
+    }
+    else
+    {
+        fprintf(stderr, "WARNING: (cmusphinx) sw_write_kws_grammar) no garbage words "
+                        "in \"%s\", only the keyphrases are recognized\n",
+                        dict_filename);
+        fprintf(filep, "public <keyphrases> = (");
+    }
+
+    while('\0' != *phrase)
+    {
+        end = strchr(phrase, '|');
+        length = (NULL == end)? strlen(phrase) : (size_t)(end - phrase);
+
+        /*skip blanks around the phrase*/
+        while((length > 0) && ((' ' == *phrase) || ('\t' == *phrase)))
+        {
+            phrase++;
+            length--;
+        }
+        while((length > 0) && ((' ' == phrase[length - 1]) || ('\t' == phrase[length - 1])))
+        {
+            length--;
+        }
+
+        if(length > 0)
+        {
+            /*the weights are all or nothing*/
+            fprintf(filep, "%s( %.*s )",
+                    (garbage_count > 0)? " | /1/ " : ((count > 0)? " | " : " "),
+                    (int)length, phrase);
+            count++;
+        }
+
+        if(NULL == end)
+        {
+            break;
+        }
+        phrase = end + 1;
+    }
+
+    fprintf(filep, " )+;\n");
+
+    if(0 == count)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_write_kws_grammar) no keyphrase in "
+                        "\"%s\"\n", keyphrases);
+        return -1;
+    }
+
+    if(ferror(filep))
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_write_kws_grammar) failed to write the "
+                        "grammar\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    Keep a copy of the keyphrases, so that only their words are reported in the
+    kws mode, and not the garbage around them
+*/
+int sw_set_keyphrases(sw_data_t *p_sw_data, char *keyphrases)
+{
+    char *copy = strdup(keyphrases);
+
+    if(NULL == copy)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_set_keyphrases) strdup failed\n");
+        return -1;
+    }
+
+    free(p_sw_data->keyphrases);
+    p_sw_data->keyphrases = copy;
+    return 0;
+}
+
+/*The search itself is selected by the configuration the decoder was created with*/
+void sw_set_mode(sw_data_t *p_sw_data, sw_mode_t mode, int32_t nbest_count)
+{
+    p_sw_data->mode = mode;
+    p_sw_data->nbest_count = nbest_count;
+}
+
+/*
+    End the current utterance and do the utterance end work of the decoding 
+    mode. The N-best list and the lattice are built by pocketsphinx, which 
+    allocates memory for them.
+*/
+static int sw_end_utterance(sw_data_t *p_sw_data)
+{
+    int ret;
+    ps_decoder_t    *ps = p_sw_data->ps;
+    ps_nbest_t      *nbest;
+    ps_lattice_t    *dag;
+    char const      *hyp;
+    const char      *uttid;
+    int32_t         score;
+    int32_t         n;
+    size_t          length;
+
+    /*Signal the end of an utterance*/
+    ret = ps_end_utt(ps);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_end_utterance) ps_end_utt failed\n");
+        return -1;
+    }
+
+    switch(p_sw_data->mode)
+    {
+        case SW_MODE_NBEST:
+            nbest = ps_nbest(ps, 0, -1, NULL, NULL);
+            for(n = 0; (NULL != nbest) && (n < p_sw_data->nbest_count); n++)
+            {
+                /*ps_nbest_next frees the iterator at the end of the list*/
+                nbest = ps_nbest_next(nbest);
+                if(NULL != nbest)
+                {
+                    ps_nbest_hyp(nbest, &score);
+                }
+            }
+            if(NULL != nbest)
+            {
+                ps_nbest_free(nbest);
+            }
+            break;
+
+        case SW_MODE_LATTICE:
+            /*the lattice belongs to the decoder*/
+            dag = ps_get_lattice(ps);
+            if(NULL != dag)
+            {
+                ps_lattice_posterior(dag, NULL, 1.0);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    /*Add the hypothesis to the hypothesis buffer*/
+    if(p_sw_data->hyp_buffer_size > 0)
+    {
+        hyp = ps_get_hyp(ps, NULL, &uttid);
+        if((NULL != hyp) && (NULL != p_sw_data->keyphrases))
+        {
+            /*only the spotted keywords, every one counts as a hypothesis*/
+            while('\0' != *hyp)
+            {
+                hyp += strspn(hyp, " ");
+                length = strcspn(hyp, " ");
+                if(sw_kws_is_keyword(p_sw_data->keyphrases, hyp, length))
+                {
+                    sw_append_hyp(p_sw_data, hyp, length);
+                }
+                hyp += length;
+            }
+        }
+        else if(NULL != hyp)
+        {
+            sw_append_hyp(p_sw_data, hyp, strlen(hyp));
+        }
+    }
+
+    return 0;
+}
+
 int sw_calib_silence(sw_data_t *p_sw_data, int16_t *calib_data, size_t data_size)
 {
     int ret = 0;
@@ -151,17 +623,49 @@ exit0:
     return ret;
 }
 
+void sw_get_calib(sw_data_t *p_sw_data, sw_calib_t *calib_p)
+{
+    calib_p->noise_level = p_sw_data->cont->noise_level;
+    calib_p->thresh_sil = p_sw_data->cont->thresh_sil;
+    calib_p->thresh_speech = p_sw_data->cont->thresh_speech;
+}
+
+/*
+    Restore the state of a previous calibration instead of running 
+    sw_calib_silence. cont_ad_set_thresh takes the thresholds relative to the 
+    noise level.
+*/
+int sw_set_calib(sw_data_t *p_sw_data, sw_calib_t *calib_p)
+{
+    int ret;
+    cont_ad_t *cont = p_sw_data->cont;
+
+    ret = cont_ad_set_thresh(   cont, 
+                                calib_p->thresh_sil - calib_p->noise_level,
+                                calib_p->thresh_speech - calib_p->noise_level);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_set_calib) cont_ad_set_thresh "
+                        "failed\n");
+        return -1;
+    }
+
+    cont->noise_level = calib_p->noise_level;
+    cont->thresh_sil = calib_p->thresh_sil;
+    cont->thresh_speech = calib_p->thresh_speech;
+
+    return 0;
+}
+
 int sw_decode_speech(   sw_data_t *p_sw_data, 
                         int16_t *speech_data, 
                         size_t data_size, 
-                        char **p_hyp_out)
+                        char const **p_hyp_out)
 {
     int ret = 0;
     
-    char const* hyp = NULL;
-    
-    int16_t filtered_speech[(p_sw_data->cont->spf)];
-    int32_t filter_buffer_size = p_sw_data->cont->spf;
+    int16_t *filtered_speech = p_sw_data->filter_buffer;
+    int32_t filter_buffer_size = p_sw_data->filter_buffer_size;
     int32_t filtered_size = 0;
     
     cont_ad_t   *cont = p_sw_data->cont;
@@ -175,15 +679,13 @@ int sw_decode_speech(   sw_data_t *p_sw_data,
     
     int32_t silence_thresh = p_sw_data->silence_thresh;
     
-    const char* uttid;
-    
-    char    *hyp_out = NULL;
-    char    *helper = NULL;
+    /*the buffer only holds the hypotheses of this call*/
+    p_sw_data->hyp_length = 0;
     
-    sw_ad_buffer = speech_data;
-    sw_ad_buffer_size = data_size;
+    p_sw_data->ad_buffer = speech_data;
+    p_sw_data->ad_buffer_size = data_size;
     
-    while(sw_ad_buffer_size > 0)
+    while(p_sw_data->ad_buffer_size > 0)
     {
         filtered_size = cont_ad_read(cont, filtered_speech, filter_buffer_size);
         if(filtered_size < 0)
@@ -217,7 +719,7 @@ int sw_decode_speech(   sw_data_t *p_sw_data,
                     /*Process the non-silent samples read so far*/
                     ret = ps_process_raw(   ps, 
                                             filtered_speech, 
-                                            filter_buffer_size, 
+                                            filtered_size, 
                                             FALSE, 
                                             FALSE);
                     if(ret < 0)
@@ -240,7 +742,7 @@ int sw_decode_speech(   sw_data_t *p_sw_data,
                     /*Process the next set of non-silent samples*/
                     ret = ps_process_raw(   ps, 
                                             filtered_speech, 
-                                            filter_buffer_size, 
+                                            filtered_size, 
                                             FALSE, 
                                             FALSE);
                     if(ret < 0)
@@ -265,51 +767,14 @@ int sw_decode_speech(   sw_data_t *p_sw_data,
                         state = SW_STATE_SILENCE;
                         
                         /*Signal the end of an utterance*/
-                        ret = ps_end_utt(ps);
+                        ret = sw_end_utterance(p_sw_data);
                         if(ret < 0)
                         {
                             fprintf(stderr, "ERROR (cmusphinx) sw_decode_speech) "
-                                            "ps_end_utt failed\n");
+                                            "sw_end_utterance failed\n");
                             ret = -1;
                             goto exit0;
                         }
-                    
-                        /*Get the hypothesis*/
-                        hyp = ps_get_hyp(ps, NULL, &uttid);
-                        if(NULL != hyp)
-                        {
-                            /*Add the newly obtained hypthesis to the total output 
-                            hypothesis*/
-                            if(NULL == hyp_out)
-                            {
-                                hyp_out = strdup(hyp);
-                                if(NULL == hyp_out)
-                                {
-                                    fprintf(stderr, "ERROR (cmusphinx) sw_decode_speech) "
-                                                    "strdup failed\n");
-                                    ret = -1;
-                                    goto exit0;
-                                }
-                            }
-                            else
-                            {
-                                helper = (char*)realloc(hyp_out, 
-                                                        (strlen(hyp_out) + strlen(hyp) + 1));
-                                if(NULL == helper)
-                                {
-                                    fprintf(stderr, "ERROR (cmusphinx) sw_decode_speech) "
-                                                    "realloc failed to allocate memory "
-                                                    "for the hypothesis string\n");
-                                    ret = -1;
-                                    goto exit0;
-                                }
-                                else
-                                {
-                                    hyp_out = helper;
-                                    strcat(hyp_out, hyp);
-                                }
-                            }/*if(NULL == hyp_out) outer*/
-                        }/*if(NULL != hyp)*/
                     }/*if(samples_since_speech > silence_thresh)*/
                 }/*if(filtered_size > 0)*/
                 break;
@@ -322,32 +787,28 @@ int sw_decode_speech(   sw_data_t *p_sw_data,
                 break;
         }/*switch(state)*/
         
-    }/*sw_ad_buffer_size > 0*/
+    }/*p_sw_data->ad_buffer_size > 0*/
     
     ret = 0;
     
 exit0:
     p_sw_data->state = state;
     p_sw_data->last_speech_sample = last_speech_sample;
-    *p_hyp_out = hyp_out; 
-    sw_ad_buffer = NULL;
-    sw_ad_buffer_size = 0;
+    *p_hyp_out = (p_sw_data->hyp_length > 0)? p_sw_data->hyp_buffer : NULL; 
+    p_sw_data->ad_buffer = NULL;
+    p_sw_data->ad_buffer_size = 0;
     
     return ret;
 }
 
 int sw_extractlast_hyp( sw_data_t *p_sw_data, 
-                        char **p_hyp_out)
+                        char const **p_hyp_out)
 {
     int ret = 0;
     
     sw_state_t      state = p_sw_data->state;
-    ps_decoder_t    *ps = p_sw_data->ps;
-
-    const char* uttid;
     
-    char const*     hyp = NULL;
-    char            *hyp_out = NULL;
+    p_sw_data->hyp_length = 0;
     
     switch(state)
     {
@@ -359,29 +820,15 @@ int sw_extractlast_hyp( sw_data_t *p_sw_data,
             /*Transition to the SILENCE state*/
             state = SW_STATE_SILENCE;
             
-            /*Signal the end of an utterance*/
-            ret = ps_end_utt(ps);
+            /*Signal the end of an utterance and get the hypothesis*/
+            ret = sw_end_utterance(p_sw_data);
             if(ret < 0)
             {
                 fprintf(stderr, "ERROR (cmusphinx) sw_extractlast_hyp) "
-                                "ps_end_utt failed\n");
+                                "sw_end_utterance failed\n");
                 ret = -1;
                 goto exit0;
             }
-        
-            /*Get the hypothesis*/
-            hyp = ps_get_hyp(ps, NULL, &uttid);
-            if(NULL != hyp)
-            {
-                hyp_out = strdup(hyp);
-                if(NULL == hyp_out)
-                {
-                    fprintf(stderr, "ERROR (cmusphinx) sw_extractlast_hyp) "
-                                    "strdup failed\n");
-                    ret = -1;
-                    goto exit0;
-                }                
-            }
             
             break;
 
@@ -398,7 +845,7 @@ int sw_extractlast_hyp( sw_data_t *p_sw_data,
     p_sw_data->state = state;
     
     /*Output the hyp*/
-    *p_hyp_out = hyp_out; 
+    *p_hyp_out = (p_sw_data->hyp_length > 0)? p_sw_data->hyp_buffer : NULL; 
 
     /*No error has occured*/
     ret = 0;
@@ -429,7 +876,7 @@ int main(int argc, char** argv)
     
     sw_data_t *p_sw_data = NULL;
     
-    char *hyp;
+    char const *hyp;
     
     /*Check for the correct number of arguments*/
     if(2 != argc)
@@ -538,7 +985,6 @@ int main(int argc, char** argv)
         if(NULL != hyp)
         {
             printf("\r %li) \t%s \n", total_decoded, hyp);
-            free(hyp);
             hyp = NULL;
         }
         else
@@ -559,7 +1005,6 @@ int main(int argc, char** argv)
     if(NULL != hyp)
     {
         printf("\r %li) \t%s \n", total_decoded, hyp);
-        free(hyp);
         hyp = NULL;
     }
 
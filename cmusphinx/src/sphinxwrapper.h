@@ -1,3 +1,6 @@
+#ifndef SPHINXWRAPPER_HEADER
+#define SPHINXWRAPPER_HEADER
+
 #include <stdint.h>
 
 /*Header files related to the sphinx libraries*/
@@ -8,6 +11,12 @@
 
 #define SW_DEFAULT_SAMPLE_RATE (16000)
 
+/*alignment and size granularity of the filter buffer (bytes)*/
+#define SW_CACHE_LINE_SIZE (64)
+
+/*default size of the hypothesis buffer of a decoder (bytes)*/
+#define SW_DEFAULT_HYP_BUFFER_SIZE (4096)
+
 typedef enum
 {
     SW_STATE_NONE = 0,
@@ -15,6 +24,31 @@ typedef enum
     SW_STATE_SPEECH,
 } sw_state_t;
 
+/*Decoding modes, from light to heavy*/
+typedef enum
+{
+    /*n-gram language model search, the best hypothesis at utterance end*/
+    SW_MODE_LM = 0,
+    /*finite state search over a JSGF grammar*/
+    SW_MODE_JSGF,
+    /*keyphrase spotting, a JSGF grammar that loops over the keyphrases and
+    over garbage words from the dictionary*/
+    SW_MODE_KWS,
+    /*language model search, an N-best list at utterance end*/
+    SW_MODE_NBEST,
+    /*language model search, word lattice posteriors at utterance end*/
+    SW_MODE_LATTICE,
+    SW_MODE_COUNT
+} sw_mode_t;
+
+#define SW_DEFAULT_NBEST_COUNT (10)
+
+/*the garbage words of the keyphrase grammar: at most one per phone, no longer
+than SW_KWS_MAX_WORD - 1 characters, and their weight against a keyphrase*/
+#define SW_KWS_MAX_GARBAGE      (64)
+#define SW_KWS_MAX_WORD         (64)
+#define SW_KWS_GARBAGE_WEIGHT   (0.1)
+
 typedef struct sw_data_s
 {
     /*State for detecting speech*/
@@ -25,26 +59,85 @@ typedef struct sw_data_s
     cont_ad_t   *cont;
     ad_rec_t    ad_rec;
     
+    /*Samples that the fake a/d device (sw_ad_read) hands to the silence filter*/
+    int16_t     *ad_buffer;
+    int32_t     ad_buffer_size;
+    
+    /*Non-silent samples read from the silence filter, one frame (cont->spf 
+    samples) in whole cache lines, allocated with the decoder so that decoding
+    uses no stack proportional to the frame and the buffer can be mlocked*/
+    int16_t     *filter_buffer;
+    int32_t     filter_buffer_size;
+    
     int32_t     silence_thresh;
     
     /*PocketSphix speech decoder state*/
     ps_decoder_t *ps;
     
+    /*Work done at the end of an utterance, see sw_mode_t*/
+    sw_mode_t   mode;
+    int32_t     nbest_count;
+    /*the '|' separated keyphrases of the kws mode, only their words are added
+    to the hypotheses*/
+    char        *keyphrases;
+    
+    /*Preallocated buffer for the hypotheses of the utterances that ended in the
+    last call, so no memory is allocated while decoding. A size of 0 skips the 
+    extraction of the hypotheses.*/
+    char        *hyp_buffer;
+    size_t      hyp_buffer_size;
+    size_t      hyp_length;
+    /*number of hypotheses that did not fit into the buffer (and were truncated)*/
+    uint64_t    hyp_truncated;
+    
 } sw_data_t;
 
+/*The silence filter state computed by the calibration*/
+typedef struct sw_calib_s
+{
+    int32_t noise_level;
+    int32_t thresh_sil;
+    int32_t thresh_speech;
+} sw_calib_t;
+
 int allocate_sw_data(   sw_data_t   **pp_sw_data, 
                         char        *psconfig_filename,
                         int32_t silence_thresh);
 
+cmd_ln_t* sw_load_psconfig(char *psconfig_filename);
+
+int allocate_sw_data_config(sw_data_t   **pp_sw_data, 
+                            cmd_ln_t    *config,
+                            int32_t     silence_thresh);
+
 void free_sw_data(sw_data_t **pp_sw_data);
 
+int sw_set_hyp_buffer_size(sw_data_t *p_sw_data, size_t hyp_buffer_size);
+
+int sw_parse_mode(char *mode_name, sw_mode_t *mode_p);
+
+char const* sw_mode_name(sw_mode_t mode);
+
+int sw_write_kws_grammar(FILE *filep, char *keyphrases, char const *dict_filename);
+
+int sw_set_keyphrases(sw_data_t *p_sw_data, char *keyphrases);
+
+void sw_set_mode(sw_data_t *p_sw_data, sw_mode_t mode, int32_t nbest_count);
+
 int sw_calib_silence(sw_data_t *p_sw_data, int16_t *calib_data, size_t data_size);
 
+void sw_get_calib(sw_data_t *p_sw_data, sw_calib_t *calib_p);
+
+int sw_set_calib(sw_data_t *p_sw_data, sw_calib_t *calib_p);
+
+/*The hypothesis returned through p_hyp_out points into the hypothesis buffer of 
+p_sw_data, it stays valid until the next call and must not be freed*/
 int sw_decode_speech(   sw_data_t *p_sw_data, 
                         int16_t *speech_data, 
                         size_t data_size, 
-                        char **p_hyp_out);
+                        char const **p_hyp_out);
 
 int sw_extractlast_hyp( sw_data_t *p_sw_data, 
-                        char **p_hyp_out);
+                        char const **p_hyp_out);
 
+#endif
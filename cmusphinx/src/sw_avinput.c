@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "ffmpegwrapper.h"
+
+#include "sphinxwrapper.h"
+#include "sw_avinput.h"
+
+static int sw_avinput_write(int fd, int16_t *samples, int count)
+{
+    char    *src = (char*)samples;
+    size_t  bytes = (size_t)count * sizeof(int16_t);
+    size_t  done = 0;
+    ssize_t ret;
+
+    while(done < bytes)
+    {
+        ret = write(fd, &(src[done]), bytes - done);
+        if(ret < 0)
+        {
+            if(EINTR == errno)
+            {
+                continue;
+            }
+            perror("ERROR (cmusphinx) sw_avinput_write) write failed");
+            return -1;
+        }
+        done += ret;
+    }
+
+    return 0;
+}
+
+/*
+    Make sure that the output buffer can hold the resampled version of
+    input_samples more samples
+*/
+static int sw_avinput_reserve(  struct SwrContext   *pSwrCtx,
+                                int                 sample_rate_src,
+                                int                 input_samples,
+                                int16_t             **buffer_p,
+                                int                 *capacity_p)
+{
+    int64_t required;
+    int16_t *buffer;
+
+    required = swr_get_delay(pSwrCtx, sample_rate_src) + input_samples;
+    required = ((required * SW_DEFAULT_SAMPLE_RATE) / sample_rate_src) + 32;
+
+    if(required <= *capacity_p)
+    {
+        return 0;
+    }
+
+    buffer = (int16_t*)realloc(*buffer_p, (size_t)required * sizeof(int16_t));
+    if(NULL == buffer)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_avinput_reserve) realloc failed to "
+                        "allocate space for %li resampled samples\n", (long)required);
+        return -1;
+    }
+
+    *buffer_p = buffer;
+    *capacity_p = (int)required;
+    return 0;
+}
+
+int sw_avinput_convert( char    *input_filename,
+                        int     output_fd,
+                        size_t  *total_samples_p)
+{
+    int ret;
+
+    fw_decoder_t    decoder;
+    AVCodecContext  *pCodecCtx;
+    AVFrame         *pFrame;
+    int             got_frame;
+
+    struct SwrContext   *pSwrCtx;
+    int64_t             channel_layout_src;
+
+    int16_t *buffer = NULL;
+    int     capacity = 0;
+    int     converted;
+    size_t  total_samples = 0;
+
+    fw_init();
+
+    memset(&decoder, 0, sizeof(fw_decoder_t));
+    ret = fw_audio_init_decoder(input_filename, &decoder, FW_NO_BATCHED_READ);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) fw_audio_init_decoder "
+                        "failed to open \"%s\"\n", input_filename);
+        goto error0;
+    }
+    pCodecCtx = decoder.pCodecCtx;
+
+    channel_layout_src = pCodecCtx->channel_layout;
+    if(0 == channel_layout_src)
+    {
+        channel_layout_src = av_get_default_channel_layout(pCodecCtx->channels);
+    }
+
+    pSwrCtx = swr_alloc_set_opts(   NULL,
+                                    AV_CH_LAYOUT_MONO,
+                                    AV_SAMPLE_FMT_S16,
+                                    SW_DEFAULT_SAMPLE_RATE,
+                                    channel_layout_src,
+                                    pCodecCtx->sample_fmt,
+                                    pCodecCtx->sample_rate,
+                                    0,
+                                    NULL);
+    if(NULL == pSwrCtx)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) swr_alloc_set_opts "
+                        "failed\n");
+        goto error1;
+    }
+
+    ret = swr_init(pSwrCtx);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) swr_init failed\n");
+        goto error2;
+    }
+
+    pFrame = fw_alloc_frame();
+    if(NULL == pFrame)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) fw_alloc_frame "
+                        "failed\n");
+        goto error2;
+    }
+
+    /*decode and resample every frame*/
+    do
+    {
+        ret = fw_decode_nxtpkt(&decoder, pFrame, &got_frame);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) fw_decode_nxtpkt "
+                            "failed\n");
+            goto error3;
+        }
+
+        if((0 == got_frame) || (pFrame->nb_samples <= 0))
+        {
+            continue;
+        }
+
+        ret = sw_avinput_reserve(   pSwrCtx, pCodecCtx->sample_rate,
+                                    pFrame->nb_samples, &buffer, &capacity);
+        if(ret < 0)
+        {
+            goto error3;
+        }
+
+        converted = swr_convert(pSwrCtx,
+                                (uint8_t**)&buffer,
+                                capacity,
+                                (const uint8_t**)pFrame->extended_data,
+                                pFrame->nb_samples);
+        if(converted < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) swr_convert "
+                            "failed\n");
+            goto error3;
+        }
+
+        if(sw_avinput_write(output_fd, buffer, converted) < 0)
+        {
+            goto error3;
+        }
+        total_samples += converted;
+
+    }while(0 != got_frame);
+
+    /*flush the samples buffered in the resampler*/
+    do
+    {
+        ret = sw_avinput_reserve(pSwrCtx, pCodecCtx->sample_rate, 0, &buffer, &capacity);
+        if(ret < 0)
+        {
+            goto error3;
+        }
+
+        converted = swr_convert(pSwrCtx, (uint8_t**)&buffer, capacity, NULL, 0);
+        if(converted < 0)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) sw_avinput_convert) swr_convert "
+                            "failed to flush the resampler\n");
+            goto error3;
+        }
+
+        if(sw_avinput_write(output_fd, buffer, converted) < 0)
+        {
+            goto error3;
+        }
+        total_samples += converted;
+
+    }while(converted > 0);
+
+    free(buffer);
+    fw_free_decoded_data(&decoder, pFrame);
+    fw_free_frame(&pFrame);
+    swr_free(&pSwrCtx);
+    fw_free_decoder(&decoder);
+
+    *total_samples_p = total_samples;
+    return 0;
+
+error3:
+    free(buffer);
+    fw_free_decoded_data(&decoder, pFrame);
+    fw_free_frame(&pFrame);
+error2:
+    swr_free(&pSwrCtx);
+error1:
+    fw_free_decoder(&decoder);
+error0:
+    *total_samples_p = 0;
+    return -1;
+}
+
+#ifdef TEST_SW_AVINPUT
+
+#include <fcntl.h>
+
+/*
+gcc -Wall -Wmissing-prototypes -o sw_avinput_test -D TEST_SW_AVINPUT sw_avinput.c ../../ffmpeg/src/fw_*.c -I ../../ffmpeg/src -I /usr/local/include/sphinxbase/ -I /usr/local/include/pocketsphinx/ -lavformat -lswresample -lswscale -lavcodec -lavutil -luring -lz -lm -lpthread
+
+Run it on a container with more than one stream, such as a movie with a video
+track and several audio tracks. Only the first audio stream may be converted,
+so the samples written must cover the duration of that stream.
+*/
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    int fd;
+    size_t total_samples;
+    double seconds_converted;
+    double seconds_stream;
+
+    fw_decoder_t decoder;
+
+    if(3 != argc)
+    {
+        fprintf(stderr, "Usage: %s <input file> <raw output file>\n", argv[0]);
+        return -1;
+    }
+
+    fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        perror("ERROR (cmusphinx) main): open failed");
+        return -1;
+    }
+
+    ret = sw_avinput_convert(argv[1], fd, &total_samples);
+    close(fd);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) main): sw_avinput_convert failed\n");
+        return -1;
+    }
+
+    /*Open the file again to find out what the selected stream holds*/
+    memset(&decoder, 0, sizeof(fw_decoder_t));
+    ret = fw_audio_init_decoder(argv[1], &decoder, FW_NO_BATCHED_READ);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) main): fw_audio_init_decoder failed\n");
+        return -1;
+    }
+
+    seconds_converted = (double)total_samples / (double)SW_DEFAULT_SAMPLE_RATE;
+    seconds_stream = (AV_NOPTS_VALUE == decoder.pStream->duration)? 0.0 :
+                        (double)decoder.pStream->duration *
+                        av_q2d(decoder.pStream->time_base);
+
+    printf("%u streams, decoding stream %i\n", decoder.pFormatCtx->nb_streams,
+            decoder.stream_index);
+    printf("Converted %zu samples (%.2f s), the stream lasts %.2f s\n",
+            total_samples, seconds_converted, seconds_stream);
+
+    /*The packets of the other streams would add samples or fail the decoder*/
+    if((seconds_stream > 0.0) &&
+       ((seconds_converted < seconds_stream - 1.0) ||
+        (seconds_converted > seconds_stream + 1.0)))
+    {
+        fprintf(stderr, "ERROR (cmusphinx) main): the converted samples do not "
+                        "match the duration of the audio stream\n");
+        ret = -1;
+    }
+    else
+    {
+        ret = 0;
+    }
+
+    fw_free_decoder(&decoder);
+    return ret;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SW_AVINPUT_HEADER
+#define SW_AVINPUT_HEADER
+
+#include <stddef.h>
+
+/*
+    Format-agnostic audio input for the cmusphinx workload.
+
+    Decodes the first audio stream of any container/codec supported by ffmpeg
+    (through fw_init_decoder) and resamples it once, with swresample, to the
+    16kHz mono 16 bit samples that pocketsphinx expects. The raw samples are
+    written to output_fd, from where they can be streamed like the samples of a
+    WAV file.
+*/
+
+int sw_avinput_convert( char    *input_filename,
+                        int     output_fd,
+                        size_t  *total_samples_p);
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "sw_calib_cache.h"
+
+#define SW_FNV_OFFSET_BASIS (14695981039346656037ULL)
+#define SW_FNV_PRIME        (1099511628211ULL)
+
+static uint64_t sw_fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    size_t i;
+
+    for(i = 0; i < size; i++)
+    {
+        hash ^= (uint64_t)bytes[i];
+        hash *= SW_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*
+    FNV-1a over the total length, the number of calibrated samples, the
+    silence threshold and all the calibrated samples, so that windows that
+    differ anywhere get different keys.
+*/
+uint64_t sw_calib_cache_key(int16_t *samples,
+                            size_t  sample_count,
+                            size_t  total_samples,
+                            double  silence_thresh)
+{
+    uint64_t hash = SW_FNV_OFFSET_BASIS;
+    uint64_t total = (uint64_t)total_samples;
+    uint64_t calibrated = (uint64_t)sample_count;
+
+    hash = sw_fnv1a(hash, &total, sizeof(total));
+    hash = sw_fnv1a(hash, &calibrated, sizeof(calibrated));
+    hash = sw_fnv1a(hash, &silence_thresh, sizeof(silence_thresh));
+    hash = sw_fnv1a(hash, samples, sample_count * sizeof(int16_t));
+
+    return hash;
+}
+
+int sw_calib_cache_load(char        *cache_filename,
+                        uint64_t    key,
+                        sw_calib_t  *calib_p)
+{
+    int ret = 0;
+    FILE *filep;
+
+    char    *line = NULL;
+    size_t  line_size = 0;
+
+    uint64_t    entry_key;
+    sw_calib_t  entry;
+
+    filep = fopen(cache_filename, "r");
+    if(NULL == filep)
+    {
+        if(ENOENT == errno)
+        {
+            goto exit0;
+        }
+
+        fprintf(stderr, "ERROR (cmusphinx) sw_calib_cache_load) fopen failed to open "
+                        "the cache file \"%s\" ", cache_filename);
+        perror("");
+        ret = -1;
+        goto exit0;
+    }
+
+    while(getline(&line, &line_size, filep) > 0)
+    {
+        if('#' == line[0])
+        {
+            continue;
+        }
+
+        if(4 != sscanf( line, "%" SCNx64 " %" SCNd32 " %" SCNd32 " %" SCNd32,
+                        &entry_key,
+                        &(entry.noise_level),
+                        &(entry.thresh_sil),
+                        &(entry.thresh_speech)))
+        {
+            continue;
+        }
+
+        if(entry_key == key)
+        {
+            *calib_p = entry;
+            ret = 1;
+        }
+    }
+
+    free(line);
+    fclose(filep);
+exit0:
+    return ret;
+}
+
+int sw_calib_cache_store(   char        *cache_filename,
+                            uint64_t    key,
+                            sw_calib_t  *calib_p)
+{
+    int ret = 0;
+    FILE *filep;
+
+    /*entries are appended, so concurrent runs never lose each others results*/
+    filep = fopen(cache_filename, "a");
+    if(NULL == filep)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_calib_cache_store) fopen failed to open "
+                        "the cache file \"%s\" ", cache_filename);
+        perror("");
+        ret = -1;
+        goto exit0;
+    }
+
+    if(0 == ftell(filep))
+    {
+        fprintf(filep, "# key noise_level thresh_sil thresh_speech\n");
+    }
+
+    ret = fprintf(  filep, "%016" PRIx64 " %" PRId32 " %" PRId32 " %" PRId32 "\n",
+                    key,
+                    calib_p->noise_level,
+                    calib_p->thresh_sil,
+                    calib_p->thresh_speech);
+    if(ret < 0)
+    {
+        perror("ERROR (cmusphinx) sw_calib_cache_store) fprintf failed");
+        ret = -1;
+        goto exit1;
+    }
+    ret = 0;
+
+exit1:
+    if(0 != fclose(filep))
+    {
+        perror("ERROR (cmusphinx) sw_calib_cache_store) fclose failed");
+        ret = -1;
+    }
+exit0:
+    return ret;
+}
@@ -0,0 +1,35 @@
+#ifndef SW_CALIB_CACHE_HEADER
+#define SW_CALIB_CACHE_HEADER
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sphinxwrapper.h"
+
+/*
+    Persisted silence filter calibration for the cmusphinx workload.
+
+    The cont_ad thresholds computed by sw_calib_silence only depend on the
+    calibration samples, so they are kept in a small sidecar file and reused by
+    later runs on the same input. Entries are keyed by a hash of the input
+    length, the calibrated samples and the silence threshold of the run.
+
+    The cache file contains one line per entry:
+        <key> <noise_level> <thresh_sil> <thresh_speech>
+    Lines starting with '#' are ignored, and the last matching line wins.
+*/
+
+uint64_t sw_calib_cache_key(int16_t *samples,
+                            size_t  sample_count,
+                            size_t  total_samples,
+                            double  silence_thresh);
+
+/*returns 1 if the key was found, 0 if not (or there is no cache) and -1 on error*/
+int sw_calib_cache_load(char        *cache_filename,
+                        uint64_t    key,
+                        sw_calib_t  *calib_p);
+
+int sw_calib_cache_store(   char        *cache_filename,
+                            uint64_t    key,
+                            sw_calib_t  *calib_p);
+
+#endif
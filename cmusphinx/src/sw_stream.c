@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sw_stream.h"
+
+/*
+    Read the window starting at sample_start into buffer b, returns the number of
+    samples read or -1 on error
+*/
+static ssize_t sw_stream_read_window(sw_stream_t *stream_p, int32_t b, size_t sample_start)
+{
+    size_t  samples;
+    size_t  bytes;
+    size_t  done = 0;
+    ssize_t ret;
+    char    *dst = (char*)(stream_p->window[b]);
+    off_t   offset;
+
+    samples = stream_p->total_samples - sample_start;
+    samples = (samples > stream_p->window_samples)? stream_p->window_samples : samples;
+    bytes = samples * sizeof(int16_t);
+    offset = stream_p->data_offset + (off_t)(sample_start * sizeof(int16_t));
+
+    while(done < bytes)
+    {
+        ret = pread(stream_p->fd, &(dst[done]), bytes - done, offset + done);
+        if(ret < 0)
+        {
+            if(EINTR == errno)
+            {
+                continue;
+            }
+            perror("ERROR (cmusphinx) sw_stream_read_window) pread failed");
+            return -1;
+        }
+        if(0 == ret)
+        {
+            fprintf(stderr, "ERROR (cmusphinx) sw_stream_read_window) unexpected end "
+                            "of file\n");
+            return -1;
+        }
+        done += ret;
+    }
+
+    stream_p->window_start[b] = sample_start;
+    stream_p->window_valid[b] = samples;
+    return (ssize_t)samples;
+}
+
+static void* sw_stream_prefetcher(void *arg)
+{
+    sw_stream_t *stream_p = (sw_stream_t*)arg;
+    int32_t b;
+    size_t  next_start;
+    ssize_t ret;
+
+    pthread_mutex_lock(&(stream_p->lock));
+    while(1)
+    {
+        while((0 == stream_p->prefetch_pending) && (0 == stream_p->stop))
+        {
+            pthread_cond_wait(&(stream_p->cond), &(stream_p->lock));
+        }
+        if(stream_p->stop)
+        {
+            break;
+        }
+
+        /*load the window following the current one into the other buffer*/
+        b = 1 - stream_p->current;
+        next_start = stream_p->window_start[stream_p->current]
+                        + stream_p->window_samples;
+        next_start = (next_start >= stream_p->total_samples)? 0 : next_start;
+        pthread_mutex_unlock(&(stream_p->lock));
+
+        ret = sw_stream_read_window(stream_p, b, next_start);
+
+        pthread_mutex_lock(&(stream_p->lock));
+        stream_p->prefetch_error = (ret < 0);
+        stream_p->prefetch_pending = 0;
+        pthread_cond_broadcast(&(stream_p->cond));
+    }
+    pthread_mutex_unlock(&(stream_p->lock));
+
+    return NULL;
+}
+
+int sw_stream_open( sw_stream_t *stream_p,
+                    char        *filename,
+                    off_t       data_offset,
+                    size_t      total_samples,
+                    size_t      window_samples)
+{
+    int ret;
+    int32_t b;
+
+    memset(stream_p, 0, sizeof(sw_stream_t));
+
+    if(0 == total_samples)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_stream_open) \"%s\" contains no "
+                        "samples\n", filename);
+        goto error0;
+    }
+
+    stream_p->data_offset = data_offset;
+    stream_p->total_samples = total_samples;
+    stream_p->window_samples = ((0 == window_samples) || (window_samples > total_samples))?
+                                total_samples : window_samples;
+    stream_p->window_count = (stream_p->window_samples < total_samples)? 2 : 1;
+
+    stream_p->fd = open(filename, O_RDONLY);
+    if(stream_p->fd < 0)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_stream_open) Failed to open \"%s\"\n",
+                        filename);
+        perror("ERROR (cmusphinx) sw_stream_open) open failed");
+        goto error0;
+    }
+
+    for(b = 0; b < stream_p->window_count; b++)
+    {
+        stream_p->window[b] = (int16_t*)malloc(stream_p->window_samples * sizeof(int16_t));
+        if(NULL == stream_p->window[b])
+        {
+            fprintf(stderr, "ERROR (cmusphinx) sw_stream_open) malloc failed to "
+                            "allocate a window of %zu samples\n",
+                            stream_p->window_samples);
+            goto error1;
+        }
+    }
+
+    /*The first window is read synchronously*/
+    if(sw_stream_read_window(stream_p, 0, 0) < 0)
+    {
+        goto error1;
+    }
+    stream_p->current = 0;
+
+    if(stream_p->window_count < 2)
+    {
+        /*Everything is resident, the file is not needed anymore*/
+        close(stream_p->fd);
+        stream_p->fd = -1;
+        return 0;
+    }
+
+    pthread_mutex_init(&(stream_p->lock), NULL);
+    pthread_cond_init(&(stream_p->cond), NULL);
+
+    /*Prefetch the second window right away*/
+    stream_p->prefetch_pending = 1;
+    ret = pthread_create(&(stream_p->thread), NULL, sw_stream_prefetcher, stream_p);
+    if(0 != ret)
+    {
+        fprintf(stderr, "ERROR (cmusphinx) sw_stream_open) pthread_create failed "
+                        "(%s)\n", strerror(ret));
+        goto error2;
+    }
+
+    return 0;
+
+error2:
+    pthread_cond_destroy(&(stream_p->cond));
+    pthread_mutex_destroy(&(stream_p->lock));
+error1:
+    free(stream_p->window[0]);
+    free(stream_p->window[1]);
+    if(stream_p->fd >= 0)
+    {
+        close(stream_p->fd);
+    }
+error0:
+    memset(stream_p, 0, sizeof(sw_stream_t));
+    stream_p->fd = -1;
+    return -1;
+}
+
+void sw_stream_close(sw_stream_t *stream_p)
+{
+    if(stream_p->window_count > 1)
+    {
+        pthread_mutex_lock(&(stream_p->lock));
+        stream_p->stop = 1;
+        pthread_cond_broadcast(&(stream_p->cond));
+        pthread_mutex_unlock(&(stream_p->lock));
+
+        pthread_join(stream_p->thread, NULL);
+        pthread_cond_destroy(&(stream_p->cond));
+        pthread_mutex_destroy(&(stream_p->lock));
+    }
+
+    if(stream_p->fd >= 0)
+    {
+        close(stream_p->fd);
+    }
+    free(stream_p->window[0]);
+    free(stream_p->window[1]);
+
+    memset(stream_p, 0, sizeof(sw_stream_t));
+    stream_p->fd = -1;
+}
+
+/*
+    Returns a pointer to count samples starting at sample_index, or NULL on error.
+    Moving past the end of the current window switches to the prefetched one and
+    requests the window after it. This only blocks if the prefetch thread has not
+    finished reading yet.
+*/
+int16_t* sw_stream_get( sw_stream_t *stream_p,
+                        size_t      sample_index,
+                        size_t      count)
+{
+    int32_t b = stream_p->current;
+    int32_t error;
+
+    if( (sample_index < stream_p->window_start[b]) ||
+        ((sample_index + count) >
+            (stream_p->window_start[b] + stream_p->window_valid[b])))
+    {
+        if(stream_p->window_count < 2)
+        {
+            return NULL;
+        }
+
+        pthread_mutex_lock(&(stream_p->lock));
+        while(stream_p->prefetch_pending)
+        {
+            pthread_cond_wait(&(stream_p->cond), &(stream_p->lock));
+        }
+        error = stream_p->prefetch_error;
+        b = 1 - b;
+
+        if( error ||
+            (sample_index < stream_p->window_start[b]) ||
+            ((sample_index + count) >
+                (stream_p->window_start[b] + stream_p->window_valid[b])))
+        {
+            pthread_mutex_unlock(&(stream_p->lock));
+            fprintf(stderr, "ERROR (cmusphinx) sw_stream_get) samples %zu to %zu are "
+                            "not in the prefetched window\n",
+                            sample_index, sample_index + count);
+            return NULL;
+        }
+
+        /*switch windows and request the next one*/
+        stream_p->current = b;
+        stream_p->prefetch_pending = 1;
+        pthread_cond_broadcast(&(stream_p->cond));
+        pthread_mutex_unlock(&(stream_p->lock));
+    }
+
+    return &(stream_p->window[b][sample_index - stream_p->window_start[b]]);
+}
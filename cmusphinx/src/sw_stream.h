@@ -0,0 +1,57 @@
+#ifndef SW_STREAM_HEADER
+#define SW_STREAM_HEADER
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+    Bounded-memory sample store for the cmusphinx workload.
+
+    The 16 bit samples of a file are kept in at most two windows of
+    window_samples each. While the jobs decode one window, a prefetch thread reads
+    the next one (wrapping around to the start of the file) into the other, so
+    the file I/O happens outside of the timed jobs. If the whole file fits into
+    one window, it is read once and no thread is started.
+
+    The window length should be a multiple of the frame length, so that no frame
+    straddles two windows.
+*/
+
+    typedef struct sw_stream_s
+    {
+        int         fd;
+        /*byte offset of the first sample in the file*/
+        off_t       data_offset;
+        size_t      total_samples;
+        size_t      window_samples;
+
+        /*the windows, their first sample and number of valid samples*/
+        int16_t     *window[2];
+        size_t      window_start[2];
+        size_t      window_valid[2];
+        int32_t     window_count;
+        int32_t     current;
+
+        /*prefetch thread*/
+        pthread_t       thread;
+        pthread_mutex_t lock;
+        pthread_cond_t  cond;
+        int32_t         prefetch_pending;
+        int32_t         prefetch_error;
+        int32_t         stop;
+    } sw_stream_t;
+
+int sw_stream_open( sw_stream_t *stream_p,
+                    char        *filename,
+                    off_t       data_offset,
+                    size_t      total_samples,
+                    size_t      window_samples);
+
+void sw_stream_close(sw_stream_t *stream_p);
+
+int16_t* sw_stream_get( sw_stream_t *stream_p,
+                        size_t      sample_index,
+                        size_t      count);
+
+#endif
@@ -2,17 +2,51 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
+#include <time.h>
 #include "PeSoRTA.h"
 #include "PeSoRTA_helper.h"
 
 #include "ffmpegwrapper.h"
 
+static inline uint64_t PeSoRTA_ffmpeg_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
 typedef enum
 {
     PeSoRTA_FFMPEG_DECODE = 0,
     PeSoRTA_FFMPEG_ENCODE
 } PeSoRTA_ffmpeg_type_t;
 
+#define PeSoRTA_FFMPEG_MAX_RENDITIONS (8)
+
+/*A rendition of the ABR ladder, and the latency of its part of the jobs*/
+typedef struct PeSoRTA_ffmpeg_rendition_s
+{
+    /*0 keeps the value of the -w, -h and -b options*/
+    int         width;
+    int         height;
+    int         bit_rate;
+
+    AVPacket    packet;
+    int         status;
+
+    /*the output file of the rendition, with -O*/
+    fw_muxer_t  muxer;
+
+    /*time of the current job in the preprocessor and in the encoder (ns)*/
+    uint64_t    job_preproc_ns;
+    uint64_t    job_encode_ns;
+
+    uint64_t    jobs;
+    uint64_t    busy_ns;
+    uint64_t    max_ns;
+} PeSoRTA_ffmpeg_rendition_t;
+
 typedef struct PeSoRTA_ffmpeg_s
 {
     PeSoRTA_ffmpeg_type_t coder_type;
@@ -23,16 +57,50 @@ typedef struct PeSoRTA_ffmpeg_s
     union
     {
         fw_decoder_t    decoder;
-        fw_encoder_t    encoder;
+        /*one encoder per rendition, which share the decoded frames*/
+        fw_encoder_t    *encoders;
     } coder;
     
-    union
-    {
-        AVFrame     frame;
-        AVPacket    packet;
-    } output;
+    /*the output frame of the decoder*/
+    AVFrame     frame;
     
     fw_eparams_t params;
+
+    /*the renditions of the encoder, every job feeds the next frame to all of
+    them, on the workers of the pool if there is one*/
+    PeSoRTA_ffmpeg_rendition_t  renditions[PeSoRTA_FFMPEG_MAX_RENDITIONS];
+    int32_t                     rendition_count;
+    int32_t                     worker_count;
+    int32_t                     pin_workers;
+    PeSoRTA_pool_t              *pool;
+
+    /*latency of the jobs of a ladder (ns)*/
+    uint64_t    jobs;
+    uint64_t    busy_ns;
+    uint64_t    max_ns;
+
+    /*loop mode of the decoder: -1 is off, 0 loops forever, and any other value
+    is the number of jobs to run*/
+    int64_t loop_jobs;
+    int64_t jobs_done;
+
+    /*how the decoder reads the input: FW_NO_BATCHED_READ, FW_BATCHED_READ or
+    FW_URING_READ, and the chunks that io_uring reads ahead*/
+    int32_t read_mode;
+    int32_t uring_depth;
+
+    /*time of every job of the encoder spent in the preprocessor and in the
+    encoder (ns), two values per job, written to the stage log by uninit*/
+    char        *stage_log_name;
+
+    /*the encoded packets are muxed into this file by a writer thread*/
+    char        *output_name;
+    uint64_t    *stage_ns;
+    long        stage_jobs;
+    long        stage_space;
+
+    /*the loaded config file, which holds the option strings*/
+    PeSoRTA_config_t config;
     
 } PeSoRTA_ffmpeg_t;
 
@@ -47,6 +115,10 @@ char *workload_name(void)
 /*
 "-I: input file name (file name)\n"\
 "-M: media type (decoder only)  \n"\
+"-l: loop over the input for this many jobs, 0 loops forever (decoder only)\n"\
+"-r: read mode, 0 reads the packets in the jobs, 1 reads all of them at init, 2 reads them\n"\
+"    in the jobs from a file that io_uring reads ahead with O_DIRECT (decoder only)\n"\
+"-d: number of chunks that io_uring reads ahead with -r 2 (decoder only)\n"\
 "\n the following parameters are encoder specific:\n"\
 "-C: codec name (codec name)    \n"\
 "-b: bit rate (bits per second) \n"\
@@ -58,161 +130,171 @@ char *workload_name(void)
 "-f: sample/pixel format        \n"\
 "-c: channel layout             \n"\
 "-s: sample rate                \n"\
+"-p: preprocess all frames at init, so jobs only encode (0 or 1)\n"\
+"-T: stage log file, the preprocess and encode time of every job (file name)\n"\
+"-R: a rendition of the ABR ladder, <width>x<height>[@<bit rate>] (repeatable)\n"\
+"-N: number of worker threads that encode the renditions (0 encodes them in turn)\n"\
+"-P: pin the worker threads to their own cpus (0 or 1)\n"\
+"-o: a codec option, <key>=<value>, like preset=ultrafast or cpu-used=8 (repeatable)\n"\
+"-y: map a y4m input and encode straight from the mapping, instead of decoding it (0 or 1)\n"\
+"-S: rescaler algorithm: fast_bilinear, bilinear, bicubic, lanczos or area\n"\
+"-F: convert same-size YUV420P/NV12 frames with the vectorized kernels instead of\n"\
+"    libswscale, off unless set (0 or 1)\n"\
+"-O: output file, the container is guessed from the extension, and every rendition of a\n"\
+"    ladder gets its index before the extension (file name)\n"\
 */
+static int PeSoRTA_ffmpeg_parse_codec_opt(char *optarg, void *dest)
+{
+    AVDictionary **codec_opts_p = (AVDictionary**)dest;
+    char *value;
+    int ret;
+
+    value = strchr(optarg, '=');
+    if((NULL == value) || (value == optarg) || ('\0' == value[1]))
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_codec_opt) expected "
+                        "<key>=<value>\n");
+        return -1;
+    }
+
+    /*av_dict_set copies the key and the value*/
+    *value = '\0';
+    ret = av_dict_set(codec_opts_p, optarg, value + 1, 0);
+    *value = '=';
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_codec_opt) av_dict_set failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int PeSoRTA_ffmpeg_parse_rendition(char *optarg, void *dest)
+{
+    PeSoRTA_ffmpeg_t *workload_state = (PeSoRTA_ffmpeg_t*)dest;
+    PeSoRTA_ffmpeg_rendition_t *rendition_p;
+    char *endptr;
+
+    if(workload_state->rendition_count >= PeSoRTA_FFMPEG_MAX_RENDITIONS)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_rendition) more than %i "
+                        "renditions\n", PeSoRTA_FFMPEG_MAX_RENDITIONS);
+        return -1;
+    }
+    rendition_p = &(workload_state->renditions[workload_state->rendition_count]);
+
+    errno = 0;
+    rendition_p->width = (int)strtol(optarg, &endptr, 10);
+    if(errno || ('x' != *endptr) || (rendition_p->width <= 0))
+    {
+        goto error0;
+    }
+    optarg = endptr + 1;
+    rendition_p->height = (int)strtol(optarg, &endptr, 10);
+    if(errno || (rendition_p->height <= 0))
+    {
+        goto error0;
+    }
+
+    rendition_p->bit_rate = 0;
+    if('@' == *endptr)
+    {
+        optarg = endptr + 1;
+        rendition_p->bit_rate = (int)strtol(optarg, &endptr, 10);
+        if(errno || (rendition_p->bit_rate <= 0))
+        {
+            goto error0;
+        }
+    }
+    if('\0' != *endptr)
+    {
+        goto error0;
+    }
+
+    workload_state->rendition_count++;
+    return 0;
+
+error0:
+    fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_rendition) expected "
+                    "<width>x<height>[@<bit rate>]\n");
+    return -1;
+}
+
 static int PeSoRTA_ffmpeg_parse_config(char *configfile_name, PeSoRTA_ffmpeg_t *workload_state)
 {
     int ret = 0;
-    FILE *configfile_p;
 
-	/*parsing variables*/
-    char *optstring = "I:C:M:b:m:w:h:g:B:f:c:s:";
-    int  opt;
-    char *optarg;
-    
-    /*define some options flags*/
-    int I_flag = 0;
-    int C_flag = 0;
-    int M_flag = 0;    
     char *media_type_s = NULL;
-    int b_flag = 0;
-    int m_flag = 0;
-    /*int w_flag = 0;*/
-    /*int h_flag = 0;*/
-    /*int g_flag = 0;*/
-    /*int B_flag = 0;*/
-    int f_flag = 0;
-    /*int s_flag = 0;*/
-
-    /*Open the config file*/
-    configfile_p = fopen(configfile_name, "r");
-    if(NULL == configfile_p)
-    {
-        fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_config) fopen failed\n");
-        ret = -1;
-        goto exit0;
-    }
+    /*the channel layout is accepted, but not used by the encoder*/
+    char *channel_layout_s = NULL;
+    fw_eparams_t *params_p = &(workload_state->params);
+
+    PeSoRTA_config_schema_t schema[] =
+    {
+        {'I', PeSoRTA_CONFIG_STRING, &(workload_state->file_name), NULL, 0.0, 0.0, NULL},
+        {'C', PeSoRTA_CONFIG_STRING, &(params_p->codec_name),    NULL, 0.0, 0.0, NULL},
+        {'M', PeSoRTA_CONFIG_STRING, &media_type_s,             NULL, 0.0, 0.0, NULL},
+        {'l', PeSoRTA_CONFIG_INT64,  &(workload_state->loop_jobs), "-1", -1.0, INT64_MAX, NULL},
+        {'r', PeSoRTA_CONFIG_INT32,  &(workload_state->read_mode), "1", 0.0, 2.0, NULL},
+        {'d', PeSoRTA_CONFIG_INT32,  &(workload_state->uring_depth), "8", 1.0, 4096.0, NULL},
+        {'b', PeSoRTA_CONFIG_INT32,  &(params_p->bit_rate),      NULL, 1.0, INT32_MAX, NULL},
+        {'m', PeSoRTA_CONFIG_STRING, &(params_p->me_method_s),   NULL, 0.0, 0.0, NULL},
+        {'w', PeSoRTA_CONFIG_INT32,  &(params_p->width),         NULL, 1.0, INT32_MAX, NULL},
+        {'h', PeSoRTA_CONFIG_INT32,  &(params_p->height),        NULL, 1.0, INT32_MAX, NULL},
+        {'g', PeSoRTA_CONFIG_INT32,  &(params_p->gop_size),      NULL, 0.0, INT32_MAX, NULL},
+        {'B', PeSoRTA_CONFIG_INT32,  &(params_p->max_b_frames),  NULL, 0.0, INT32_MAX, NULL},
+        {'f', PeSoRTA_CONFIG_STRING, &(params_p->format),        NULL, 0.0, 0.0, NULL},
+        {'c', PeSoRTA_CONFIG_STRING, &channel_layout_s,         NULL, 0.0, 0.0, NULL},
+        {'s', PeSoRTA_CONFIG_INT32,  &(params_p->sample_rate),   NULL, 1.0, INT32_MAX, NULL},
+        {'p', PeSoRTA_CONFIG_INT32,  &(params_p->preproc_at_init), "0", 0.0, 1.0, NULL},
+        {'T', PeSoRTA_CONFIG_STRING, &(workload_state->stage_log_name), NULL, 0.0, 0.0, NULL},
+        {'R', PeSoRTA_CONFIG_CALLBACK, workload_state,          NULL, 0.0, 0.0,
+                PeSoRTA_ffmpeg_parse_rendition},
+        {'N', PeSoRTA_CONFIG_INT32,  &(workload_state->worker_count), "0", 0.0, 64.0, NULL},
+        {'P', PeSoRTA_CONFIG_INT32,  &(workload_state->pin_workers), "1", 0.0, 1.0, NULL},
+        {'o', PeSoRTA_CONFIG_CALLBACK, &(params_p->codec_opts), NULL, 0.0, 0.0,
+                PeSoRTA_ffmpeg_parse_codec_opt},
+        {'y', PeSoRTA_CONFIG_INT32,  &(params_p->direct_read),   "1", 0.0, 1.0, NULL},
+        {'O', PeSoRTA_CONFIG_STRING, &(workload_state->output_name), NULL, 0.0, 0.0, NULL},
+        {'S', PeSoRTA_CONFIG_STRING, &(params_p->scaler),        NULL, 0.0, 0.0, NULL},
+        {'F', PeSoRTA_CONFIG_INT32,  &(params_p->fast_convert),  "0", 0.0, 1.0, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
 
     /*Workload_state should already be zeroed out*/
 
     /*Initialize the encoder parameters*/
     DEFALUT_EPARAMS(&(workload_state->params));
 
-    /*Parse the file, line by line*/
-    while(!feof(configfile_p))
+    /*the option strings point into the loaded config file*/
+    ret = PeSoRTA_config_load(configfile_name, schema, &(workload_state->config));
+    if(ret < 0)
     {
-        ret = PeSoRTA_getconfigopt(configfile_p, optstring, &opt, &optarg);
-        if(ret == -1)
-        {
-            if(!feof(configfile_p))
-            {
-                fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_config) "
-                                "PeSoRTA_getconfigopt failed\n");
-                ret = -1;
-                goto exit1;
-            }
-            else
-            {
-                ret = 0;
-                continue;
-            }
-        }
-        
-        if(opt == -1)
-        {
-                fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_config) config file "
-                                "contains bad line:\n\t\"%s\"\n", optarg);                
-                ret = -1;
-                free(optarg);
-                goto exit1;
-        }
-
-        if(optarg == NULL)
-        {
-            fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_config) config file contains "
-                            "valid option (%c) without argument!\n", (int)opt);
-            ret = -1;
-            goto exit1;
-        }
-        
-        switch(opt)
-        {
-            case 'I':
-                I_flag = 1;
-                workload_state->file_name = optarg;
-                break;
-
-            case 'C':
-                C_flag = 1;
-                workload_state->params.codec_name = optarg;
-                break;
-
-            case 'M':
-                M_flag = 1;
-                media_type_s = optarg;
-                break;
-
-            case 'b':
-                b_flag = 1;
-                workload_state->params.bit_rate = (int)strtoul(optarg, NULL, 0);
-                free(optarg);
-                break;
-
-            case 'm':
-                m_flag = 1;
-                workload_state->params.me_method_s = optarg;
-                break;
-
-            case 'w':
-                workload_state->params.width = (int)strtoul(optarg, NULL, 0);
-                free(optarg);
-                break;
-        
-            case 'h':
-                workload_state->params.height = (int)strtoul(optarg, NULL, 0);
-                free(optarg);
-                break;
-            
-            case 'g':
-                workload_state->params.gop_size = (int)strtoul(optarg, NULL, 0);
-                free(optarg);
-                break;
-
-            case 'B':
-                workload_state->params.max_b_frames = (int)strtoul(optarg, NULL, 0);
-                free(optarg);
-                break;
-                
-            case 'f':
-                f_flag = 1;
-                workload_state->params.format = optarg;
-                break;
-                
-            case 's':
-                workload_state->params.sample_rate = (int)strtoul(optarg, NULL, 0);
-                free(optarg);
-                break;
-        }/*switch(opt)*/
-    }/*while(!feof(configfile_p))*/
+        fprintf(stderr, "ERROR: PeSoRTA_ffmpeg_parse_config) PeSoRTA_config_load "
+                        "failed\n");
+        goto exit0;
+    }
 
     /*The I flag must be specified for both types of coders*/
-    if(0 == I_flag)
+    if(NULL == workload_state->file_name)
     {
         fprintf(stderr, "ERROR (ffmpeg) PeSoRTA_ffmpeg_parse_config) : Options file must "
                         "specify input media file. \n");
         ret = -1;
-        goto exit2;
+        goto exit1;
     }    
     
     /*Either the C flag or the M flag must be specified*/
-    if(0 == C_flag)
+    if(NULL == params_p->codec_name)
     {
-        if(0 == M_flag)
+        if(NULL == media_type_s)
         {
             fprintf(stderr, "ERROR (ffmpeg) PeSoRTA_ffmpeg_parse_config) : Options file "
                             "must specify the M option for the decoder or the C option "
                             "for the encoder. \n");
             ret = -1;
-            goto exit2;
+            goto exit1;
         }
         else
         {
@@ -220,6 +302,13 @@ static int PeSoRTA_ffmpeg_parse_config(char *configfile_name, PeSoRTA_ffmpeg_t *
             media type must be specified*/
             workload_state->coder_type = PeSoRTA_FFMPEG_DECODE;
             
+            if(NULL != params_p->codec_opts)
+            {
+                fprintf(stderr, "WARNING: (ffmpeg) PeSoRTA_ffmpeg_parse_config) the -o "
+                                "option only applies to the encoder, ignoring it\n");
+                av_dict_free(&(params_p->codec_opts));
+            }
+
             if(0 == strcmp(media_type_s, "audio"))
             {
                 workload_state->media_type = AVMEDIA_TYPE_AUDIO;
@@ -234,7 +323,7 @@ static int PeSoRTA_ffmpeg_parse_config(char *configfile_name, PeSoRTA_ffmpeg_t *
                                 "argument for the -M option: must be \"audio\" or "
                                 "\"video\".\n");
                 ret = -1;
-                goto exit2;
+                goto exit1;
             }
         }
     }
@@ -243,42 +332,70 @@ static int PeSoRTA_ffmpeg_parse_config(char *configfile_name, PeSoRTA_ffmpeg_t *
         /*If the C flag is specified, this is an encoding workload*/
         workload_state->coder_type = PeSoRTA_FFMPEG_ENCODE;
 
+        if(workload_state->loop_jobs >= 0)
+        {
+            fprintf(stderr, "WARNING: (ffmpeg) PeSoRTA_ffmpeg_parse_config) the -l "
+                            "option only applies to the decoder, ignoring it\n");
+            workload_state->loop_jobs = -1;
+        }
+
+        if(FW_BATCHED_READ != workload_state->read_mode)
+        {
+            fprintf(stderr, "WARNING: (ffmpeg) PeSoRTA_ffmpeg_parse_config) the -r "
+                            "option only applies to the decoder, ignoring it\n");
+            workload_state->read_mode = FW_BATCHED_READ;
+        }
+
         /*The bit-rate flag must be specified for the encoder*/
-        if(0 == b_flag)
+        if(0 == params_p->bit_rate)
         {
             fprintf(stderr, "ERROR (ffmpeg) PeSoRTA_ffmpeg_parse_config) : Options file must "
                             "specify a bit rate. \n");
             ret = -1;
-            goto exit2;
+            goto exit1;
         }
-     
-        /*prevent the codec name from being freed*/
-        C_flag = 0;
-        
-        /*prevent the motion estimation method from being freed*/
-        m_flag = 0;
     }
 
-    /*prevent the pixel or sample format from being freed*/    
-    f_flag = 0;
-
-    /*prevent the input file name from being freed*/
-    I_flag = 0;
+    return 0;
 
-exit2:
-    if( 1 == I_flag){ free(workload_state->file_name); }
-    if( 1 == C_flag){ free(workload_state->params.codec_name); }
-    if( 1 == M_flag){ free(media_type_s); }
-    if( 1 == m_flag){ free(workload_state->params.me_method_s); }
-    if( 1 == f_flag){ free(workload_state->params.format); }
-    
 exit1:
-    fclose(configfile_p);
-    
+    PeSoRTA_config_unload(&(workload_state->config));
 exit0:
+    av_dict_free(&(params_p->codec_opts));
     return ret;
 }
 
+/*
+    The output file of a rendition, a ladder inserts the index of the rendition
+    before the extension
+*/
+static void PeSoRTA_ffmpeg_output_name(PeSoRTA_ffmpeg_t *workload_state, int index,
+                                       char *buffer, size_t buffer_size)
+{
+    char *name = workload_state->output_name;
+    char *extension = strrchr(name, '.');
+
+    /*a dot in a directory name is no extension*/
+    if((NULL != extension) && (NULL != strchr(extension, '/')))
+    {
+        extension = NULL;
+    }
+
+    if(workload_state->rendition_count <= 1)
+    {
+        snprintf(buffer, buffer_size, "%s", name);
+    }
+    else if(NULL == extension)
+    {
+        snprintf(buffer, buffer_size, "%s.%i", name, index);
+    }
+    else
+    {
+        snprintf(buffer, buffer_size, "%.*s.%i%s", (int)(extension - name), name,
+                 index, extension);
+    }
+}
+
 /*
     allocate space for the relevant data structures
     the workload root directory is not necessary in this case
@@ -288,6 +405,10 @@ exit0:
 int workload_init(char *configfile, void **state_p, long *job_count_p)
 {
     int ret = 0;
+    int i;
+    PeSoRTA_ffmpeg_rendition_t  *rendition_p;
+    fw_eparams_t                eparams[PeSoRTA_FFMPEG_MAX_RENDITIONS];
+    char                        output_name[1024];
     
     PeSoRTA_ffmpeg_t *workload_state;
     
@@ -315,36 +436,164 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
     /*setup the coder*/
     if(PeSoRTA_FFMPEG_DECODE == workload_state->coder_type)
     {
-        ret = fw_init_decoder(  workload_state->file_name,
-                                &(workload_state->coder.decoder),
-                                workload_state->media_type, 
-                                1/*batched_read*/);
+        if(FW_URING_READ == workload_state->read_mode)
+        {
+            ret = fw_init_decoder_uring(workload_state->file_name,
+                                        &(workload_state->coder.decoder),
+                                        workload_state->media_type,
+                                        (uint32_t)workload_state->uring_depth,
+                                        FW_URING_CHUNK_SIZE);
+        }
+        else
+        {
+            ret = fw_init_decoder(  workload_state->file_name,
+                                    &(workload_state->coder.decoder),
+                                    workload_state->media_type, 
+                                    (unsigned char)workload_state->read_mode);
+        }
         if(ret < 0)
         {
             fprintf(stderr, "ERROR: (ffmpeg) workload_init) fw_init_decoder failed\n");
             goto error2;
         }
         
+        /*A loop needs at least one packet to start over from*/
+        if((workload_state->loop_jobs >= 0) &&
+           (0 == workload_state->coder.decoder.packets_read))
+        {
+            fprintf(stderr, "ERROR: (ffmpeg) workload_init) cannot loop over an input "
+                            "without packets, the loop starts over from the packets "
+                            "read at init (-r 1)\n");
+            fw_free_decoder(&(workload_state->coder.decoder));
+            ret = -1;
+            goto error2;
+        }
+
         /*Initialize the output frame*/
-        avcodec_get_frame_defaults(&(workload_state->output.frame));
+        avcodec_get_frame_defaults(&(workload_state->frame));
 
     }
     else /* (PeSoRTA_FFMPEG_ENCODE == workload_state->coder_type) */
     {
-        ret = fw_init_encoder(  workload_state->file_name,
-                                &(workload_state->coder.encoder),
-                                &(workload_state->params) );
-        if(ret < 0)
+        /*Without a ladder, there is a single rendition with the -w, -h and -b
+        parameters*/
+        if(0 == workload_state->rendition_count)
+        {
+            workload_state->rendition_count = 1;
+        }
+
+        /*Some containers want the codec headers out of band*/
+        if((NULL != workload_state->output_name) &&
+           fw_muxer_global_header(workload_state->output_name))
+        {
+            ret = av_dict_set(&(workload_state->params.codec_opts), "flags",
+                              "+global_header", AV_DICT_APPEND);
+            if(ret < 0)
+            {
+                fprintf(stderr, "ERROR: (ffmpeg) workload_init) av_dict_set failed\n");
+                goto error2;
+            }
+        }
+
+        /*The parameters of every rendition*/
+        for(i = 0; i < workload_state->rendition_count; i++)
         {
-            fprintf(stderr, "ERROR: (ffmpeg) workload_init) fw_init_encoder failed\n");
+            rendition_p = &(workload_state->renditions[i]);
+            eparams[i] = workload_state->params;
+            if(0 != rendition_p->width)
+            {
+                eparams[i].width  = rendition_p->width;
+                eparams[i].height = rendition_p->height;
+            }
+            if(0 != rendition_p->bit_rate)
+            {
+                eparams[i].bit_rate = rendition_p->bit_rate;
+            }
+        }
+
+        workload_state->coder.encoders = (fw_encoder_t*)calloc(
+                                            workload_state->rendition_count,
+                                            sizeof(fw_encoder_t));
+        if(NULL == workload_state->coder.encoders)
+        {
+            fprintf(stderr, "ERROR: (ffmpeg) workload_init) calloc failed to "
+                            "allocate the encoders\n");
+            ret = -1;
             goto error2;
         }
+
+        /*All the renditions encode the frames decoded once*/
+        ret = fw_init_encoders( workload_state->file_name,
+                                workload_state->coder.encoders,
+                                eparams,
+                                workload_state->rendition_count);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: (ffmpeg) workload_init) fw_init_encoders failed\n");
+            goto error3;
+        }
+
+        /*Every rendition is muxed into a file of its own, through a ring with
+        room for all of its packets, so that the jobs never wait for the file*/
+        for(i = 0; (NULL != workload_state->output_name) &&
+                   (i < workload_state->rendition_count); i++)
+        {
+            PeSoRTA_ffmpeg_output_name(workload_state, i, output_name,
+                                       sizeof(output_name));
+            ret = fw_init_muxer(output_name,
+                                workload_state->coder.encoders[i].pCodecCtx,
+                                fw_encoder_max_packets(
+                                    &(workload_state->coder.encoders[i])),
+                                &(workload_state->renditions[i].muxer));
+            if(ret < 0)
+            {
+                fprintf(stderr, "ERROR: (ffmpeg) workload_init) fw_init_muxer failed "
+                                "for \"%s\"\n", output_name);
+                goto error4;
+            }
+        }
         
-        /*Initialize the output packet*/
-        av_init_packet(&(workload_state->output.packet));
-        /* packet data will be allocated by the encoder*/
-        workload_state->output.packet.data = NULL;
-        workload_state->output.packet.size = 0;
+        /*Room for the stage times of every frame and of the flushing jobs*/
+        if(NULL != workload_state->stage_log_name)
+        {
+            workload_state->stage_space =
+                (long)workload_state->coder.encoders[0].frames_available + 16;
+            workload_state->stage_ns = (uint64_t*)calloc(
+                                            2*workload_state->stage_space,
+                                            sizeof(uint64_t));
+            if(NULL == workload_state->stage_ns)
+            {
+                fprintf(stderr, "ERROR: (ffmpeg) workload_init) calloc failed to "
+                                "allocate the stage times\n");
+                ret = -1;
+                goto error4;
+            }
+        }
+
+        /*The renditions of a job run on the workers of a pool*/
+        if((workload_state->worker_count > 0) && (workload_state->rendition_count > 1))
+        {
+            ret = PeSoRTA_pool_init(&(workload_state->pool),
+                                    workload_state->worker_count,
+                                    workload_state->pin_workers);
+            if(ret < 0)
+            {
+                fprintf(stderr, "ERROR: (ffmpeg) workload_init) PeSoRTA_pool_init "
+                                "failed\n");
+                free(workload_state->stage_ns);
+                goto error4;
+            }
+        }
+
+        /*Initialize the output packets*/
+        for(i = 0; i < workload_state->rendition_count; i++)
+        {
+            rendition_p = &(workload_state->renditions[i]);
+            av_init_packet(&(rendition_p->packet));
+            /* packet data will be allocated by the encoder*/
+            rendition_p->packet.data = NULL;
+            rendition_p->packet.size = 0;
+        }
     }
     
     /*set return values*/
@@ -354,33 +603,45 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
     for the encoder*/
     if(PeSoRTA_FFMPEG_DECODE == workload_state->coder_type)
     {
-        *job_count_p = workload_state->coder.decoder.packets_read;
+        /*an endless loop has no job count, and without a batched read the
+        packets are only counted by the container*/
+        if(workload_state->loop_jobs > 0)
+        {
+            *job_count_p = (long)workload_state->loop_jobs;
+        }
+        else if(0 == workload_state->loop_jobs)
+        {
+            *job_count_p = -1;
+        }
+        else if(FW_BATCHED_READ == workload_state->read_mode)
+        {
+            *job_count_p = (long)workload_state->coder.decoder.packets_read;
+        }
+        else
+        {
+            *job_count_p = (workload_state->coder.decoder.frames_available > 0)?
+                            (long)workload_state->coder.decoder.frames_available : -1;
+        }
     }
     else /* (PeSoRTA_FFMPEG_ENCODE == workload_state->coder_type) */
     {
-        *job_count_p = workload_state->coder.encoder.frames_available;
+        *job_count_p = workload_state->coder.encoders[0].frames_available;
     }
     
     return 0;
     
-error2:
-    /*free the options strings*/
-    if(NULL != workload_state->file_name)
-    {   
-        free(workload_state->file_name);
-    }
-    if(NULL != workload_state->params.codec_name)
-    {  
-        free(workload_state->params.codec_name);
-    }
-    if(NULL != workload_state->params.me_method_s)
-    {
-        free(workload_state->params.me_method_s);
-    }    
-    if(NULL != workload_state->params.format)
+error4:
+    for(i = 0; i < workload_state->rendition_count; i++)
     {
-        free(workload_state->params.format);
+        fw_free_muxer(&(workload_state->renditions[i].muxer));
     }
+    fw_free_encoders(workload_state->coder.encoders, workload_state->rendition_count);
+error3:
+    free(workload_state->coder.encoders);
+error2:
+    /*free the options strings*/
+    av_dict_free(&(workload_state->params.codec_opts));
+    PeSoRTA_config_unload(&(workload_state->config));
 error1:
     free(workload_state);
 error0:
@@ -389,6 +650,79 @@ error0:
     return -1;
 }
 
+/*
+    Feed the next frame to the encoder of a rendition, task of the pool
+*/
+static int PeSoRTA_ffmpeg_encode_rendition(void *arg, int32_t index)
+{
+    int ret = 0;
+    int consumed_frame;
+    int got_packet;
+    uint64_t start_ns;
+    uint64_t latency_ns;
+    uint64_t preproc_ns;
+    uint64_t encode_ns;
+
+    PeSoRTA_ffmpeg_t            *workload_state = (PeSoRTA_ffmpeg_t*)arg;
+    PeSoRTA_ffmpeg_rendition_t  *rendition_p = &(workload_state->renditions[index]);
+    fw_encoder_t                *pEnc = &(workload_state->coder.encoders[index]);
+    AVPacket                    *pPkt = &(rendition_p->packet);
+
+    rendition_p->job_preproc_ns = 0;
+    rendition_p->job_encode_ns  = 0;
+
+    /*A rendition may be flushed before the others*/
+    if(0 != pEnc->nomore_packets)
+    {
+        goto exit0;
+    }
+
+    start_ns   = PeSoRTA_ffmpeg_now_ns();
+    preproc_ns = pEnc->preproc_ns;
+    encode_ns  = pEnc->encode_ns;
+
+    do
+    {
+        /*Get the next encoded packet*/
+        ret = fw_encode_step(   pEnc,
+                                &consumed_frame,
+                                pPkt,
+                                &got_packet);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: (ffmpeg) PeSoRTA_ffmpeg_encode_rendition) "
+                            "fw_encode_step failed for rendition %i\n", index);
+            goto exit0;
+        }
+        
+        /*If a packet is produced, hand it to the writer thread, or free the data,
+        and reinitialize the packet*/
+        if((0 != got_packet) && (NULL != rendition_p->muxer.pFormatCtx))
+        {
+            fw_muxer_push(&(rendition_p->muxer), pPkt);
+        }
+        else if(0 != got_packet)
+        {
+            av_free_packet(pPkt);
+            av_init_packet(pPkt);
+            pPkt->data = NULL; // packet data will be allocated by the encoder
+            pPkt->size = 0;
+        }
+
+    }while( (0 == consumed_frame) && (0 == pEnc->nomore_packets));
+
+    latency_ns = PeSoRTA_ffmpeg_now_ns() - start_ns;
+    (rendition_p->jobs)++;
+    rendition_p->busy_ns += latency_ns;
+    rendition_p->max_ns = (latency_ns > rendition_p->max_ns)?
+                            latency_ns : rendition_p->max_ns;
+    rendition_p->job_preproc_ns = pEnc->preproc_ns - preproc_ns;
+    rendition_p->job_encode_ns  = pEnc->encode_ns - encode_ns;
+
+exit0:
+    return ret;
+}
+
 /*
     Do the actual "computation"
 */
@@ -396,13 +730,14 @@ int perform_job(void *state)
 {
     int ret = 0;
     int got_frame;
-    int consumed_frame;
-    int got_packet;
+    int i;
 
     fw_decoder_t    *pDec;
     AVFrame         *pFrame;
-    fw_encoder_t    *pEnc;
-    AVPacket        *pPkt;
+    uint64_t        job_start_ns;
+    uint64_t        job_ns;
+    uint64_t        preproc_ns;
+    uint64_t        encode_ns;
     
     PeSoRTA_ffmpeg_t *workload_state = (PeSoRTA_ffmpeg_t*)state;
     if(NULL == workload_state)
@@ -414,7 +749,16 @@ int perform_job(void *state)
     if(PeSoRTA_FFMPEG_DECODE == workload_state->coder_type)
     {
         pDec    = &(workload_state->coder.decoder);
-        pFrame  = &(workload_state->output.frame);
+        pFrame  = &(workload_state->frame);
+
+        /*Return 1 once the jobs of the loop are done*/
+        if((workload_state->loop_jobs > 0) &&
+           (workload_state->jobs_done >= workload_state->loop_jobs))
+        {
+            ret = 1;
+            goto exit0;
+        }
+
         ret = fw_decode_nxtpkt( pDec, 
                                 pFrame,
                                 &got_frame);
@@ -423,50 +767,280 @@ int perform_job(void *state)
             fprintf(stderr, "ERROR: (ffmpeg) perform_job) fw_decode_nxtpkt failed\n");
             goto exit0;
         }
+
+        /*In loop mode, the end of the input (after the buffered frames have been
+        drained) wraps around to the first keyframe*/
+        if((0 == got_frame) && (workload_state->loop_jobs >= 0))
+        {
+            ret = fw_decoder_rewind(pDec);
+            if(ret < 0)
+            {
+                fprintf(stderr, "ERROR: (ffmpeg) perform_job) fw_decoder_rewind "
+                                "failed\n");
+                goto exit0;
+            }
+
+            ret = fw_decode_nxtpkt( pDec, 
+                                    pFrame,
+                                    &got_frame);
+            if((ret < 0) || (0 == got_frame))
+            {
+                fprintf(stderr, "ERROR: (ffmpeg) perform_job) fw_decode_nxtpkt failed "
+                                "to decode a frame after rewinding the input\n");
+                ret = -1;
+                goto exit0;
+            }
+        }
+        (workload_state->jobs_done)++;
         
         /*Return 1 if there are no more frames*/
         ret = !(got_frame);
     }
     else  /* (PeSoRTA_FFMPEG_ENCODE == workload_state->coder_type) */
     {
-        pEnc  = &(workload_state->coder.encoder);
-        pPkt  = &(workload_state->output.packet);
+        job_start_ns = PeSoRTA_ffmpeg_now_ns();
 
-        do
+        /*Feed the next frame to every rendition*/
+        if(NULL != workload_state->pool)
         {
-            /*Get the next encoded packet*/
-            ret = fw_encode_step(   pEnc,
-                                    &consumed_frame,
-                                    pPkt,
-                                    &got_packet);
-            if(ret < 0)
+            ret = PeSoRTA_pool_run( workload_state->pool,
+                                    PeSoRTA_ffmpeg_encode_rendition,
+                                    workload_state,
+                                    workload_state->rendition_count);
+        }
+        else
+        {
+            for(i = 0; (i < workload_state->rendition_count) && (ret >= 0); i++)
             {
-                fprintf(stderr, "ERROR: (ffmpeg) perform_job) fw_encode_step failed\n");
-                
-                goto exit0;
+                ret = PeSoRTA_ffmpeg_encode_rendition(workload_state, i);
             }
-            
-            /*If a packet is produced, free the data and reinitialize the packet*/
-            if(0 != got_packet)
+        }
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: (ffmpeg) perform_job) failed to encode the "
+                            "renditions\n");
+            goto exit0;
+        }
+
+        job_ns = PeSoRTA_ffmpeg_now_ns() - job_start_ns;
+        (workload_state->jobs)++;
+        workload_state->busy_ns += job_ns;
+        workload_state->max_ns = (job_ns > workload_state->max_ns)?
+                                    job_ns : workload_state->max_ns;
+
+        /*Split the time of the job between the two stages, summed over the
+        renditions*/
+        if((NULL != workload_state->stage_ns) &&
+           (workload_state->stage_jobs < workload_state->stage_space))
+        {
+            preproc_ns = 0;
+            encode_ns  = 0;
+            for(i = 0; i < workload_state->rendition_count; i++)
             {
-                av_free_packet(pPkt);
-                av_init_packet(pPkt);
-                pPkt->data = NULL; // packet data will be allocated by the encoder
-                pPkt->size = 0;
+                preproc_ns += workload_state->renditions[i].job_preproc_ns;
+                encode_ns  += workload_state->renditions[i].job_encode_ns;
             }
-
-        }while( (0 == consumed_frame) && (0 == pEnc->nomore_packets));
+            workload_state->stage_ns[2*workload_state->stage_jobs]     = preproc_ns;
+            workload_state->stage_ns[2*workload_state->stage_jobs + 1] = encode_ns;
+            (workload_state->stage_jobs)++;
+        }
         
-        /*Return 1 if there are no more packets*/
-        ret = !(!(pEnc->nomore_packets));
+        /*Return 1 once none of the renditions has packets left*/
+        ret = 1;
+        for(i = 0; i < workload_state->rendition_count; i++)
+        {
+            if(0 == workload_state->coder.encoders[i].nomore_packets)
+            {
+                ret = 0;
+            }
+        }
     }
     
 exit0:
     return ret;
 }
 
+/*
+    Write the preprocess and encode time of every job to the stage log, and print
+    the mean and worst case of both stages
+*/
+static void PeSoRTA_ffmpeg_report_stages(PeSoRTA_ffmpeg_t *workload_state)
+{
+    FILE        *log_h;
+    long        jobi;
+    uint64_t    total_ns[2] = {0, 0};
+    uint64_t    max_ns[2] = {0, 0};
+    uint64_t    *job_ns;
+    int         i;
+    fw_preproc_state_t *pPreproc = &(workload_state->coder.encoders[0].preproc);
+    fw_audio_preproc_t *pAudio;
+
+    log_h = fopen(workload_state->stage_log_name, "w");
+    if(NULL == log_h)
+    {
+        fprintf(stderr, "ERROR: (ffmpeg) PeSoRTA_ffmpeg_report_stages) failed to open "
+                        "the stage log \"%s\" ", workload_state->stage_log_name);
+        perror("");
+    }
+    else
+    {
+        fprintf(log_h, "job,preproc_ns,encode_ns\n");
+    }
+
+    for(jobi = 0; jobi < workload_state->stage_jobs; jobi++)
+    {
+        job_ns = &(workload_state->stage_ns[2*jobi]);
+        for(i = 0; i < 2; i++)
+        {
+            total_ns[i] += job_ns[i];
+            max_ns[i] = (job_ns[i] > max_ns[i])? job_ns[i] : max_ns[i];
+        }
+
+        if(NULL != log_h)
+        {
+            fprintf(log_h, "%li,%llu,%llu\n", jobi, (unsigned long long)job_ns[0],
+                           (unsigned long long)job_ns[1]);
+        }
+    }
+
+    if(NULL != log_h)
+    {
+        fclose(log_h);
+    }
+
+    printf("ffmpeg: %li jobs, preprocessing %s", workload_state->stage_jobs,
+            (workload_state->coder.encoders[0].preproced_at_init)? "at init" : "inline");
+    if(AVMEDIA_TYPE_VIDEO == pPreproc->media_type)
+    {
+        printf(", converting with %s", fw_video_preproc_path(pPreproc->preproc_state));
+    }
+    else if((AVMEDIA_TYPE_AUDIO == pPreproc->media_type) &&
+            (NULL != pPreproc->preproc_state))
+    {
+        pAudio = (fw_audio_preproc_t*)pPreproc->preproc_state;
+        printf(", ring of %i samples moved %llu times and grown %llu times",
+                pAudio->ring_size, (unsigned long long)pAudio->ring_wraps,
+                (unsigned long long)pAudio->ring_grows);
+    }
+    printf("\n");
+    printf("stage,mean_us,max_us\n");
+    printf("preproc,%.1f,%.1f\n",
+            (0 == workload_state->stage_jobs)? 0.0 :
+                ((double)total_ns[0] / (double)workload_state->stage_jobs) / 1000.0,
+            (double)max_ns[0] / 1000.0);
+    printf("encode,%.1f,%.1f\n",
+            (0 == workload_state->stage_jobs)? 0.0 :
+                ((double)total_ns[1] / (double)workload_state->stage_jobs) / 1000.0,
+            (double)max_ns[1] / 1000.0);
+}
+
+/*
+    Print how well the io_uring read-ahead kept ahead of the demuxer
+*/
+static void PeSoRTA_ffmpeg_report_uring(PeSoRTA_ffmpeg_t *workload_state)
+{
+    const fw_uring_stats_t *pStats = fw_uring_stats(workload_state->coder.decoder.pUring);
+
+    printf("ffmpeg: io_uring read-ahead of %i chunks of %i bytes, %s\n",
+            workload_state->uring_depth, FW_URING_CHUNK_SIZE,
+            (pStats->direct)? "O_DIRECT" : "page cache");
+    printf("reads,chunks,bytes,short_reads,stalls,mean_stall_us,max_stall_us,restarts\n");
+    printf("%llu,%llu,%llu,%llu,%llu,%.1f,%.1f,%llu\n",
+            (unsigned long long)pStats->reads,
+            (unsigned long long)pStats->chunks_read,
+            (unsigned long long)pStats->bytes_read,
+            (unsigned long long)pStats->short_reads,
+            (unsigned long long)pStats->stalls,
+            (0 == pStats->stalls)? 0.0 :
+                ((double)pStats->stall_ns / (double)pStats->stalls) / 1000.0,
+            (double)pStats->max_stall_ns / 1000.0,
+            (unsigned long long)pStats->restarts);
+}
+
+/*
+    Print the backlog of the writer threads and their throughput
+*/
+static void PeSoRTA_ffmpeg_report_muxers(PeSoRTA_ffmpeg_t *workload_state)
+{
+    fw_muxer_t  *pMux;
+    int         i;
+
+    printf("ffmpeg: muxing to \"%s\"\n", workload_state->output_name);
+    printf("rendition,ring,queued,dropped,max_backlog,written,bytes,"
+           "write_MBps,mean_write_us,max_write_us\n");
+    for(i = 0; i < workload_state->rendition_count; i++)
+    {
+        pMux = &(workload_state->renditions[i].muxer);
+        printf("%i,%u,%llu,%llu,%u,%llu,%llu,%.1f,%.1f,%.1f\n", i,
+                pMux->ring_size,
+                (unsigned long long)pMux->packets_queued,
+                (unsigned long long)pMux->packets_dropped,
+                pMux->max_backlog,
+                (unsigned long long)pMux->packets_written,
+                (unsigned long long)pMux->bytes_written,
+                (0 == pMux->write_ns)? 0.0 :
+                    ((double)pMux->bytes_written * 1000.0) / (double)pMux->write_ns,
+                (0 == pMux->packets_written)? 0.0 :
+                    ((double)pMux->write_ns / (double)pMux->packets_written) / 1000.0,
+                (double)pMux->max_write_ns / 1000.0);
+    }
+}
+
+/*
+    Print the latency of every rendition of the ladder and of the whole jobs
+*/
+static void PeSoRTA_ffmpeg_report_renditions(PeSoRTA_ffmpeg_t *workload_state)
+{
+    PeSoRTA_ffmpeg_rendition_t  *rendition_p;
+    fw_encoder_t                *pEnc;
+    int                         i;
+
+    printf("ffmpeg: %i renditions, %i workers\n", workload_state->rendition_count,
+            (NULL == workload_state->pool)? 0 : workload_state->worker_count);
+    printf("rendition,width,height,bit_rate,jobs,mean_latency_us,max_latency_us\n");
+    for(i = 0; i < workload_state->rendition_count; i++)
+    {
+        rendition_p = &(workload_state->renditions[i]);
+        pEnc = &(workload_state->coder.encoders[i]);
+        printf("%i,%i,%i,%i,%llu,%.1f,%.1f\n", i,
+                pEnc->pCodecCtx->width, pEnc->pCodecCtx->height,
+                pEnc->pCodecCtx->bit_rate,
+                (unsigned long long)rendition_p->jobs,
+                (0 == rendition_p->jobs)? 0.0 :
+                    ((double)rendition_p->busy_ns / (double)rendition_p->jobs) / 1000.0,
+                (double)rendition_p->max_ns / 1000.0);
+    }
+    printf("job,%llu,%.1f,%.1f\n", (unsigned long long)workload_state->jobs,
+            (0 == workload_state->jobs)? 0.0 :
+                ((double)workload_state->busy_ns / (double)workload_state->jobs) / 1000.0,
+            (double)workload_state->max_ns / 1000.0);
+}
+
+/*
+    Trade the quality of the decoded frames for a lower decoding cost, the
+    encoder has only one quality level
+*/
+int workload_set_quality(void *state, int level)
+{
+    PeSoRTA_ffmpeg_t *workload_state = (PeSoRTA_ffmpeg_t*)state;
+
+    if((NULL == workload_state) || (level < 0))
+    {
+        return -1;
+    }
+
+    if(PeSoRTA_FFMPEG_DECODE != workload_state->coder_type)
+    {
+        return 0;
+    }
+
+    return fw_decoder_set_quality(&(workload_state->coder.decoder), level);
+}
+
 int workload_uninit(void *state)
 {
+    int ret = 0;
+    int i;
     PeSoRTA_ffmpeg_t *workload_state = (PeSoRTA_ffmpeg_t*)state;
     
     if(NULL == workload_state)
@@ -479,39 +1053,62 @@ int workload_uninit(void *state)
     {
         /*free the output frame data*/
         fw_free_copied_data(workload_state->media_type, 
-                            &(workload_state->output.frame));
+                            &(workload_state->frame));
+        if(NULL != workload_state->coder.decoder.pUring)
+        {
+            PeSoRTA_ffmpeg_report_uring(workload_state);
+        }
         /*free the decoder*/
         fw_free_decoder(&(workload_state->coder.decoder));
     }
     else  /* (PeSoRTA_FFMPEG_ENCODE == workload_state->coder_type) */
     {
-        /*free the otuput packet*/
-        av_free_packet(&(workload_state->output.packet));
-        /*free the encoder*/
-        fw_free_encoder(&(workload_state->coder.encoder));
+        if(NULL != workload_state->stage_ns)
+        {
+            PeSoRTA_ffmpeg_report_stages(workload_state);
+            free(workload_state->stage_ns);
+        }
+
+        /*stop the workers*/
+        PeSoRTA_pool_free(&(workload_state->pool));
+
+        /*write out the queued packets and close the output files*/
+        if(NULL != workload_state->output_name)
+        {
+            for(i = 0; i < workload_state->rendition_count; i++)
+            {
+                if(fw_free_muxer(&(workload_state->renditions[i].muxer)) < 0)
+                {
+                    fprintf(stderr, "ERROR: (ffmpeg) workload_uninit) the output of "
+                                    "rendition %i is incomplete\n", i);
+                    ret = -1;
+                }
+            }
+            PeSoRTA_ffmpeg_report_muxers(workload_state);
+        }
+
+        if(workload_state->rendition_count > 1)
+        {
+            PeSoRTA_ffmpeg_report_renditions(workload_state);
+        }
+
+        /*free the otuput packets*/
+        for(i = 0; i < workload_state->rendition_count; i++)
+        {
+            av_free_packet(&(workload_state->renditions[i].packet));
+        }
+        /*free the encoders*/
+        fw_free_encoders(workload_state->coder.encoders, workload_state->rendition_count);
+        free(workload_state->coder.encoders);
     }
     
     /*free the options strings*/
-    if(NULL != workload_state->file_name)
-    {   
-        free(workload_state->file_name);
-    }
-    if(NULL != workload_state->params.codec_name)
-    {  
-        free(workload_state->params.codec_name);
-    }
-    if(NULL != workload_state->params.me_method_s)
-    {
-        free(workload_state->params.me_method_s);
-    }    
-    if(NULL != workload_state->params.format)
-    {
-        free(workload_state->params.format);
-    }
+    av_dict_free(&(workload_state->params.codec_opts));
+    PeSoRTA_config_unload(&(workload_state->config));
 
     /*free the main workload_state data structure*/
     free(workload_state);
 exit0:
-    return 0;
+    return ret;
 }
 
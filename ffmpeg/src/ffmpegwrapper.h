@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <pthread.h>
 #include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
 #include "libswresample/swresample.h"
@@ -6,6 +7,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/avutil.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/cpu.h"
 
 extern int av_registered;
 
@@ -23,6 +25,46 @@ do{                         \
     Decoding related structures, functions, and definitions.
 */
 
+/*
+    io_uring read-ahead related structures, functions, and definitions.
+*/
+
+/*the default read-ahead of the decoder, in chunks in flight and in bytes per chunk*/
+#define FW_URING_DEPTH      (8)
+#define FW_URING_CHUNK_SIZE (262144)
+
+typedef struct fw_uring_s fw_uring_t;
+
+typedef struct fw_uring_stats_s
+{
+    /*set if the file was opened with O_DIRECT*/
+    int                 direct;
+    /*calls of the demuxer*/
+    uint64_t            reads;
+    uint64_t            chunks_read;
+    uint64_t            bytes_read;
+    /*the reads that completed short and
+    were queued again for the rest*/
+    uint64_t            short_reads;
+    /*the reads that waited for their chunk*/
+    uint64_t            stalls;
+    uint64_t            stall_ns;
+    uint64_t            max_stall_ns;
+    /*the seeks out of the read-ahead window*/
+    uint64_t            restarts;
+} fw_uring_stats_t;
+
+int fw_uring_open(  char            *filename,
+                    uint32_t        depth,
+                    uint32_t        chunk_size,
+                    fw_uring_t      **ppUring);
+
+AVIOContext* fw_uring_avio(fw_uring_t *pUring);
+
+const fw_uring_stats_t* fw_uring_stats(fw_uring_t *pUring);
+
+void fw_uring_close(fw_uring_t **ppUring);
+
 typedef int (*fw_decode_t)(  AVCodecContext*, 
                                 AVFrame*,	
                                 int *, 
@@ -40,8 +82,19 @@ typedef struct fw_decoder_s
 
     unsigned char       batched_read;
 	AVPacket        	*pPackets;
+	/*the read-ahead engine that the demuxer
+	reads through with FW_URING_READ*/
+	fw_uring_t          *pUring;
 	uint64_t	        packets_read;
 	uint64_t            packets_decoded;
+	/*the packets of the other streams in the container*/
+	uint64_t            packets_skipped;
+	/*the packet that decoding restarts from after a rewind*/
+	uint64_t            first_keyframe;
+	uint64_t            rewinds;
+
+	/*the quality level, 0 decodes everything*/
+	int                 quality;
 
     uint64_t            frames_available;	
 	uint64_t            frames_decoded;
@@ -49,7 +102,10 @@ typedef struct fw_decoder_s
 
 enum {
     FW_NO_BATCHED_READ  = 0,    
-    FW_BATCHED_READ  = 1
+    FW_BATCHED_READ  = 1,
+    /*read the packets in the jobs, from a
+    file that io_uring reads ahead*/
+    FW_URING_READ  = 2
 };
 
 int fw_init_decoder(char                *filename, 
@@ -57,6 +113,12 @@ int fw_init_decoder(char                *filename,
                     enum AVMediaType    media_type, 
                     unsigned char       batched_read);
 
+int fw_init_decoder_uring(  char                *filename,
+                            fw_decoder_t        *pDec,
+                            enum AVMediaType    media_type,
+                            uint32_t            depth,
+                            uint32_t            chunk_size);
+
 #define fw_audio_init_decoder(filename, pDec, batched_read) \
         fw_init_decoder(filename, pDec, AVMEDIA_TYPE_AUDIO, batched_read)
 
@@ -86,8 +148,34 @@ int fw_decode_nxtpkt(fw_decoder_t   *pDec,
                      AVFrame        *pFrame,
                      int            *pgot_frame);
 
+int fw_decoder_rewind(fw_decoder_t *pDec);
+
+/*the lowest quality level of the decoder*/
+#define FW_QUALITY_MAX (5)
+
+int fw_decoder_set_quality(fw_decoder_t *pDec, int quality);
+
 void fw_free_decoder(fw_decoder_t *pDec);
 
+/*
+    Direct y4m reading related structures, functions, and definitions.
+*/
+
+typedef struct fw_y4m_s
+{
+    uint8_t             *pMap;
+    size_t              map_size;
+    /*describes the frames, like the codec context of a decoder*/
+    AVCodecContext      *pCodecCtx;
+    /*the frame data points into the mapping*/
+    AVFrame             **pFrameArray;
+    uint64_t            frames_available;
+} fw_y4m_t;
+
+int fw_y4m_open(char *filename, fw_y4m_t *pY4m);
+
+void fw_y4m_close(fw_y4m_t *pY4m);
+
 /*
     General encoding related structures, functions, and definitions.
 */
@@ -123,6 +211,26 @@ typedef struct fw_eparams_s
     char    *format;
     
     int     sample_rate;
+
+    /*run the preprocessor on all the frames in fw_init_encoder, so that
+    fw_encode_step only encodes*/
+    int     preproc_at_init;
+
+    /*map a y4m input file, instead of decoding it, and encode the frames
+    straight from the mapping*/
+    int     direct_read;
+
+    /*AVOptions of the codec context or of the codec (priv_data), like the
+    x264 preset or the libvpx cpu-used, set before the codec is opened*/
+    AVDictionary *codec_opts;
+
+    /*the algorithm of the rescaler: fast_bilinear, bilinear, bicubic,
+    lanczos or area*/
+    char    *scaler;
+
+    /*convert same-size YUV420P/NV12 frames with the kernels of
+    fw_video.c, instead of libswscale*/
+    int     fast_convert;
 } fw_eparams_t;
 
 #define DEFALUT_EPARAMS(fw_eparams_p)\
@@ -136,8 +244,15 @@ do{\
         (fw_eparams_p)->max_b_frames= 0;    \
         (fw_eparams_p)->format      = NULL; \
         (fw_eparams_p)->sample_rate = 0;    \
+        (fw_eparams_p)->preproc_at_init = 0;\
+        (fw_eparams_p)->direct_read = 1;    \
+        (fw_eparams_p)->codec_opts  = NULL; \
+        (fw_eparams_p)->scaler      = NULL; \
+        (fw_eparams_p)->fast_convert= 0;    \
 }while(0)
 
+int fw_set_codec_opts(AVCodecContext *pCodecCtx, AVDictionary *codec_opts);
+
 /*
     Audio preprocessing related structures, functions, and definitions.
 */
@@ -153,13 +268,27 @@ typedef struct fw_audio_preproc_s
     int                 smpl_rate_dst;
     
     struct SwrContext   *pSwrCtx;
-    uint8_t             **swrdata;
-    int                 buffersize_swrdata;
-    int                 framesize_swrdata;
-    int                 offset_swrdata;
-    int                 issilent_swrdata;
+
+    /*The resampler writes into the ring,
+    and the frames of the encoder point into
+    it. The samples [ring_read, ring_write)
+    are not in a frame yet*/
+    uint8_t             **ringdata;
+    int                 ring_size;
+    int                 ring_read;
+    int                 ring_write;
+    int                 ring_planes;
+    /*bytes per sample in a plane*/
+    int                 ring_sample_size;
+    /*the plane pointers of the frame that
+    points into the ring*/
+    uint8_t             **slicedata;
+    /*how often the samples left over were
+    moved to the start of the ring, and how
+    often the ring was too small*/
+    uint64_t            ring_wraps;
+    uint64_t            ring_grows;
     int                 framesize_dst;
-    int                 offset_dst;
 } fw_audio_preproc_t;
 
 int fw_audio_init_preproc(   AVCodecContext     *pCodecCtx_src,
@@ -188,6 +317,17 @@ void fw_audio_free_preproc_frame(AVFrame *pFrame);
     Video preprocessing related structures, functions, and definitions.
 */
 
+/*interleave count U and V samples into UV pairs (NV12), and back*/
+typedef void (*fw_video_interleave_t)(  const uint8_t   *pU,
+                                        const uint8_t   *pV,
+                                        uint8_t         *pUV,
+                                        int             count);
+
+typedef void (*fw_video_deinterleave_t)(const uint8_t   *pUV,
+                                        uint8_t         *pU,
+                                        uint8_t         *pV,
+                                        int             count);
+
 typedef struct fw_video_preproc_s
 {
     enum AVPixelFormat  pix_fmt_src;
@@ -196,11 +336,25 @@ typedef struct fw_video_preproc_s
     int width;
     int height;
     
+    /*NULL if the frames are converted by
+    the kernels below*/
     struct SwsContext   *pSwsCtx;
+
+    /*the row kernels of the same-size
+    YUV420P/NV12 conversions, picked for
+    the cpu at init*/
+    fw_video_interleave_t   interleave;
+    fw_video_deinterleave_t deinterleave;
+    /*"swscale", or the kernels in use*/
+    const char          *path;
 } fw_video_preproc_t;
 
 enum Motion_Est_ID fw_video_get_me_method(char * method_name);
 
+int fw_video_get_sws_flags(char *scaler_name);
+
+const char* fw_video_preproc_path(void *preproc_state);
+
 int fw_video_init_preproc(   AVCodecContext     *pCodecCtx_src,
                              AVCodec            *pCodec_dst,
                              AVCodecContext     *pCodecCtx_dst,
@@ -251,6 +405,10 @@ typedef struct fw_preproc_state_s
     fw_end_preproc_t    end_preproc;
     fw_alloc_preproc_frame_t    alloc_preproc_frame;
     fw_free_preproc_frame_t     free_preproc_frame;
+    /*set if the frames produced by preproc
+    point into the memory of the preprocessor,
+    and are only valid until the next call*/
+    int                 frames_borrowed;
 } fw_preproc_state_t;
 
 int fw_init_preproc(AVCodecContext  *pCodecCtx_src,
@@ -273,6 +431,17 @@ typedef struct fw_encoder_s
 
     AVFrame         	**pFrameArray;
     uint64_t            frames_available;
+    /*This following flag is set if the 
+    frames of pFrameArray were already 
+    preprocessed by fw_init_encoder*/
+    int                 preproced_at_init;
+    /*This following flag is set if the 
+    frames of pFrameArray are freed with
+    the encoder, and not shared*/
+    int                 owns_frames;
+    /*The mapped y4m file that the frames
+    of pFrameArray point into, if any*/
+    fw_y4m_t            *pY4m;
     
     fw_preproc_state_t  preproc;
     /*This following flag is set if 
@@ -292,6 +461,11 @@ typedef struct fw_encoder_s
     new frames and no more packets are 
     extracted from it*/
     int                 nomore_packets;
+
+    /*time spent in the preprocessor and
+    in the encoder by fw_encode_step (ns)*/
+    uint64_t            preproc_ns;
+    uint64_t            encode_ns;
 } fw_encoder_t;
 
 void fw_print_encoder_list(FILE *fstream);
@@ -300,10 +474,69 @@ int fw_init_encoder(char            *input_filename,
                     fw_encoder_t    *pEnc,
                     fw_eparams_t    *pParams);
 
+int fw_init_encoders(   char            *input_filename,
+                        fw_encoder_t    *pEncs,
+                        fw_eparams_t    *pParams,
+                        int             encoder_count);
+
 int fw_encode_step( fw_encoder_t *pEnc,
                     int          *frame_consumed,
                     AVPacket     *pPacket,
                     int          *packet_produced);
 
+uint64_t fw_encoder_max_packets(fw_encoder_t *pEnc);
+
 void fw_free_encoder(fw_encoder_t *pEnc);
 
+void fw_free_encoders(fw_encoder_t *pEncs, int encoder_count);
+
+/*
+    Muxing related structures, functions, and definitions.
+*/
+
+/*the room in the ring for the packets that the encoder holds back until it is
+flushed, on top of one packet per frame*/
+#define FW_MUXER_FLUSH_PACKETS (64)
+
+typedef struct fw_muxer_s
+{
+    AVFormatContext     *pFormatCtx;
+    AVStream            *pStream;
+    AVRational          time_base_enc;
+
+    /*The ring of packets from the encoder
+    (the only producer) to the writer thread
+    (the only consumer). The head and the tail
+    only grow, and wrap around the ring size*/
+    AVPacket            *pRing;
+    uint32_t            ring_size;
+    uint32_t            head;
+    uint32_t            tail;
+
+    pthread_t           writer;
+    int                 stop;
+    int                 write_failed;
+
+    /*statistics of the encoder side*/
+    uint64_t            packets_queued;
+    uint64_t            packets_dropped;
+    uint32_t            max_backlog;
+
+    /*statistics of the writer thread*/
+    uint64_t            packets_written;
+    uint64_t            bytes_written;
+    uint64_t            write_ns;
+    uint64_t            max_write_ns;
+} fw_muxer_t;
+
+int fw_muxer_global_header(char *filename);
+
+int fw_init_muxer(  char            *filename,
+                    AVCodecContext  *pCodecCtx,
+                    uint64_t        max_packets,
+                    fw_muxer_t      *pMux);
+
+int fw_muxer_push(fw_muxer_t *pMux, AVPacket *pPacket);
+
+int fw_free_muxer(fw_muxer_t *pMux);
+
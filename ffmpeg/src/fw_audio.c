@@ -1,6 +1,116 @@
 #include <stdio.h>
+#include <string.h>
 #include "ffmpegwrapper.h"
 
+/*the ring holds this many source and destination frames, so that the samples
+left over are only moved to its start every few frames*/
+#define FW_AUDIO_RING_FRAMES (8)
+
+/*
+    Make room for count samples at the write position of the ring. The samples
+    that are not in a frame yet are moved to the start of the ring, which only
+    grows if a source frame is larger than the ones it was sized for.
+*/
+static int fw_audio_ring_reserve(fw_audio_preproc_t *preproc_p, int count)
+{
+    int ret;
+    int i;
+    int pending = preproc_p->ring_write - preproc_p->ring_read;
+    int ring_size;
+    int channels_dst;
+    uint8_t **ringdata;
+
+    if(preproc_p->ring_write + count <= preproc_p->ring_size)
+    {
+        return 0;
+    }
+
+    if(pending + count <= preproc_p->ring_size)
+    {
+        for(i = 0; i < preproc_p->ring_planes; i++)
+        {
+            memmove(preproc_p->ringdata[i],
+                    preproc_p->ringdata[i] +
+                        (size_t)preproc_p->ring_read*preproc_p->ring_sample_size,
+                    (size_t)pending*preproc_p->ring_sample_size);
+        }
+        (preproc_p->ring_wraps)++;
+    }
+    else
+    {
+        ring_size = 2*preproc_p->ring_size;
+        ring_size = (ring_size < pending + count)? pending + count : ring_size;
+        channels_dst = av_get_channel_layout_nb_channels(preproc_p->channel_layout_dst);
+
+        ringdata = (uint8_t**)av_malloc(sizeof(uint8_t*) * preproc_p->ring_planes);
+        if(NULL == ringdata)
+        {
+            fprintf(stderr, "ERROR: av_malloc failed to allocate memory for the ring "
+                            "planes in fw_audio_ring_reserve\n");
+            return -1;
+        }
+
+        ret = av_samples_alloc( ringdata,
+                                NULL, /*don't need line size*/
+                                channels_dst,
+                                ring_size,
+                                preproc_p->smpl_fmt_dst,
+                                0);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: av_samples_alloc failed to allocate memory for "
+                            "%i samples for the ring in fw_audio_ring_reserve\n",
+                            ring_size);
+            av_freep(&ringdata);
+            return -1;
+        }
+
+        av_samples_copy(ringdata,
+                        preproc_p->ringdata,
+                        0,
+                        preproc_p->ring_read,
+                        pending,
+                        channels_dst,
+                        preproc_p->smpl_fmt_dst);
+
+        av_freep(&(preproc_p->ringdata[0]));
+        av_freep(&(preproc_p->ringdata));
+        preproc_p->ringdata  = ringdata;
+        preproc_p->ring_size = ring_size;
+        (preproc_p->ring_grows)++;
+    }
+
+    preproc_p->ring_read  = 0;
+    preproc_p->ring_write = pending;
+
+    return 0;
+}
+
+/*
+    Point pFrame at the next count samples of the ring
+*/
+static void fw_audio_ring_slice(fw_audio_preproc_t *preproc_p, AVFrame *pFrame, int count)
+{
+    int i;
+    size_t offset = (size_t)preproc_p->ring_read*preproc_p->ring_sample_size;
+
+    for(i = 0; i < preproc_p->ring_planes; i++)
+    {
+        preproc_p->slicedata[i] = preproc_p->ringdata[i] + offset;
+        if(i < AV_NUM_DATA_POINTERS)
+        {
+            pFrame->data[i] = preproc_p->slicedata[i];
+        }
+    }
+    /*more planes than data pointers are only in extended_data*/
+    pFrame->extended_data = (preproc_p->ring_planes > AV_NUM_DATA_POINTERS)?
+                                preproc_p->slicedata : pFrame->data;
+    pFrame->linesize[0] = count*preproc_p->ring_sample_size;
+    pFrame->nb_samples  = count;
+
+    preproc_p->ring_read += count;
+}
+
 /*
     For non-matching parameters,
         pick the desired parameter
@@ -48,14 +158,16 @@ int fw_audio_init_preproc(   AVCodecContext     *pCodecCtx_src,
     int         const *supported_samplerates;
     int         max_sample_rate;
     
-    /*The following parameters are for the resampler and resampled buffer*/
+    /*The following parameters are for the resampler and the ring*/
     struct SwrContext   *pSwrCtx;
     
-    uint8_t     **swrdata;
-    int         swrframe_isplanar;
-    int         swrframe_planes;
-    int         buffersize_swrdata;
+    uint8_t     **ringdata;
+    uint8_t     **slicedata;
+    int         ring_isplanar;
+    int         ring_planes;
+    int         ring_size;
     
+    int         framesize_src;
     int         framesize_dst;
     
     /*cast the preprocessor_state to the an fw_audio_preproc_t*/
@@ -200,6 +312,14 @@ int fw_audio_init_preproc(   AVCodecContext     *pCodecCtx_src,
     /*Set properties based on the passed encoder parameters*/
     pCodecCtx_dst->bit_rate = eparams->bit_rate;
     
+    /*The user-specified codec options override the settings above*/
+    ret = fw_set_codec_opts(pCodecCtx_dst, eparams->codec_opts);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: fw_set_codec_opts failed in fw_audio_preproc\n");
+        goto error0;
+    }
+    
     /*Open the codec with the given parameters*/
     if(avcodec_open2(pCodecCtx_dst, pCodec_dst, NULL) < 0)
     {
@@ -234,18 +354,26 @@ int fw_audio_init_preproc(   AVCodecContext     *pCodecCtx_src,
         goto error2;
     }
     
-    /*compute the number of planes in the resampled data*/
-    swrframe_isplanar = av_sample_fmt_is_planar(pCodecCtx_dst->sample_fmt);
-    swrframe_planes =  (swrframe_isplanar != 0)? pCodecCtx_dst->channels : 1;
+    /*compute the number of planes in the ring*/
+    ring_isplanar = av_sample_fmt_is_planar(pCodecCtx_dst->sample_fmt);
+    ring_planes =  (ring_isplanar != 0)? pCodecCtx_dst->channels : 1;
 
-    /*allocate the pointer to the different planes of the resampled data*/
-    swrdata = (uint8_t**)av_malloc(sizeof(uint8_t*) * swrframe_planes);
-    if(NULL == swrdata)
+    /*allocate the pointers to the different planes of the ring, and of the frame
+    that points into it*/
+    ringdata = (uint8_t**)av_malloc(sizeof(uint8_t*) * ring_planes);
+    if(NULL == ringdata)
     {
-        fprintf(stderr, "ERROR: av_malloc failed to allocate memory for swrdata "
+        fprintf(stderr, "ERROR: av_malloc failed to allocate memory for ringdata "
                         "in fw_audio_preproc\n");
         goto error2;
     }
+    slicedata = (uint8_t**)av_malloc(sizeof(uint8_t*) * ring_planes);
+    if(NULL == slicedata)
+    {
+        fprintf(stderr, "ERROR: av_malloc failed to allocate memory for slicedata "
+                        "in fw_audio_preproc\n");
+        goto error3;
+    }
 
     /*assume the number of samples in the resampled buffer is equal to the encoder
     frame size*/
@@ -255,22 +383,28 @@ int fw_audio_init_preproc(   AVCodecContext     *pCodecCtx_src,
         /*If the encoder doesn't have a frame size, just set it to 1024*/
         framesize_dst = 1024;
     }
-    buffersize_swrdata = framesize_dst;
+
+    /*the largest source frame, fw_init_encoders sets it for the decoded frames*/
+    framesize_src = (pCodecCtx_src->frame_size > 0)? pCodecCtx_src->frame_size : 1024;
+    ring_size = FW_AUDIO_RING_FRAMES * (framesize_dst + 
+                                        (int)av_rescale_rnd(framesize_src,
+                                                            smpl_rate_dst,
+                                                            smpl_rate_src,
+                                                            AV_ROUND_UP));
     
-    /*allocate the planes in the resampled data*/
-    /*allocate enough memory for the resampled data to handle the largest src frame*/
-    ret = av_samples_alloc( swrdata,
+    /*allocate the planes of the ring, once for all the jobs*/
+    ret = av_samples_alloc( ringdata,
 		                    NULL, /*don't need line size*/
 		                    (pCodecCtx_dst->channels),
-		                    buffersize_swrdata,
+		                    ring_size,
 		                    (pCodecCtx_dst->sample_fmt),
                             0);
     if(ret < 0)
     {
         fprintf(stderr, "ERROR: av_samples_alloc failed to allocate memory for "
-                        "%i samples for the swrdata planes in fw_audio_preproc\n", 
-                        buffersize_swrdata);
-        goto error3;
+                        "%i samples for the ring planes in fw_audio_preproc\n", 
+                        ring_size);
+        goto error4;
     }
     
     fw_audio_preproc_p->channel_layout_src  = channel_layout_src;
@@ -282,19 +416,25 @@ int fw_audio_init_preproc(   AVCodecContext     *pCodecCtx_src,
     fw_audio_preproc_p->smpl_rate_dst       = smpl_rate_dst;
     
     fw_audio_preproc_p->pSwrCtx         = pSwrCtx;
-    fw_audio_preproc_p->swrdata         = swrdata;
-    fw_audio_preproc_p->buffersize_swrdata  = buffersize_swrdata;
-    fw_audio_preproc_p->framesize_swrdata   = 0;
-    fw_audio_preproc_p->issilent_swrdata    = 0;
-    fw_audio_preproc_p->offset_swrdata  = 0;
+    fw_audio_preproc_p->ringdata        = ringdata;
+    fw_audio_preproc_p->ring_size       = ring_size;
+    fw_audio_preproc_p->ring_read       = 0;
+    fw_audio_preproc_p->ring_write      = 0;
+    fw_audio_preproc_p->ring_planes     = ring_planes;
+    fw_audio_preproc_p->ring_sample_size= av_get_bytes_per_sample(smpl_fmt_dst) *
+                                          ((ring_isplanar != 0)? 1 : pCodecCtx_dst->channels);
+    fw_audio_preproc_p->slicedata       = slicedata;
+    fw_audio_preproc_p->ring_wraps      = 0;
+    fw_audio_preproc_p->ring_grows      = 0;
     fw_audio_preproc_p->framesize_dst   = framesize_dst;
-    fw_audio_preproc_p->offset_dst      = 0;
 
     *p_preproc_state = (void*)fw_audio_preproc_p; 
     return 0;
 
+error4:
+    av_freep(&slicedata);
 error3:
-    av_freep(&swrdata);
+    av_freep(&ringdata);
 error2:
     swr_free(&pSwrCtx);
 error1:
@@ -308,20 +448,17 @@ error0:
     return -1;
 }
 
+/*
+    The frame only points into the ring of the preprocessor, and has no buffer
+    of its own. Its samples are valid until the next call of fw_audio_preproc.
+*/
 int fw_audio_alloc_preproc_frame(AVFrame **ppFrame_output,
                                  void    *preproc_state)
 {
-    int ret;
-    
     AVFrame *pFrame_output;
     
-    int         frame_buffer_size;
-    uint16_t    *frame_buffer;
-    
     fw_audio_preproc_t *preproc_p = (fw_audio_preproc_t*)preproc_state;
     
-    int channels_dst;
-    
     /*Allocate the AVFrame object to be used for the encoder*/
     pFrame_output = avcodec_alloc_frame();
     if(pFrame_output == NULL) 
@@ -335,60 +472,44 @@ int fw_audio_alloc_preproc_frame(AVFrame **ppFrame_output,
     pFrame_output->nb_samples = preproc_p->framesize_dst;
     pFrame_output->format = preproc_p->smpl_fmt_dst;
     pFrame_output->channel_layout = preproc_p->channel_layout_dst;
+    pFrame_output->channels = 
+        av_get_channel_layout_nb_channels(preproc_p->channel_layout_dst);
     
-    /*Calculate the number of channels in the channel layout*/
-    channels_dst = av_get_channel_layout_nb_channels(preproc_p->channel_layout_dst);
-    /* calculate the size of the frame buffer in bytes */
-    frame_buffer_size = av_samples_get_buffer_size( NULL,
-                                                    channels_dst, 
-                                                    preproc_p->framesize_dst,
-                                                    preproc_p->smpl_fmt_dst, 
-                                                    0);
-    
-    /* allocate memory for the frame buffer*/
-    frame_buffer = av_malloc(frame_buffer_size);
-    if (NULL == frame_buffer) 
-    {
-        fprintf(stderr, "ERROR: av_malloc failed for frame_buffer in "
-                        "fw_audio_alloc_preproc_frame\n");
-        goto error1;
-    }
-
-    /* setup the data pointers in the AVFrame */
-    ret = avcodec_fill_audio_frame( pFrame_output, 
-                                    channels_dst,
-                                    preproc_p->smpl_fmt_dst,
-                                    (const uint8_t*)frame_buffer, 
-                                    frame_buffer_size,
-                                    0);
-    if (ret < 0) 
-    {
-        fprintf(stderr, "ERROR: avcodec_fill_audio_frame failed in "
-                        "fw_audio_alloc_preproc_frame\n");
-        goto error2;
-    }
+    /*Mark the frame as borrowing the samples of the preprocessor*/
+    pFrame_output->opaque = preproc_state;
 
     *ppFrame_output = pFrame_output;
 
     return 0;
 
-error2:
-    av_freep(&frame_buffer);
-error1:
-    avcodec_free_frame(&pFrame_output);
 error0:
     return -1;
 }
 
+/*
+    Frees a frame of fw_audio_alloc_preproc_frame, or a copy of it that owns
+    its buffer
+*/
 void fw_audio_free_preproc_frame(AVFrame *pFrame)
 {
-    av_freep(&(pFrame->data[0]));
+    if(NULL != pFrame->opaque)
+    {
+        /*The samples and the plane pointers belong to the preprocessor*/
+        pFrame->extended_data = pFrame->data;
+    }
+    else
+    {
+        av_freep(&(pFrame->data[0]));
+    }
     avcodec_free_frame(&pFrame);
 }
 
 /*
     It is assumed that pAVFrame_dst was allocated using the function
-    fw_audio_alloc_preproc_frame
+    fw_audio_alloc_preproc_frame. The source frame is resampled straight into
+    the ring, and pAVFrame_dst points at the next frame size of samples in the
+    ring, without copying them. A source frame is only resampled once the ring
+    holds less than a whole output frame.
 */
 int fw_audio_preproc(   void    *preproc_state,
                         AVFrame *pAVFrame_src,
@@ -402,216 +523,110 @@ int fw_audio_preproc(   void    *preproc_state,
     fw_audio_preproc_t  *preproc_p = (fw_audio_preproc_t*)preproc_state;
 
     int                 smpl_rate_src       = preproc_p->smpl_rate_src;
-    
-    enum AVSampleFormat smpl_fmt_dst        = preproc_p->smpl_fmt_dst;
     int                 smpl_rate_dst       = preproc_p->smpl_rate_dst;
-    int                 channels_dst;
-
-    struct SwrContext   *pSwrCtx        = preproc_p->pSwrCtx;
-    uint8_t             **swrdata       = preproc_p->swrdata;
-    int                 buffersize_swrdata  = preproc_p->buffersize_swrdata;
-    int                 framesize_swrdata   = preproc_p->framesize_swrdata;
-    int                 offset_swrdata  = preproc_p->offset_swrdata;
-    int                 issilent_swrdata    = preproc_p->issilent_swrdata;
-    int                 framesize_dst   = preproc_p->framesize_dst;
-    int                 offset_dst      = preproc_p->offset_dst;
+    int                 framesize_dst       = preproc_p->framesize_dst;
 
     int framesize_src;
-    
-    int data_available;
-    int space_available;
-    int copy_amount;
+    int framesize_swrdata;
+    int i;
 
     /*Begin by assuming that no frame is consumed or produced*/
     *frame_consumed = 0;
     *frame_produced = 0;
 
-    /*Check if a valid swrdata buffer is present*/
-    if((NULL == swrdata) || (NULL == swrdata[0]))
+    /*Check if a valid ring is present*/
+    if((NULL == preproc_p->ringdata) || (NULL == preproc_p->ringdata[0]))
     {
         fprintf(stderr, "ERROR: the preproc_state passed as the first argument does "
-                        "not contain a pointer to a valid resampled buffer "
+                        "not contain a pointer to a valid ring "
                         "in fw_audio_preproc\n");
         ret = -1;
         goto exit0;
     }
 
-    /*Determine the number of destination channels*/
-    channels_dst = av_get_channel_layout_nb_channels(preproc_p->channel_layout_dst);
-    
     /*Check if a new frame has to be resampled*/
-    if(0 == framesize_swrdata)
+    if((preproc_p->ring_write - preproc_p->ring_read < framesize_dst) &&
+       (NULL != pAVFrame_src))
     {
-        /*Check if there is a source frame available*/
-        if(NULL != pAVFrame_src)
+        /*Get the number of samples in the frame*/
+        framesize_src = pAVFrame_src->nb_samples;
+
+        /*Compute the number of samples in the resampled frame*/
+        framesize_swrdata = av_rescale_rnd( framesize_src, 
+                                            smpl_rate_dst, 
+                                            smpl_rate_src, 
+                                            AV_ROUND_UP);
+
+        /*Make room for them at the write position*/
+        ret = fw_audio_ring_reserve(preproc_p, framesize_swrdata);
+        if(ret < 0)
         {
-            /*Get the number of samples in the frame*/
-            framesize_src = pAVFrame_src->nb_samples;
-
-            /*Compute the number of samples in the resampled frame*/
-            framesize_swrdata = av_rescale_rnd( framesize_src, 
-                                                smpl_rate_dst, 
-                                                smpl_rate_src, 
-                                                AV_ROUND_UP);
-
-            /*Make sure that the memory available for the resampled data is sufficient*/
-            if(buffersize_swrdata < framesize_swrdata)
-            {
-                /*Otherwise, increase the resampled buffer size*/
-                buffersize_swrdata = framesize_swrdata;
-
-                /*Free the previous data buffer*/
-                av_freep(&(swrdata[0]));
-
-                /*Allocate the new buffer*/            
-                ret = av_samples_alloc( swrdata,
-		                                NULL, /*don't need line size*/
-		                                channels_dst,
-		                                buffersize_swrdata,
-		                                smpl_fmt_dst,
-                                        0);
-                if(ret < 0)
-                {
-                    fprintf(stderr, "ERROR: av_samples_alloc failed to allocate memory "
-                                    "(%i samples) for the swrdata planes in "
-                                    "fw_audio_preproc\n", buffersize_swrdata);
-                    framesize_swrdata = 0;
-                    buffersize_swrdata = 0;
-                    ret = -1;
-                    goto exit1;
-                }
-            }
-
-            /*Resample a new frame.*/
-            ret = swr_convert(  pSwrCtx, 
-                                swrdata, 
-                                framesize_swrdata,
-                                /*casting from "uint8_t **" to "const uint8_t **" */ 
-                                (const uint8_t **)pAVFrame_src->extended_data, 
-                                framesize_src);
-            if (ret < 0) 
-            {
-                fprintf(stderr, "ERROR: swr_convert failed in fw_audio_preproc\n");
-                framesize_swrdata = 0;
-                ret = -1;
-                goto exit1;
-            }
-
-            /*Indicate that the source is not silent*/
-            issilent_swrdata = 0;
-            
-            /*Update the resample buffer offset*/
-            offset_swrdata = 0;
+            fprintf(stderr, "ERROR: fw_audio_ring_reserve failed in "
+                            "fw_audio_preproc\n");
+            goto exit0;
         }
-        else /*(NULL == pAVFrame_src)*/
-        {
-            /*Don't have a new source frame to resample and copy into the buffer.*/
-
-            /*Fill the resample buffer with silence instead.*/
-            ret = av_samples_set_silence(   swrdata,
-                                            0, /*offset*/
-                                            buffersize_swrdata,
-                                            channels_dst,
-                                            smpl_fmt_dst);
-            if(ret < 0)
-            {
-                fprintf(stderr, "ERROR: av_samples_set_silence failed in "
-                                "fw_audio_preproc\n");
-                ret = -1;
-                goto exit1;
-            }
 
-            /*Update the resample buffer framesize*/
-            framesize_swrdata = 0;
-            
-            /*Update the resample buffer offset*/
-            offset_swrdata = 0;
-            
-            /*indicate that the source is silent*/
-            issilent_swrdata = 1;
+        /*The plane pointers of the frame are rebuilt by fw_audio_ring_slice*/
+        for(i = 0; i < preproc_p->ring_planes; i++)
+        {
+            preproc_p->slicedata[i] = preproc_p->ringdata[i] +
+                        (size_t)preproc_p->ring_write*preproc_p->ring_sample_size;
         }
-    }
 
-    /*Copute how many samples can be copied from the resample buffer
-    into the data buffer of the output frame.*/
-    data_available = framesize_swrdata - offset_swrdata;
-    space_available = framesize_dst - offset_dst;
-    copy_amount = (space_available < data_available)? 
-                    space_available : data_available;
-
-    /*Copy the samples from the resample buffer into 
-    the data buffer of the output frame*/
-    av_samples_copy( pAVFrame_dst->extended_data,
-                     swrdata,
-                     offset_dst,
-                     offset_swrdata,
-                     copy_amount,
-                     channels_dst,
-                     smpl_fmt_dst);     
-
-    /*Update the offset values*/
-    offset_swrdata += copy_amount;
-    offset_dst += copy_amount;
-
-    /*Check if the resample buffer is empty*/
-    if(offset_swrdata == framesize_swrdata)
-    {
-        /*Only set the frame_consumed flag if
-        a non-silent source frame was resampled*/
-        if(0 == issilent_swrdata)
+        /*Resample a new frame.*/
+        ret = swr_convert(  preproc_p->pSwrCtx, 
+                            preproc_p->slicedata, 
+                            framesize_swrdata,
+                            /*casting from "uint8_t **" to "const uint8_t **" */ 
+                            (const uint8_t **)pAVFrame_src->extended_data, 
+                            framesize_src);
+        if (ret < 0) 
         {
-            /*The source frame is consumed*/
-            *frame_consumed = 1;
-            /*There is no more data left in the
-            resampled buffer*/
-            framesize_swrdata = 0;
+            fprintf(stderr, "ERROR: swr_convert failed in fw_audio_preproc\n");
+            ret = -1;
+            goto exit0;
         }
-        
-        offset_swrdata = 0;
+        preproc_p->ring_write += ret;
+        ret = 0;
+
+        /*The source frame is consumed*/
+        *frame_consumed = 1;
     }
 
-    /*Check if the buffer in the output frame is full*/
-    if(offset_dst == framesize_dst)
+    /*Check if the ring holds a whole output frame*/
+    if(preproc_p->ring_write - preproc_p->ring_read >= framesize_dst)
     {
+        fw_audio_ring_slice(preproc_p, pAVFrame_dst, framesize_dst);
         /*The output frame is ready*/
         *frame_produced = 1;
-        /*Reset the offset for the next output frame*/
-        offset_dst = 0;
-    }
-
-exit1:
-    /*Restore the content of the fw_audio_preproc_t object*/
-    preproc_p->swrdata          = swrdata;
-    preproc_p->buffersize_swrdata   = buffersize_swrdata;
-    preproc_p->framesize_swrdata    = framesize_swrdata;
-    preproc_p->offset_swrdata   = offset_swrdata;
-    preproc_p->issilent_swrdata = issilent_swrdata;
-    preproc_p->framesize_dst    = framesize_dst;
-    preproc_p->offset_dst       = offset_dst;
-        
+    }
+
 exit0:
     return ret;
 }
 
 /*
     This function should only be called when the frame_consumed flag is set
-    for the last frame in the input stream
+    for the last frame in the input stream. It is called until it produces no
+    frame, the last frame may be short.
 */
 void fw_audio_end_preproc(  void    *preproc_state,
                             AVFrame *pAVFrame_dst,
                             int     *frame_produced)
 {
     fw_audio_preproc_t *preproc_p = (fw_audio_preproc_t*)preproc_state;
+    int pending = preproc_p->ring_write - preproc_p->ring_read;
 
-    pAVFrame_dst->nb_samples = preproc_p->offset_dst;
-    preproc_p->offset_dst = 0;            
-    
-    if(pAVFrame_dst->nb_samples > 0)
+    if(pending > 0)
     {
+        fw_audio_ring_slice(preproc_p, pAVFrame_dst, 
+                            (pending < preproc_p->framesize_dst)?
+                                pending : preproc_p->framesize_dst);
         *frame_produced = 1;
     }
     else
     {
+        pAVFrame_dst->nb_samples = 0;
         *frame_produced = 0;
     }
 }
@@ -620,12 +635,13 @@ void fw_audio_free_preproc(void **p_preproc_state)
 {
     fw_audio_preproc_t  *fw_audio_preproc_p = (fw_audio_preproc_t*)(*p_preproc_state);
     
-    if(NULL != fw_audio_preproc_p->swrdata[0])
+    if(NULL != fw_audio_preproc_p->ringdata[0])
     {
-        av_freep(&(fw_audio_preproc_p->swrdata[0]));
+        av_freep(&(fw_audio_preproc_p->ringdata[0]));
     }
     
-    av_freep(&(fw_audio_preproc_p->swrdata));
+    av_freep(&(fw_audio_preproc_p->ringdata));
+    av_freep(&(fw_audio_preproc_p->slicedata));
     swr_free(&(fw_audio_preproc_p->pSwrCtx));
 
     free(fw_audio_preproc_p);
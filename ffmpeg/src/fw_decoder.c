@@ -50,10 +50,15 @@ void fw_free_copied_data(   enum AVMediaType    media_type,
     }
 }
 
-int fw_init_decoder(char                *filename, 
-                    fw_decoder_t        *pDec, 
-                    enum AVMediaType    media_type, 
-                    unsigned char       batched_read)
+/*
+    Open the decoder, the demuxer reads the file through the read-ahead engine
+    pUring if it is not NULL
+*/
+static int fw_open_decoder( char                *filename, 
+                            fw_decoder_t        *pDec, 
+                            enum AVMediaType    media_type, 
+                            unsigned char       batched_read,
+                            fw_uring_t          *pUring)
 {
     AVFormatContext *pFormatCtx;
 
@@ -69,9 +74,23 @@ int fw_init_decoder(char                *filename,
     void            *p_dummy;
     uint64_t        packet_space;
     uint64_t        pkt_i;
+    uint64_t        first_keyframe;
+    uint64_t        packets_skipped = 0;
 
     /* open the file */
     pFormatCtx = NULL;
+    if(NULL != pUring)
+    {
+        pFormatCtx = avformat_alloc_context();
+        if(NULL == pFormatCtx)
+        {
+            fprintf(stderr, "ERROR: avformat_alloc_context failed in fw_init_decoder\n");
+            goto error0;
+        }
+        pFormatCtx->pb = fw_uring_avio(pUring);
+        pFormatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    /*a context passed in is freed on failure*/
     if(avformat_open_input(&pFormatCtx, filename, NULL, NULL) !=0)
     {
         fprintf(stderr, "ERROR: avformat_open_input failed in fw_init_decoder\n");
@@ -141,7 +160,7 @@ int fw_init_decoder(char                *filename,
     }
 
     /*Check if a batched read should be performed*/
-    if(batched_read != FW_NO_BATCHED_READ)
+    if(batched_read == FW_BATCHED_READ)
     {
         packet_space = 128;
         pPackets =     (AVPacket*)calloc(packet_space, sizeof(AVPacket));
@@ -190,6 +209,12 @@ int fw_init_decoder(char                *filename,
                 pPackets[pkt_i].data = NULL;
                 pPackets[pkt_i].size = 0;        
             }
+            else
+            {
+                /*the packet of another stream, the slot is reused*/
+                av_free_packet(&(pPackets[pkt_i]));
+                packets_skipped++;
+            }
         }
         
         /*Free excess allocated space*/
@@ -206,12 +231,27 @@ int fw_init_decoder(char                *filename,
             pPackets = p_dummy;
             packet_space = pkt_i;
         }
+
+        /*find the first packet that decoding can be restarted from, the
+        packets before it depend on frames that are not in the file*/
+        for(first_keyframe = 0; first_keyframe < packet_space; first_keyframe++)
+        {
+            if(pPackets[first_keyframe].flags & AV_PKT_FLAG_KEY)
+            {
+                break;
+            }
+        }
+        if(first_keyframe == packet_space)
+        {
+            first_keyframe = 0;
+        }
     }
     else
     {
         pPackets = NULL;
         packet_space = 0;
         pkt_i = 0;
+        first_keyframe = 0;
     }
 
     /*fill in the fw_decoder data structure*/
@@ -225,8 +265,13 @@ int fw_init_decoder(char                *filename,
 
     pDec->batched_read = batched_read;
     pDec->pPackets = pPackets;
+    pDec->pUring = pUring;
     pDec->packets_read = packet_space;
     pDec->packets_decoded = 0;
+    pDec->packets_skipped = packets_skipped;
+    pDec->first_keyframe = first_keyframe;
+    pDec->rewinds = 0;
+    pDec->quality = 0;
 
     pDec->frames_available = pStream->nb_frames;
     pDec->frames_decoded = 0;
@@ -250,6 +295,49 @@ error0:
     return -1;
 }
 
+int fw_init_decoder(char                *filename, 
+                    fw_decoder_t        *pDec, 
+                    enum AVMediaType    media_type, 
+                    unsigned char       batched_read)
+{
+    if(batched_read == FW_URING_READ)
+    {
+        return fw_init_decoder_uring(filename, pDec, media_type,
+                                     FW_URING_DEPTH, FW_URING_CHUNK_SIZE);
+    }
+
+    return fw_open_decoder(filename, pDec, media_type, batched_read, NULL);
+}
+
+/*
+    Open a decoder that reads its packets in fw_decode_nxtpkt (like
+    FW_NO_BATCHED_READ), from a file that io_uring reads ahead of the demuxer,
+    with depth reads of chunk_size bytes in flight. The reads are part of the
+    decoding, but the demuxer rarely waits on the disk.
+*/
+int fw_init_decoder_uring(  char                *filename,
+                            fw_decoder_t        *pDec,
+                            enum AVMediaType    media_type,
+                            uint32_t            depth,
+                            uint32_t            chunk_size)
+{
+    fw_uring_t *pUring;
+
+    if(fw_uring_open(filename, depth, chunk_size, &pUring) < 0)
+    {
+        fprintf(stderr, "ERROR: fw_uring_open failed in fw_init_decoder_uring\n");
+        return -1;
+    }
+
+    if(fw_open_decoder(filename, pDec, media_type, FW_URING_READ, pUring) < 0)
+    {
+        fw_uring_close(&pUring);
+        return -1;
+    }
+
+    return 0;
+}
+
 int fw_decode_nxtpkt(fw_decoder_t   *pDec, 
                      AVFrame        *pFrame,
                      int            *pgot_frame)
@@ -276,7 +364,7 @@ int fw_decode_nxtpkt(fw_decoder_t   *pDec,
 
     avcodec_get_frame_defaults(&frame_local);
 
-    if(batched_read != FW_NO_BATCHED_READ)
+    if(batched_read == FW_BATCHED_READ)
     {
         /*loop until a complete frame is decoded or an attempt is made to extract
         any remaining buffered frames*/
@@ -338,7 +426,7 @@ int fw_decode_nxtpkt(fw_decoder_t   *pDec,
             
         }while((got_pkt != 0) && (got_frame == 0));
     }
-    else /*batched_read == FW_NO_BATCHED_READ*/
+    else /*the packets are read here*/
     {
         av_init_packet(&Pkt);
         Pkt.data = NULL;
@@ -348,7 +436,15 @@ int fw_decode_nxtpkt(fw_decoder_t   *pDec,
         any remaining buffered frames*/
         do
         {
-            if(av_read_frame(pFormatCtx, &Pkt) < 0)
+            /*Skip the packets of the other streams in the container*/
+            while(((ret = av_read_frame(pFormatCtx, &Pkt)) >= 0) &&
+                  (Pkt.stream_index != pDec->stream_index))
+            {
+                av_free_packet(&Pkt);
+                (pDec->packets_skipped)++;
+            }
+
+            if(ret < 0)
             {
                 /*No packets were read, so setup the parameters to extract the 
                 last buffered frame from the decoder*/
@@ -413,6 +509,77 @@ error0:
     return ret;
 }
 
+/*
+    Restart decoding from the first keyframe of the packets read in a batch, so
+    that a short file can be decoded over and over. The decoder is flushed,
+    which drops any buffered frames and the references to the frames of the
+    last pass.
+*/
+int fw_decoder_rewind(fw_decoder_t *pDec)
+{
+    if((pDec->batched_read != FW_BATCHED_READ) || (0 == pDec->packets_read))
+    {
+        fprintf(stderr, "ERROR: only a decoder with a batch of packets can be "
+                        "rewound in fw_decoder_rewind\n");
+        return -1;
+    }
+
+    avcodec_flush_buffers(pDec->pCodecCtx);
+    pDec->packets_decoded = pDec->first_keyframe;
+    (pDec->rewinds)++;
+
+    return 0;
+}
+
+/*
+    The parts of the decoding that are skipped at every quality level, from
+    full quality to the cheapest: the loop filter of the non-reference frames
+    and then of all frames, the IDCT of the non-reference frames, the
+    non-reference frames themselves, and finally the IDCT of all frames.
+*/
+static const enum AVDiscard fw_quality_skips[FW_QUALITY_MAX + 1][3] =
+{
+    /*skip_loop_filter      skip_idct           skip_frame*/
+    {AVDISCARD_DEFAULT,     AVDISCARD_DEFAULT,  AVDISCARD_DEFAULT},
+    {AVDISCARD_NONREF,      AVDISCARD_DEFAULT,  AVDISCARD_DEFAULT},
+    {AVDISCARD_ALL,         AVDISCARD_DEFAULT,  AVDISCARD_DEFAULT},
+    {AVDISCARD_ALL,         AVDISCARD_NONREF,   AVDISCARD_DEFAULT},
+    {AVDISCARD_ALL,         AVDISCARD_NONREF,   AVDISCARD_NONREF},
+    {AVDISCARD_ALL,         AVDISCARD_ALL,      AVDISCARD_NONREF}
+};
+
+/*
+    Set the quality level of the next packets decoded by fw_decode_nxtpkt. The
+    skip settings of the codec context are read by the codec for every packet.
+    Levels beyond FW_QUALITY_MAX are clamped, and the level in effect is returned.
+*/
+int fw_decoder_set_quality(fw_decoder_t *pDec, int quality)
+{
+    AVCodecContext *pCodecCtx = pDec->pCodecCtx;
+
+    if(quality < 0)
+    {
+        fprintf(stderr, "ERROR: invalid quality level %i in fw_decoder_set_quality\n",
+                        quality);
+        return -1;
+    }
+
+    if(quality > FW_QUALITY_MAX)
+    {
+        quality = FW_QUALITY_MAX;
+    }
+
+    if(quality != pDec->quality)
+    {
+        pCodecCtx->skip_loop_filter = fw_quality_skips[quality][0];
+        pCodecCtx->skip_idct        = fw_quality_skips[quality][1];
+        pCodecCtx->skip_frame       = fw_quality_skips[quality][2];
+        pDec->quality = quality;
+    }
+
+    return quality;
+}
+
 void fw_free_decoder(fw_decoder_t *pDec)
 {
     AVPacket    *pPackets;
@@ -422,7 +589,7 @@ void fw_free_decoder(fw_decoder_t *pDec)
 	AVCodecContext  	*pCodecCtx;
 	AVFormatContext 	*pFormatCtx;
     
-    if(pDec->batched_read != FW_NO_BATCHED_READ)
+    if(pDec->batched_read == FW_BATCHED_READ)
     {
         pPackets = pDec->pPackets;
         packets_read = pDec->packets_read;
@@ -439,14 +606,17 @@ void fw_free_decoder(fw_decoder_t *pDec)
     pFormatCtx = pDec->pFormatCtx;
     avformat_close_input(&pFormatCtx);
 
+    /*the custom AVIOContext outlives the demuxer*/
+    fw_uring_close(&(pDec->pUring));
+
     memset(pDec, 0, sizeof(fw_decoder_t));    
 }
 
 #ifdef TEST_FW_DECODER
 
-/* gcc -Wall -O3 -o fw_decoder_test ./fw_decoder.c ./fw_video.c ./fw_audio.c -D TEST_FW_DECODER -lavformat -lswresample -lswscale -lavcodec -lpostproc -lavfilter -lavutil -lgsm -lmp3lame -lopencore-amrnb -lopus -lspeex -lvorbis -lvorbisenc -lvpx -lx264  -lz -lm*/
+/* gcc -Wall -O3 -o fw_decoder_test ./fw_decoder.c ./fw_video.c ./fw_audio.c ./fw_uring.c -D TEST_FW_DECODER -lavformat -lswresample -lswscale -lavcodec -lpostproc -lavfilter -lavutil -lgsm -lmp3lame -lopencore-amrnb -lopus -lspeex -lvorbis -lvorbisenc -lvpx -lx264  -luring -lz -lm*/
 
-char * usage_string = " <file name> < audio | video > [batched]";
+char * usage_string = " <file name> < audio | video > [batched | uring]";
 
 int main(int argc, char** argv)
 {
@@ -478,7 +648,11 @@ int main(int argc, char** argv)
     {
         if(strcmp(argv[3], "batched") == 0)
         {
-            batched = 1;
+            batched = FW_BATCHED_READ;
+        }
+        else if(strcmp(argv[3], "uring") == 0)
+        {
+            batched = FW_URING_READ;
         }
         else
         {
@@ -489,7 +663,7 @@ int main(int argc, char** argv)
     }
     else
     {
-        batched = 0;
+        batched = FW_NO_BATCHED_READ;
     }
      
     if(0 == strcmp(argv[2], "audio"))
@@ -548,6 +722,7 @@ int main(int argc, char** argv)
 
     printf("Read %li packets.\n", decoder.packets_read);
     printf("Processed %li packets.\n", decoder.packets_decoded);
+    printf("Skipped %li packets of other streams.\n", decoder.packets_skipped);
     printf("%li frames available.\n", decoder.frames_available);
     printf("Decoded %li frames.\n", decoder.frames_decoded);
         
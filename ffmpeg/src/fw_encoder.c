@@ -1,6 +1,15 @@
 #include <stdio.h>
+#include <time.h>
 #include "ffmpegwrapper.h"
 
+static inline uint64_t fw_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
 void fw_print_encoder_list(FILE* fstream)
 {
     int i;
@@ -49,6 +58,30 @@ void fw_print_encoder_list(FILE* fstream)
             "****************************************\n");
 }
 
+/*
+    Set the options in codec_opts on a codec context that is not open yet. The
+    options of the codec itself are found through AV_OPT_SEARCH_CHILDREN.
+*/
+int fw_set_codec_opts(AVCodecContext *pCodecCtx, AVDictionary *codec_opts)
+{
+    int ret;
+    AVDictionaryEntry *pEntry = NULL;
+
+    while(NULL != (pEntry = av_dict_get(codec_opts, "", pEntry, AV_DICT_IGNORE_SUFFIX)))
+    {
+        ret = av_opt_set(pCodecCtx, pEntry->key, pEntry->value, AV_OPT_SEARCH_CHILDREN);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: av_opt_set failed to set the codec option "
+                            "\"%s=%s\" in fw_set_codec_opts\n",
+                            pEntry->key, pEntry->value);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 int fw_init_preproc(AVCodecContext  *pCodecCtx_src,
                     AVCodec         *pCodec_dst,
                     AVCodecContext  *pCodecCtx_dst,
@@ -82,6 +115,8 @@ int fw_init_preproc(AVCodecContext  *pCodecCtx_src,
                 pPreproc->end_preproc   = fw_audio_end_preproc;
                 pPreproc->alloc_preproc_frame   = fw_audio_alloc_preproc_frame;
                 pPreproc->free_preproc_frame    = fw_audio_free_preproc_frame;
+                /*the frames point into the ring of the preprocessor*/
+                pPreproc->frames_borrowed       = 1;
             }
             
             break;
@@ -105,6 +140,7 @@ int fw_init_preproc(AVCodecContext  *pCodecCtx_src,
                 pPreproc->end_preproc   = fw_video_end_preproc;
                 pPreproc->alloc_preproc_frame   = fw_video_alloc_preproc_frame;
                 pPreproc->free_preproc_frame    = fw_video_free_preproc_frame;
+                pPreproc->frames_borrowed       = 0;
             }
             
             break;
@@ -143,29 +179,194 @@ void fw_free_preproc(fw_preproc_state_t    *pPreproc)
     pPreproc->end_preproc   = NULL;
     pPreproc->alloc_preproc_frame   = NULL;
     pPreproc->free_preproc_frame    = NULL;
+    pPreproc->frames_borrowed       = 0;
 }
 
-int fw_init_encoder(  char            *input_filename,
-                      fw_encoder_t    *pEnc,
-                      fw_eparams_t    *pParams)
+/*
+    Free the source frames of an encoder that owns them. The frames of a mapped
+    y4m file only go away with the mapping.
+*/
+static void fw_free_source_frames(fw_encoder_t *pEnc)
 {
-    int ret;
-    
-    char  *codec_name;    
-    enum AVMediaType    media_type;
-    
-    AVCodec         *pCodec_dst;
+    uint64_t frm_i;
 
-    fw_decoder_t    decoder;
+    if(NULL != pEnc->pY4m)
+    {
+        fw_y4m_close(pEnc->pY4m);
+        free(pEnc->pY4m);
+        pEnc->pY4m = NULL;
+    }
+    else
+    {
+        for(frm_i = 0; frm_i < pEnc->frames_available; frm_i++)
+        {
+            if(NULL == pEnc->pFrameArray[frm_i])
+            {
+                break;
+            }
+            fw_free_copied_data(pEnc->preproc.media_type, pEnc->pFrameArray[frm_i]);
+            avcodec_free_frame(&(pEnc->pFrameArray[frm_i]));
+        }
+        free(pEnc->pFrameArray);
+    }
 
-    AVCodecContext  *pCodecCtx_src;
+    pEnc->pFrameArray = NULL;
+}
 
-    AVFrame         **pFrameArray = NULL;
-    void            *pVoid = NULL;
-    uint64_t        frames_available;
+/*
+    Run the preprocessor on all the source frames of the encoder, and replace
+    them with the preprocessed frames. Every preprocessed frame is a copy in a
+    frame of its own, allocated with alloc_preproc_frame, or copied out of the
+    memory of the preprocessor if it only lends its frames.
+*/
+static int fw_preproc_all(fw_encoder_t *pEnc)
+{
+    int ret;
+
+    fw_preproc_state_t  *pPreproc   = &(pEnc->preproc);
+    AVFrame         **pFrameArray   = NULL;
+    void            *pVoid          = NULL;
+    uint64_t        frames_space    = 0;
+    uint64_t        frames_preproced= 0;
     uint64_t        frm_i;
-    int             got_frame;
 
+    AVFrame         *pFrame_dst     = pEnc->pFramePreenc;
+    AVFrame         *pFrame_next;
+    int             consumed_src_frame;
+    int             got_preproced_frame;
+
+    frm_i = 0;
+    while(1)
+    {
+        if(frm_i < pEnc->frames_available)
+        {
+            ret = pPreproc->preproc(pPreproc->preproc_state,
+                                    pEnc->pFrameArray[frm_i],
+                                    &consumed_src_frame,
+                                    pFrame_dst,
+                                    &got_preproced_frame);
+            if(ret < 0)
+            {
+                fprintf(stderr, "ERROR: the preproc function of the fw_preproc_state_t "
+                                "object failed in fw_preproc_all.\n");
+                goto error0;
+            }
+
+            if(consumed_src_frame)
+            {
+                frm_i++;
+            }
+        }
+        else
+        {
+            /*Extract any remaining data from the preprocessor*/
+            pPreproc->end_preproc(  pPreproc->preproc_state,
+                                    pFrame_dst,
+                                    &got_preproced_frame);
+            if(0 == got_preproced_frame)
+            {
+                break;
+            }
+        }
+
+        if(0 != got_preproced_frame)
+        {
+            if(frames_preproced == frames_space)
+            {
+                frames_space += 128;
+
+                pVoid = realloc(pFrameArray, frames_space*sizeof(AVFrame*));
+                if(NULL == pVoid)
+                {
+                    fprintf(stderr, "ERROR: realloc failed to allocate space for the "
+                                    "array of AVFrame pointers in fw_preproc_all\n");
+                    goto error0;
+                }
+                pFrameArray = (AVFrame**)pVoid;
+            }
+
+            if(0 != pPreproc->frames_borrowed)
+            {
+                /*The next call reuses the memory of the frame, keep a copy*/
+                pFrame_next = avcodec_alloc_frame();
+                if(NULL == pFrame_next)
+                {
+                    fprintf(stderr, "ERROR: avcodec_alloc_frame failed in "
+                                    "fw_preproc_all\n");
+                    goto error0;
+                }
+                ret = fw_frame_copy(pPreproc->media_type, pFrame_dst, pFrame_next);
+                if(ret < 0)
+                {
+                    fprintf(stderr, "ERROR: fw_frame_copy failed in fw_preproc_all\n");
+                    avcodec_free_frame(&pFrame_next);
+                    goto error0;
+                }
+                pFrame_next->pts = pFrame_dst->pts;
+
+                pFrameArray[frames_preproced++] = pFrame_next;
+            }
+            else
+            {
+                /*The preprocessor writes the next frame into a new frame*/
+                ret = pPreproc->alloc_preproc_frame(&pFrame_next,
+                                                    pPreproc->preproc_state);
+                if(ret < 0)
+                {
+                    fprintf(stderr, "ERROR: alloc_preproc_frame failed in "
+                                    "fw_preproc_all\n");
+                    goto error0;
+                }
+                /*The video preprocessor counts on from the pts of the last frame*/
+                pFrame_next->pts = pFrame_dst->pts;
+
+                pFrameArray[frames_preproced++] = pFrame_dst;
+                pFrame_dst = pFrame_next;
+            }
+        }
+    }
+
+    /*The source frames are not needed anymore, unless they are shared with
+    other encoders*/
+    if(0 != pEnc->owns_frames)
+    {
+        fw_free_source_frames(pEnc);
+    }
+
+    pEnc->pFrameArray       = pFrameArray;
+    pEnc->frames_available  = frames_preproced;
+    pEnc->owns_frames       = 1;
+    pEnc->preproced_at_init = 1;
+    pEnc->pFramePreenc      = pFrame_dst;
+
+    return 0;
+
+error0:
+    for(frm_i = 0; frm_i < frames_preproced; frm_i++)
+    {
+        pPreproc->free_preproc_frame(pFrameArray[frm_i]);
+    }
+    free(pFrameArray);
+    pEnc->pFramePreenc = pFrame_dst;
+
+    return -1;
+}
+
+/*
+    Setup an encoder for the decoded frames in pFrameArray. The codec context
+    pCodecCtx_src of the decoder describes the format of the frames. If
+    owns_frames is set, the frames are freed with the encoder.
+*/
+static int fw_setup_encoder(fw_encoder_t    *pEnc,
+                            fw_eparams_t    *pParams,
+                            AVCodecContext  *pCodecCtx_src,
+                            AVFrame         **pFrameArray,
+                            uint64_t        frames_available,
+                            int             owns_frames)
+{
+    int ret;
+    
+    AVCodec         *pCodec_dst;
     AVCodecContext  *pCodecCtx_dst;
 
     fw_preproc_state_t *pPreproc = &(pEnc->preproc);
@@ -174,51 +375,138 @@ int fw_init_encoder(  char            *input_filename,
 
     fw_encode_t     encode = NULL;
 
-    /*Extract the encoding parameters*/
-    codec_name = pParams->codec_name;
-        
     /*Find the codec.*/
-    pCodec_dst = avcodec_find_encoder_by_name(codec_name);
+    pCodec_dst = avcodec_find_encoder_by_name(pParams->codec_name);
     if(NULL == pCodec_dst) 
     {
         fprintf(stderr, "ERROR: avcodec_find_encoder_by_name failed to find codec of "
-                        "of name \"%s\" in fw_init_encoder\n", codec_name);
+                        "of name \"%s\" in fw_setup_encoder\n", pParams->codec_name);
         goto error0;
     }
 
-    /*Determine the media type*/
-    media_type = pCodec_dst->type;
+    /*The codec must encode the media type of the decoded frames*/
+    if(pCodec_dst->type != pCodecCtx_src->codec_type)
+    {
+        fprintf(stderr, "ERROR: the media type of the codec \"%s\" is not the media "
+                        "type of the decoded frames in fw_setup_encoder\n",
+                        pParams->codec_name);
+        goto error0;
+    }
 
     /*Given the media type, setup the encoder function pointers*/
-    switch(media_type)
+    encode = (AVMEDIA_TYPE_AUDIO == pCodec_dst->type)?  avcodec_encode_audio2 :
+                                                        avcodec_encode_video2;
+
+    /*Allocate a codec context*/
+    pCodecCtx_dst = avcodec_alloc_context3(pCodec_dst);
+    if(NULL == pCodecCtx_dst)
     {
-        case AVMEDIA_TYPE_AUDIO:
-            encode = avcodec_encode_audio2;
-            break;
+        fprintf(stderr, "ERROR: avcodec_alloc_context3 failed to allocate memory"
+                        "for a codec context in fw_setup_encoder\n");
+        goto error0;
+    }
+    
+    /*Setup the preprocessor and parameters for the codec*/
+    ret = fw_init_preproc(pCodecCtx_src,
+                          pCodec_dst,
+                          pCodecCtx_dst,
+                          pPreproc,
+                          pParams);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: fw_init_preproc failed in fw_setup_encoder\n");
+        goto error1;
+    }
+        
+    /*Allocate the AVFrame object to be used for the encoder*/
+    ret = pPreproc->alloc_preproc_frame(&pFramePreenc,
+                                        pPreproc->preproc_state);
+    if (ret < 0)
+    {
+        fprintf(stderr, "ERROR: alloc_preproc_frame failed in fw_setup_encoder\n");
+        goto error2;
+    }
 
-        case AVMEDIA_TYPE_VIDEO:
-            encode = avcodec_encode_video2;
-            break;
+    /*Assign the new values to the encoder structure*/
+    pEnc->pCodec    = pCodec_dst;
+	pEnc->pCodecCtx = pCodecCtx_dst;
 
-        default:
-            fprintf(stderr, "ERROR fw_init_encoder: The media type of the AVCodec object "
-                            "for \"%s\" is currently supported by fw_init_encoder.\n",
-                            codec_name);
-            goto error0;
-    }
+    pEnc->pFrameArray       = pFrameArray;
+    pEnc->frames_available  = frames_available;
+    pEnc->owns_frames       = owns_frames;
+    pEnc->pY4m              = NULL;
+    
+    /* The following is implicitly true*/
+    /* pEnc->pPreproc          = *pPreproc */;
+    
+    pEnc->frame_preprocing  = 0;
+    pEnc->frames_preproced  = 0;
+    pEnc->nomore_eframes    = 0;
+    pEnc->pFramePreenc      = pFramePreenc;
+    pEnc->encode            = encode;
+    pEnc->nomore_packets    = 0;
+    pEnc->preproced_at_init = 0;
+    pEnc->preproc_ns        = 0;
+    pEnc->encode_ns         = 0;
+
+    return 0;
+    
+    /*Error-related undo operations*/    
+error2:
+    fw_free_preproc(pPreproc);
+error1:
+    avcodec_close(pCodecCtx_dst);
+    av_free(pCodecCtx_dst);
+error0:
+    
+    pEnc->pCodec    = NULL;
+	pEnc->pCodecCtx = NULL;
+
+    pEnc->pFrameArray       = NULL;
+    pEnc->frames_available  = 0;
+    pEnc->owns_frames       = 0;
+    pEnc->pY4m              = NULL;
+    
+    pEnc->frame_preprocing  = 0;
+    pEnc->frames_preproced  = 0;
+    pEnc->nomore_eframes    = 0;
+    pEnc->pFramePreenc      = NULL;
+    pEnc->encode            = NULL;
+    pEnc->nomore_packets    = 0;
+    pEnc->preproced_at_init = 0;
+    
+    return -1;
+}
+
+/*
+    Decode all the frames of the input file with pDec, which is left open for
+    the codec context of the frames
+*/
+static int fw_decode_all(   char                *input_filename,
+                            enum AVMediaType    media_type,
+                            fw_decoder_t        *pDec,
+                            AVFrame             ***ppFrameArray,
+                            uint64_t            *pFrames_available)
+{
+    int ret;
+
+    AVFrame         **pFrameArray = NULL;
+    void            *pVoid = NULL;
+    uint64_t        frames_available;
+    uint64_t        frm_i;
+    int             got_frame;
 
     /*Try to open the input file and setup the decoder*/
-    memset(&decoder, 0, sizeof(fw_decoder_t));
+    memset(pDec, 0, sizeof(fw_decoder_t));
     ret = fw_init_decoder(  input_filename, 
-                            &decoder,
+                            pDec,
                             media_type,
                             FW_NO_BATCHED_READ);
     if(ret < 0)
     {
-        fprintf(stderr, "ERROR: fw_init_decoder failed in fw_init_encoder\n");
+        fprintf(stderr, "ERROR: fw_init_decoder failed in fw_decode_all\n");
         goto error0;
     }
-    pCodecCtx_src = decoder.pCodecCtx;
 
     /*Read in all the decoded frames*/
     for(got_frame = 1, frames_available = 0, frm_i = 0; got_frame != 0; )
@@ -232,9 +520,9 @@ int fw_init_encoder(  char            *input_filename,
             if(NULL == pVoid)
             {
                 fprintf(stderr, "ERROR: realloc failed to allocate space for the "
-                                "array of AVFrame pointers in fw_init_encoder\n");
+                                "array of AVFrame pointers in fw_decode_all\n");
                 frames_available -= 128;
-                goto error2;
+                goto error1;
             }
             
             pFrameArray = (AVFrame**)pVoid;                
@@ -248,18 +536,18 @@ int fw_init_encoder(  char            *input_filename,
             if(NULL == pFrameArray[frm_i])
             {
                 fprintf(stderr, "ERROR: avcodec_alloc_frame failed to allocate memory "
-                                "for a new AVFrame object in fw_init_encoder\n");
-                goto error2;
+                                "for a new AVFrame object in fw_decode_all\n");
+                goto error1;
             }
         }
     
-        ret = fw_decode_nxtpkt( &decoder, 
+        ret = fw_decode_nxtpkt( pDec, 
                                 pFrameArray[frm_i],
                                 &got_frame);
         if(ret < 0)
         {
-            fprintf(stderr, "ERROR: fw_decode_nxtpkt failed in fw_init_encoder\n");
-            goto error2;
+            fprintf(stderr, "ERROR: fw_decode_nxtpkt failed in fw_decode_all\n");
+            goto error1;
         }
         
         if(got_frame != 0)
@@ -271,109 +559,256 @@ int fw_init_encoder(  char            *input_filename,
     frames_available = frm_i;
     if(NULL != pFrameArray[frm_i])
     {
-        fw_free_decoded_data(&decoder, pFrameArray[frm_i]);
+        fw_free_decoded_data(pDec, pFrameArray[frm_i]);
         avcodec_free_frame(&(pFrameArray[frm_i]));
     }
 
+    *ppFrameArray       = pFrameArray;
+    *pFrames_available  = frames_available;
+    return 0;
 
-    /*Setup the encoder*/
-    
-    /*Allocate a codec context*/
-    pCodecCtx_dst = avcodec_alloc_context3(pCodec_dst);
-    if(NULL == pCodecCtx_dst)
+error1:
+    for(frm_i = 0; frm_i < frames_available; frm_i++)
     {
-        fprintf(stderr, "ERROR: avcodec_alloc_context3 failed to allocate memory"
-                        "for a codec context in fw_init_encoder\n");
-        goto error2;
+        if(NULL != pFrameArray[frm_i])
+        {
+            fw_free_copied_data(media_type, pFrameArray[frm_i]);
+            avcodec_free_frame(&(pFrameArray[frm_i]));
+        }
+        else
+        {
+            break;
+        }
     }
     
-    /*Setup the preprocessor and parameters for the codec*/
-    ret = fw_init_preproc(pCodecCtx_src,
-                          pCodec_dst,
-                          pCodecCtx_dst,
-                          pPreproc,
-                          pParams);
-    if(ret < 0)
+    if(NULL != pFrameArray)
     {
-        fprintf(stderr, "ERROR: fw_init_preproc failed in fw_init_encoder\n");
-        goto error3;
+        free(pFrameArray);
     }
+    fw_free_decoder(pDec);
+error0:
+    return -1;
+}
+
+/*
+    Decode the input file once, and setup encoder_count encoders (one for each
+    element of pParams) that share the decoded frames, like the renditions of
+    an ABR ladder. The first encoder owns the frames, so fw_free_encoders
+    frees the encoders in reverse order. A y4m input is mapped instead of
+    decoded, unless direct_read is cleared, and the frames point into the
+    mapping.
+*/
+int fw_init_encoders(   char            *input_filename,
+                        fw_encoder_t    *pEncs,
+                        fw_eparams_t    *pParams,
+                        int             encoder_count)
+{
+    int ret;
+    
+    char  *codec_name;    
+    enum AVMediaType    media_type;
+    
+    AVCodec         *pCodec_dst;
+
+    fw_decoder_t    decoder;
+    fw_y4m_t        *pY4m = NULL;
+    AVCodecContext  *pCodecCtx_src;
+
+    AVFrame         **pFrameArray = NULL;
+    uint64_t        frames_available;
+    uint64_t        frm_i;
+    int             enc_i;
+
+    /*Extract the encoding parameters*/
+    codec_name = pParams[0].codec_name;
         
-    /*Allocate the AVFrame object to be used for the encoder*/
-    ret = pPreproc->alloc_preproc_frame(&pFramePreenc,
-                                        pPreproc->preproc_state);
-    if (ret < 0)
+    /*Find the codec, which determines the stream that is decoded*/
+    pCodec_dst = avcodec_find_encoder_by_name(codec_name);
+    if(NULL == pCodec_dst) 
+    {
+        fprintf(stderr, "ERROR: avcodec_find_encoder_by_name failed to find codec of "
+                        "of name \"%s\" in fw_init_encoders\n", codec_name);
+        goto error0;
+    }
+
+    /*Determine the media type*/
+    media_type = pCodec_dst->type;
+    if((AVMEDIA_TYPE_AUDIO != media_type) && (AVMEDIA_TYPE_VIDEO != media_type))
+    {
+        fprintf(stderr, "ERROR fw_init_encoders: The media type of the AVCodec object "
+                        "for \"%s\" is currently supported by fw_init_encoders.\n",
+                        codec_name);
+        goto error0;
+    }
+
+    /*Try to map a y4m input*/
+    if((AVMEDIA_TYPE_VIDEO == media_type) && (0 != pParams[0].direct_read))
+    {
+        pY4m = (fw_y4m_t*)malloc(sizeof(fw_y4m_t));
+        if(NULL == pY4m)
+        {
+            fprintf(stderr, "ERROR: malloc failed to allocate memory for an "
+                            "fw_y4m_t object in fw_init_encoders\n");
+            goto error0;
+        }
+
+        ret = fw_y4m_open(input_filename, pY4m);
+        if(0 != ret)
+        {
+            free(pY4m);
+            pY4m = NULL;
+        }
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: fw_y4m_open failed in fw_init_encoders\n");
+            goto error0;
+        }
+    }
+
+    /*Otherwise, decode all the frames*/
+    if(NULL != pY4m)
     {
-        fprintf(stderr, "ERROR: alloc_preproc_frame failed in fw_init_encoder\n");
-        goto error4;
+        pCodecCtx_src       = pY4m->pCodecCtx;
+        pFrameArray         = pY4m->pFrameArray;
+        frames_available    = pY4m->frames_available;
+    }
+    else
+    {
+        ret = fw_decode_all(input_filename,
+                            media_type,
+                            &decoder,
+                            &pFrameArray,
+                            &frames_available);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: fw_decode_all failed in fw_init_encoders\n");
+            goto error0;
+        }
+        pCodecCtx_src = decoder.pCodecCtx;
+
+        /*The ring of the audio preprocessor is sized for the largest decoded
+        frame, which the frame size of a decoder does not always tell*/
+        for(frm_i = 0; (AVMEDIA_TYPE_AUDIO == media_type) && (frm_i < frames_available);
+            frm_i++)
+        {
+            if(pFrameArray[frm_i]->nb_samples > pCodecCtx_src->frame_size)
+            {
+                pCodecCtx_src->frame_size = pFrameArray[frm_i]->nb_samples;
+            }
+        }
     }
 
+    /*Setup the encoders*/
+    for(enc_i = 0; enc_i < encoder_count; enc_i++)
+    {
+        ret = fw_setup_encoder( &(pEncs[enc_i]),
+                                &(pParams[enc_i]),
+                                pCodecCtx_src,
+                                pFrameArray,
+                                frames_available,
+                                (0 == enc_i));
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: fw_setup_encoder failed for encoder %i in "
+                            "fw_init_encoders\n", enc_i);
+            goto error1;
+        }
+    }
+    /*The owner of the frames unmaps the file*/
+    pEncs[0].pY4m = pY4m;
+
     /*Nothing left to do with the decoder. Free it.*/
-    fw_free_decoder(&decoder);
-    
-    /*Assign the new values to the encoder structure*/
-    pEnc->pCodec    = pCodec_dst;
-	pEnc->pCodecCtx = pCodecCtx_dst;
+    if(NULL == pY4m)
+    {
+        fw_free_decoder(&decoder);
+    }
 
-    pEnc->pFrameArray       = pFrameArray;
-    pEnc->frames_available  = frames_available;
-    
-    /* The following is implicitly true*/
-    /* pEnc->pPreproc          = *pPreproc */;
-    
-    pEnc->frame_preprocing  = 0;
-    pEnc->frames_preproced  = 0;
-    pEnc->nomore_eframes    = 0;
-    pEnc->pFramePreenc      = pFramePreenc;
-    pEnc->encode            = encode;
-    pEnc->nomore_packets    = 0;
+    /*Optionally take the preprocessing out of fw_encode_step. The frames are
+    shared, so the setting of the first encoder applies to all of them, and the
+    owner of the source frames goes last.*/
+    if(0 != pParams[0].preproc_at_init)
+    {
+        for(enc_i = encoder_count - 1; enc_i >= 0; enc_i--)
+        {
+            ret = fw_preproc_all(&(pEncs[enc_i]));
+            if(ret < 0)
+            {
+                fprintf(stderr, "ERROR: fw_preproc_all failed in fw_init_encoders\n");
+                fw_free_encoders(pEncs, encoder_count);
+                return -1;
+            }
+        }
+    }
 
     return 0;
     
     /*Error-related undo operations*/    
-error4:
-    fw_free_preproc(pPreproc);
-error3:
-    avcodec_close(pCodecCtx_dst);
-    av_free(pCodecCtx_dst);
-error2:
-    for(frm_i = 0; frm_i < frames_available; frm_i++)
+error1:
+    /*The frames are freed below*/
+    while(enc_i > 0)
     {
-        if(NULL != pFrameArray[frm_i])
+        enc_i--;
+        pEncs[enc_i].owns_frames = 0;
+        fw_free_encoder(&(pEncs[enc_i]));
+    }
+
+    if(NULL != pY4m)
+    {
+        fw_y4m_close(pY4m);
+        free(pY4m);
+    }
+    else
+    {
+        for(frm_i = 0; frm_i < frames_available; frm_i++)
         {
             fw_free_copied_data(media_type, pFrameArray[frm_i]);
             avcodec_free_frame(&(pFrameArray[frm_i]));
         }
-        else
-        {
-            break;
-        }
-    }
-    
-    if(NULL != pFrameArray)
-    {
         free(pFrameArray);
+        fw_free_decoder(&decoder);
     }
-/*error1:*/
-    fw_free_decoder(&decoder);
 error0:
-    
-    pEnc->pCodec    = NULL;
-	pEnc->pCodecCtx = NULL;
-
-    pEnc->pFrameArray       = NULL;
-    pEnc->frames_available  = 0;
-    
-    pEnc->frame_preprocing  = 0;
-    pEnc->frames_preproced  = 0;
-    pEnc->nomore_eframes    = 0;
-    pEnc->pFramePreenc      = NULL;
-    pEnc->encode            = NULL;
-    pEnc->nomore_packets    = 0;
-    
     return -1;
 }
 
+int fw_init_encoder(  char            *input_filename,
+                      fw_encoder_t    *pEnc,
+                      fw_eparams_t    *pParams)
+{
+    return fw_init_encoders(input_filename, pEnc, pParams, 1);
+}
+
+/*
+    The most packets that the encoder can produce for its frames, apart from
+    the ones that it holds back until it is flushed. The encoder produces at
+    most one packet per frame it is given, but the audio that is preprocessed
+    in the jobs is cut into frames of the encoder frame size, which may be
+    more than the decoded frames.
+*/
+uint64_t fw_encoder_max_packets(fw_encoder_t *pEnc)
+{
+    fw_audio_preproc_t  *pAudio;
+    int64_t             samples = 0;
+    uint64_t            frm_i;
+
+    if((AVMEDIA_TYPE_AUDIO != pEnc->preproc.media_type) ||
+       (0 != pEnc->preproced_at_init))
+    {
+        return pEnc->frames_available;
+    }
+
+    pAudio = (fw_audio_preproc_t*)pEnc->preproc.preproc_state;
+    for(frm_i = 0; frm_i < pEnc->frames_available; frm_i++)
+    {
+        samples += pEnc->pFrameArray[frm_i]->nb_samples;
+    }
+    samples = av_rescale_rnd(samples, pAudio->smpl_rate_dst, pAudio->smpl_rate_src,
+                             AV_ROUND_UP);
+
+    /*The last frame may be a partial one*/
+    return (uint64_t)(samples / pAudio->framesize_dst) + 1;
+}
+
 int fw_encode_step( fw_encoder_t *pEnc,
                     int          *frame_consumed,
                     AVPacket     *pPacket,
@@ -390,6 +825,9 @@ int fw_encode_step( fw_encoder_t *pEnc,
     uint64_t            frames_preproced= pEnc->frames_preproced;
     int                 nomore_eframes  = pEnc->nomore_eframes;
     AVFrame         	*pFramePreenc   = pEnc->pFramePreenc;
+    /*The frame that is passed to the encoder*/
+    AVFrame             *pFrameEnc      = pFramePreenc;
+    uint64_t            start_ns;
 
     /*This is not done explicitly to prevent confusion*/
     /*fw_encode_t         encode          = pEnc->encode;*/
@@ -407,8 +845,25 @@ int fw_encode_step( fw_encoder_t *pEnc,
         goto exit0;
     }
     
+    start_ns = fw_now_ns();
+
+    /*Check if the frames were preprocessed by fw_init_encoder*/
+    if(0 != pEnc->preproced_at_init)
+    {
+        if(frames_preproced < frames_available)
+        {
+            pFrameEnc = pFrameArray[frames_preproced];
+            frames_preproced++;
+            *frame_consumed = 1;
+            got_preproced_frame = 1;
+        }
+        else
+        {
+            nomore_eframes = 1;
+        }
+    }
     /*Check if there are additional frames to preprocess*/
-    if( (frames_preproced < frames_available) || (frame_preprocing != 0))
+    else if( (frames_preproced < frames_available) || (frame_preprocing != 0))
     {
         /*Start or continue preprocessing the relevant frame*/
         ret = pPreproc->preproc(pPreproc->preproc_state,
@@ -455,12 +910,15 @@ int fw_encode_step( fw_encoder_t *pEnc,
         }
     }
     
+    pEnc->preproc_ns += fw_now_ns() - start_ns;
+    start_ns = fw_now_ns();
+
     /*Chcek if there is a frame to encode*/
     if(0 != got_preproced_frame)
     {
         ret = pEnc->encode( pCodecCtx, 
                             pPacket, 
-                            pFramePreenc, 
+                            pFrameEnc, 
                             packet_produced);
         if(ret < 0)
         {
@@ -500,6 +958,8 @@ int fw_encode_step( fw_encoder_t *pEnc,
         /*else There may be additional frames to encode*/
     }
 
+    pEnc->encode_ns += fw_now_ns() - start_ns;
+
     pEnc->frame_preprocing= frame_preprocing;
     pEnc->frames_preproced= frames_preproced;
     pEnc->nomore_eframes  = nomore_eframes;
@@ -513,8 +973,11 @@ exit0:
 void fw_free_encoder(fw_encoder_t    *pEnc)
 {
     uint64_t    frm_i;
+    /*fw_free_preproc clears the function pointers, and the frames that were
+    preprocessed at init are freed after it*/
+    fw_free_preproc_frame_t free_preproc_frame = pEnc->preproc.free_preproc_frame;
     
-    pEnc->preproc.free_preproc_frame(pEnc->pFramePreenc);
+    free_preproc_frame(pEnc->pFramePreenc);
     fw_free_preproc(&(pEnc->preproc));
 
     /*it is possible that avcodec_close is called twice against the codec context for 
@@ -522,19 +985,24 @@ void fw_free_encoder(fw_encoder_t    *pEnc)
     avcodec_close(pEnc->pCodecCtx);
     av_free(pEnc->pCodecCtx);
 
-    for(frm_i = 0; frm_i < pEnc->frames_available; frm_i++)
+    /*The frames that are shared with other encoders are freed by their owner*/
+    if((0 != pEnc->owns_frames) && (0 != pEnc->preproced_at_init))
     {
-        if(NULL != (pEnc->pFrameArray[frm_i]))
-        {
-            fw_free_copied_data(pEnc->preproc.media_type, pEnc->pFrameArray[frm_i]);
-            avcodec_free_frame(&(pEnc->pFrameArray[frm_i]));
-        }
-        else
+        for(frm_i = 0; frm_i < pEnc->frames_available; frm_i++)
         {
-            break;
+            if(NULL == (pEnc->pFrameArray[frm_i]))
+            {
+                break;
+            }
+            free_preproc_frame(pEnc->pFrameArray[frm_i]);
+            pEnc->pFrameArray[frm_i] = NULL;
         }
+        free(pEnc->pFrameArray);
+    }
+    else if(0 != pEnc->owns_frames)
+    {
+        fw_free_source_frames(pEnc);
     }
-    free(pEnc->pFrameArray);
     
     pEnc->pCodec    = NULL;
 	pEnc->pCodecCtx = NULL;
@@ -548,6 +1016,19 @@ void fw_free_encoder(fw_encoder_t    *pEnc)
     pEnc->pFramePreenc      = NULL;
     pEnc->encode            = NULL;
     pEnc->nomore_packets    = 0;
+    pEnc->preproced_at_init = 0;
+    pEnc->owns_frames       = 0;
+}
+
+void fw_free_encoders(fw_encoder_t *pEncs, int encoder_count)
+{
+    int enc_i;
+
+    /*The first encoder owns the shared frames*/
+    for(enc_i = encoder_count - 1; enc_i >= 0; enc_i--)
+    {
+        fw_free_encoder(&(pEncs[enc_i]));
+    }
 }
 
 #ifdef TEST_FW_ENCODER
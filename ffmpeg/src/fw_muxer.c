@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ffmpegwrapper.h"
+
+/*how long the writer thread sleeps when there are no packets to write*/
+#define FW_MUXER_IDLE_NS (100000)
+
+static inline uint64_t fw_muxer_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    Returns 1 if the container that is guessed from filename wants the codec
+    headers out of band (CODEC_FLAG_GLOBAL_HEADER), which must be set before
+    the encoder is opened
+*/
+int fw_muxer_global_header(char *filename)
+{
+    AVOutputFormat *pFormat = av_guess_format(NULL, filename, NULL);
+
+    return (NULL != pFormat) && (0 != (pFormat->flags & AVFMT_GLOBALHEADER));
+}
+
+/*
+    Write the packet at the tail of the ring
+*/
+static void fw_muxer_write(fw_muxer_t *pMux, AVPacket *pPacket)
+{
+    int ret;
+    int size = pPacket->size;
+    uint64_t start_ns;
+    uint64_t write_ns;
+
+    /*Once a write failed, the packets are only freed*/
+    if(0 != pMux->write_failed)
+    {
+        av_free_packet(pPacket);
+        return;
+    }
+
+    /*The encoder counts in its own time base*/
+    if(AV_NOPTS_VALUE != pPacket->pts)
+    {
+        pPacket->pts = av_rescale_q(pPacket->pts, pMux->time_base_enc,
+                                    pMux->pStream->time_base);
+    }
+    if(AV_NOPTS_VALUE != pPacket->dts)
+    {
+        pPacket->dts = av_rescale_q(pPacket->dts, pMux->time_base_enc,
+                                    pMux->pStream->time_base);
+    }
+    pPacket->stream_index = pMux->pStream->index;
+
+    start_ns = fw_muxer_now_ns();
+    ret = av_interleaved_write_frame(pMux->pFormatCtx, pPacket);
+    write_ns = fw_muxer_now_ns() - start_ns;
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: av_interleaved_write_frame failed in fw_muxer_write, "
+                        "the remaining packets are dropped\n");
+        pMux->write_failed = 1;
+    }
+    else
+    {
+        pMux->packets_written++;
+        pMux->bytes_written += (uint64_t)size;
+        pMux->write_ns += write_ns;
+        pMux->max_write_ns = (write_ns > pMux->max_write_ns)? write_ns : pMux->max_write_ns;
+    }
+
+    /*The muxer took the data, this only clears the packet*/
+    av_free_packet(pPacket);
+}
+
+/*
+    The writer thread, the consumer of the ring
+*/
+static void* fw_muxer_writer(void *arg)
+{
+    fw_muxer_t *pMux = (fw_muxer_t*)arg;
+    uint32_t head;
+    uint32_t tail = pMux->tail;
+    struct timespec idle = {0, FW_MUXER_IDLE_NS};
+    int stop;
+
+    while(1)
+    {
+        /*Read the stop flag first, so that the packets queued before it was set
+        are still written*/
+        stop = __atomic_load_n(&(pMux->stop), __ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&(pMux->head), __ATOMIC_ACQUIRE);
+
+        if(tail == head)
+        {
+            if(0 != stop)
+            {
+                break;
+            }
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        while(tail != head)
+        {
+            fw_muxer_write(pMux, &(pMux->pRing[tail & (pMux->ring_size - 1)]));
+            tail++;
+            __atomic_store_n(&(pMux->tail), tail, __ATOMIC_RELEASE);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Open filename for the packets of the encoder with the codec context
+    pCodecCtx, and start the writer thread. The container is guessed from the
+    file name. max_packets is the most packets that the encoder can produce
+    (fw_encoder_max_packets), the ring has room for all of them and for the
+    flush, so that a push never waits for the writer.
+*/
+int fw_init_muxer(  char            *filename,
+                    AVCodecContext  *pCodecCtx,
+                    uint64_t        max_packets,
+                    fw_muxer_t      *pMux)
+{
+    int ret;
+    uint32_t i;
+    uint32_t ring_size;
+
+    AVFormatContext *pFormatCtx = NULL;
+    AVStream        *pStream;
+
+    memset(pMux, 0, sizeof(fw_muxer_t));
+
+    /*The head and the tail wrap around a power of 2*/
+    max_packets += FW_MUXER_FLUSH_PACKETS;
+    if(max_packets > (1ULL << 31))
+    {
+        fprintf(stderr, "ERROR: the ring can not hold %llu packets in "
+                        "fw_init_muxer\n", (unsigned long long)max_packets);
+        goto error0;
+    }
+    for(ring_size = 1; ring_size < max_packets; ring_size <<= 1);
+
+    ret = avformat_alloc_output_context2(&pFormatCtx, NULL, NULL, filename);
+    if((ret < 0) || (NULL == pFormatCtx))
+    {
+        fprintf(stderr, "ERROR: avformat_alloc_output_context2 failed to find a "
+                        "container for \"%s\" in fw_init_muxer\n", filename);
+        goto error0;
+    }
+
+    /*The stream takes the parameters of the encoder*/
+    pStream = avformat_new_stream(pFormatCtx, pCodecCtx->codec);
+    if(NULL == pStream)
+    {
+        fprintf(stderr, "ERROR: avformat_new_stream failed in fw_init_muxer\n");
+        goto error1;
+    }
+
+    ret = avcodec_copy_context(pStream->codec, pCodecCtx);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: avcodec_copy_context failed in fw_init_muxer\n");
+        goto error1;
+    }
+    pStream->time_base = pCodecCtx->time_base;
+    if(0 != (pFormatCtx->oformat->flags & AVFMT_GLOBALHEADER))
+    {
+        pStream->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if(0 == (pFormatCtx->oformat->flags & AVFMT_NOFILE))
+    {
+        ret = avio_open(&(pFormatCtx->pb), filename, AVIO_FLAG_WRITE);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: avio_open failed to open \"%s\" in "
+                            "fw_init_muxer\n", filename);
+            goto error1;
+        }
+    }
+
+    ret = avformat_write_header(pFormatCtx, NULL);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: avformat_write_header failed in fw_init_muxer\n");
+        goto error2;
+    }
+
+    pMux->pRing = (AVPacket*)malloc(ring_size * sizeof(AVPacket));
+    if(NULL == pMux->pRing)
+    {
+        fprintf(stderr, "ERROR: malloc failed to allocate the ring of packets in "
+                        "fw_init_muxer\n");
+        goto error2;
+    }
+    for(i = 0; i < ring_size; i++)
+    {
+        av_init_packet(&(pMux->pRing[i]));
+    }
+
+    pMux->pFormatCtx    = pFormatCtx;
+    pMux->pStream       = pStream;
+    pMux->time_base_enc = pCodecCtx->time_base;
+    pMux->ring_size     = ring_size;
+
+    ret = pthread_create(&(pMux->writer), NULL, fw_muxer_writer, pMux);
+    if(0 != ret)
+    {
+        fprintf(stderr, "ERROR: pthread_create failed to start the writer thread in "
+                        "fw_init_muxer (%s)\n", strerror(ret));
+        goto error3;
+    }
+
+    return 0;
+
+error3:
+    free(pMux->pRing);
+error2:
+    if(0 == (pFormatCtx->oformat->flags & AVFMT_NOFILE))
+    {
+        avio_close(pFormatCtx->pb);
+    }
+error1:
+    avformat_free_context(pFormatCtx);
+error0:
+    memset(pMux, 0, sizeof(fw_muxer_t));
+    return -1;
+}
+
+/*
+    Hand a packet of the encoder to the writer thread. The muxer takes the
+    packet, and pPacket is reinitialized. The ring is sized for every packet
+    of the run, so the encoder never waits for the writer. The packet is only
+    dropped, and 1 returned, if it can not be copied, or if the encoder
+    produced more packets than fw_init_muxer was told. Only one thread at a
+    time may push packets.
+*/
+int fw_muxer_push(fw_muxer_t *pMux, AVPacket *pPacket)
+{
+    int ret = 0;
+    uint32_t head = pMux->head;
+    uint32_t backlog = head - __atomic_load_n(&(pMux->tail), __ATOMIC_ACQUIRE);
+
+    if(backlog >= pMux->ring_size)
+    {
+        fprintf(stderr, "ERROR: the ring of %u packets is full in fw_muxer_push, "
+                        "the packet is dropped\n", pMux->ring_size);
+        pMux->packets_dropped++;
+        av_free_packet(pPacket);
+        ret = 1;
+    }
+    /*The writer may get to the packet after the encoder reused its buffer*/
+    else if(av_dup_packet(pPacket) < 0)
+    {
+        fprintf(stderr, "ERROR: av_dup_packet failed in fw_muxer_push, the packet "
+                        "is dropped\n");
+        pMux->packets_dropped++;
+        av_free_packet(pPacket);
+        ret = 1;
+    }
+    else
+    {
+        pMux->pRing[head & (pMux->ring_size - 1)] = *pPacket;
+        __atomic_store_n(&(pMux->head), head + 1, __ATOMIC_RELEASE);
+
+        pMux->packets_queued++;
+        backlog++;
+        pMux->max_backlog = (backlog > pMux->max_backlog)? backlog : pMux->max_backlog;
+    }
+
+    av_init_packet(pPacket);
+    pPacket->data = NULL;
+    pPacket->size = 0;
+
+    return ret;
+}
+
+/*
+    Let the writer thread write out the queued packets, then write the trailer
+    and close the file. The statistics stay valid. Returns -1 if a packet was
+    dropped or could not be written, as the output is incomplete then.
+*/
+int fw_free_muxer(fw_muxer_t *pMux)
+{
+    int ret = 0;
+
+    if(NULL == pMux->pFormatCtx)
+    {
+        return 0;
+    }
+
+    __atomic_store_n(&(pMux->stop), 1, __ATOMIC_RELEASE);
+    pthread_join(pMux->writer, NULL);
+
+    if(av_write_trailer(pMux->pFormatCtx) < 0)
+    {
+        fprintf(stderr, "ERROR: av_write_trailer failed in fw_free_muxer\n");
+        ret = -1;
+    }
+    /*A dropped packet leaves a hole in the output*/
+    ret = ((0 != pMux->write_failed) || (0 != pMux->packets_dropped))? -1 : ret;
+
+    if(0 == (pMux->pFormatCtx->oformat->flags & AVFMT_NOFILE))
+    {
+        avio_close(pMux->pFormatCtx->pb);
+    }
+    avformat_free_context(pMux->pFormatCtx);
+    free(pMux->pRing);
+
+    pMux->pFormatCtx    = NULL;
+    pMux->pStream       = NULL;
+    pMux->pRing         = NULL;
+
+    return ret;
+}
@@ -0,0 +1,536 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <liburing.h>
+#include "ffmpegwrapper.h"
+
+/*O_DIRECT wants the buffers, offsets and lengths aligned to the logical block
+size of the device, 4096 covers the common ones*/
+#define FW_URING_ALIGN (4096)
+
+/*the buffer between the demuxer and fw_uring_read_packet*/
+#define FW_URING_AVIO_BUFFER_SIZE (32768)
+
+enum
+{
+    FW_URING_CHUNK_FREE = 0,
+    FW_URING_CHUNK_INFLIGHT,
+    FW_URING_CHUNK_READY
+};
+
+typedef struct fw_uring_chunk_s
+{
+    /*the chunk of the file in the buffer*/
+    int64_t     index;
+    int         state;
+    /*bytes read, or -errno*/
+    int32_t     length;
+    uint8_t     *pData;
+} fw_uring_chunk_t;
+
+struct fw_uring_s
+{
+    struct io_uring     ring;
+    int                 fd;
+    int64_t             file_size;
+    uint32_t            chunk_size;
+    uint32_t            depth;
+
+    /*chunk k of the file is read into slot k % depth*/
+    uint8_t             *pBuffers;
+    fw_uring_chunk_t    *pChunks;
+    uint32_t            inflight;
+
+    /*the chunks [window_start, next_chunk) are in flight or ready*/
+    int64_t             window_start;
+    int64_t             next_chunk;
+    /*the read position of the demuxer*/
+    int64_t             position;
+
+    AVIOContext         *pIOCtx;
+    fw_uring_stats_t    stats;
+};
+
+static inline uint64_t fw_uring_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    Queue the read of the rest of the chunk, from the pChunk->length bytes that
+    were already read on
+*/
+static int fw_uring_queue(fw_uring_t *pUring, fw_uring_chunk_t *pChunk)
+{
+    struct io_uring_sqe *pSqe;
+
+    pSqe = io_uring_get_sqe(&(pUring->ring));
+    if(NULL == pSqe)
+    {
+        return -1;
+    }
+    io_uring_prep_read(pSqe, pUring->fd, pChunk->pData + pChunk->length,
+                       pUring->chunk_size - (uint32_t)pChunk->length,
+                       ((uint64_t)pChunk->index * pUring->chunk_size) +
+                            (uint64_t)pChunk->length);
+    io_uring_sqe_set_data(pSqe, pChunk);
+
+    pChunk->state = FW_URING_CHUNK_INFLIGHT;
+    (pUring->inflight)++;
+
+    return 0;
+}
+
+/*
+    Wait for the next completion, and mark its chunk ready. A read may complete
+    short, then the rest of the chunk is read again.
+*/
+static int fw_uring_reap(fw_uring_t *pUring)
+{
+    int ret;
+    struct io_uring_cqe *pCqe;
+    fw_uring_chunk_t    *pChunk;
+    int64_t             expected;
+
+    ret = io_uring_wait_cqe(&(pUring->ring), &pCqe);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: io_uring_wait_cqe failed in fw_uring_reap (%s)\n",
+                        strerror(-ret));
+        return -1;
+    }
+
+    pChunk = (fw_uring_chunk_t*)io_uring_cqe_get_data(pCqe);
+    ret = pCqe->res;
+    io_uring_cqe_seen(&(pUring->ring), pCqe);
+    (pUring->inflight)--;
+
+    if(ret < 0)
+    {
+        pChunk->length = ret;
+        pChunk->state  = FW_URING_CHUNK_READY;
+        return 0;
+    }
+    pChunk->length += ret;
+
+    /*only the last chunk of the file is short*/
+    expected = pUring->file_size - (pChunk->index * pUring->chunk_size);
+    expected = (expected > pUring->chunk_size)? pUring->chunk_size : expected;
+
+    if((ret > 0) && (pChunk->length < expected))
+    {
+        /*O_DIRECT reads the rest from the block the short read ended in*/
+        if(0 != pUring->stats.direct)
+        {
+            pChunk->length &= ~(FW_URING_ALIGN - 1);
+        }
+        (pUring->stats.short_reads)++;
+        if(fw_uring_queue(pUring, pChunk) < 0)
+        {
+            fprintf(stderr, "ERROR: no submission queue entry is left to read the "
+                            "rest of a chunk in fw_uring_reap\n");
+            pChunk->state = FW_URING_CHUNK_READY;
+            return -1;
+        }
+
+        ret = io_uring_submit(&(pUring->ring));
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: io_uring_submit failed in fw_uring_reap (%s)\n",
+                            strerror(-ret));
+            return -1;
+        }
+        return 0;
+    }
+
+    pChunk->state = FW_URING_CHUNK_READY;
+    (pUring->stats.chunks_read)++;
+    pUring->stats.bytes_read += (uint64_t)pChunk->length;
+
+    return 0;
+}
+
+/*
+    Keep depth chunks from the read position on in flight
+*/
+static int fw_uring_fill(fw_uring_t *pUring)
+{
+    int ret;
+    int submitted = 0;
+    fw_uring_chunk_t    *pChunk;
+
+    while((pUring->next_chunk < pUring->window_start + pUring->depth) &&
+          (pUring->next_chunk * pUring->chunk_size < pUring->file_size))
+    {
+        pChunk = &(pUring->pChunks[pUring->next_chunk % pUring->depth]);
+
+        pChunk->index  = pUring->next_chunk;
+        pChunk->length = 0;
+        if(fw_uring_queue(pUring, pChunk) < 0)
+        {
+            break;
+        }
+        (pUring->next_chunk)++;
+        submitted++;
+    }
+
+    if(submitted > 0)
+    {
+        ret = io_uring_submit(&(pUring->ring));
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: io_uring_submit failed in fw_uring_fill (%s)\n",
+                            strerror(-ret));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+    Move the window to the chunk of the read position. The buffers of the
+    chunks that are left behind can only be reused once their reads completed.
+*/
+static int fw_uring_slide(fw_uring_t *pUring, int64_t chunk)
+{
+    fw_uring_chunk_t *pChunk;
+
+    /*A seek out of the window drops all of it*/
+    if((chunk < pUring->window_start) || (chunk >= pUring->next_chunk))
+    {
+        while(pUring->inflight > 0)
+        {
+            if(fw_uring_reap(pUring) < 0)
+            {
+                return -1;
+            }
+        }
+        pUring->window_start = chunk;
+        pUring->next_chunk   = chunk;
+        (pUring->stats.restarts)++;
+    }
+
+    while(pUring->window_start < chunk)
+    {
+        pChunk = &(pUring->pChunks[pUring->window_start % pUring->depth]);
+        while(FW_URING_CHUNK_INFLIGHT == pChunk->state)
+        {
+            if(fw_uring_reap(pUring) < 0)
+            {
+                return -1;
+            }
+        }
+        pChunk->state = FW_URING_CHUNK_FREE;
+        (pUring->window_start)++;
+    }
+
+    return fw_uring_fill(pUring);
+}
+
+/*
+    read_packet of the AVIOContext, copies from the chunk of the read position,
+    and only waits if the read-ahead did not keep up
+*/
+static int fw_uring_read_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    fw_uring_t          *pUring = (fw_uring_t*)opaque;
+    fw_uring_chunk_t    *pChunk;
+    int64_t             chunk;
+    int64_t             offset;
+    int                 length;
+    uint64_t            start_ns;
+    uint64_t            stall_ns;
+
+    (pUring->stats.reads)++;
+
+    if(pUring->position >= pUring->file_size)
+    {
+        return AVERROR_EOF;
+    }
+
+    chunk  = pUring->position / pUring->chunk_size;
+    offset = pUring->position - chunk * pUring->chunk_size;
+
+    if(fw_uring_slide(pUring, chunk) < 0)
+    {
+        return AVERROR(EIO);
+    }
+
+    pChunk = &(pUring->pChunks[chunk % pUring->depth]);
+    if(FW_URING_CHUNK_READY != pChunk->state)
+    {
+        start_ns = fw_uring_now_ns();
+        while(FW_URING_CHUNK_READY != pChunk->state)
+        {
+            if(fw_uring_reap(pUring) < 0)
+            {
+                return AVERROR(EIO);
+            }
+        }
+        stall_ns = fw_uring_now_ns() - start_ns;
+
+        (pUring->stats.stalls)++;
+        pUring->stats.stall_ns += stall_ns;
+        pUring->stats.max_stall_ns = (stall_ns > pUring->stats.max_stall_ns)?
+                                        stall_ns : pUring->stats.max_stall_ns;
+    }
+
+    if(pChunk->length < 0)
+    {
+        fprintf(stderr, "ERROR: the read of chunk %lli failed in fw_uring_read_packet "
+                        "(%s)\n", (long long)chunk, strerror(-(pChunk->length)));
+        return AVERROR(EIO);
+    }
+    if(offset >= pChunk->length)
+    {
+        /*the file ended before its size, it was cut while it was read*/
+        fprintf(stderr, "ERROR: the file ended in chunk %lli in fw_uring_read_packet\n",
+                        (long long)chunk);
+        return AVERROR(EIO);
+    }
+
+    length = pChunk->length - (int)offset;
+    length = (length < buf_size)? length : buf_size;
+    memcpy(buf, pChunk->pData + offset, length);
+    pUring->position += length;
+
+    return length;
+}
+
+/*
+    seek of the AVIOContext, the window follows the read position at the next
+    read
+*/
+static int64_t fw_uring_seek(void *opaque, int64_t offset, int whence)
+{
+    fw_uring_t  *pUring = (fw_uring_t*)opaque;
+    int64_t     position;
+
+    switch(whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE:
+            return pUring->file_size;
+
+        case SEEK_SET:
+            position = offset;
+            break;
+
+        case SEEK_CUR:
+            position = pUring->position + offset;
+            break;
+
+        case SEEK_END:
+            position = pUring->file_size + offset;
+            break;
+
+        default:
+            return AVERROR(EINVAL);
+    }
+
+    if(position < 0)
+    {
+        return AVERROR(EINVAL);
+    }
+    pUring->position = position;
+
+    return position;
+}
+
+/*
+    Open filename for reads through io_uring, with depth chunks of chunk_size
+    bytes read ahead of the read position. The file is opened with O_DIRECT,
+    unless the file system does not support it. The demuxer reads the file
+    through the AVIOContext returned by fw_uring_avio.
+*/
+int fw_uring_open(  char            *filename,
+                    uint32_t        depth,
+                    uint32_t        chunk_size,
+                    fw_uring_t      **ppUring)
+{
+    int ret;
+    uint32_t i;
+    struct stat file_stat;
+    void *pVoid;
+    uint8_t *pIObuffer;
+
+    fw_uring_t *pUring;
+
+    if(0 == depth)
+    {
+        fprintf(stderr, "ERROR: the read-ahead depth must be at least 1 in "
+                        "fw_uring_open\n");
+        goto error0;
+    }
+
+    pUring = (fw_uring_t*)calloc(1, sizeof(fw_uring_t));
+    if(NULL == pUring)
+    {
+        fprintf(stderr, "ERROR: calloc failed to allocate memory for an fw_uring_t "
+                        "object in fw_uring_open\n");
+        goto error0;
+    }
+
+    /*Round the chunks up to whole blocks*/
+    pUring->chunk_size = (chunk_size + FW_URING_ALIGN - 1) & ~(FW_URING_ALIGN - 1);
+    pUring->chunk_size = (0 == pUring->chunk_size)? FW_URING_ALIGN : pUring->chunk_size;
+    pUring->depth      = depth;
+
+    pUring->fd = open(filename, O_RDONLY | O_DIRECT);
+    pUring->stats.direct = 1;
+    if((pUring->fd < 0) && (EINVAL == errno))
+    {
+        fprintf(stderr, "WARNING: the file system of \"%s\" does not support O_DIRECT, "
+                        "the reads go through the page cache in fw_uring_open\n",
+                        filename);
+        pUring->fd = open(filename, O_RDONLY);
+        pUring->stats.direct = 0;
+    }
+    if(pUring->fd < 0)
+    {
+        fprintf(stderr, "ERROR: open failed to open \"%s\" in fw_uring_open ", filename);
+        perror("");
+        goto error1;
+    }
+
+    ret = fstat(pUring->fd, &file_stat);
+    if(ret < 0)
+    {
+        perror("ERROR: fstat failed in fw_uring_open");
+        goto error2;
+    }
+    pUring->file_size = (int64_t)file_stat.st_size;
+
+    ret = posix_memalign(&pVoid, FW_URING_ALIGN, (size_t)depth * pUring->chunk_size);
+    if(0 != ret)
+    {
+        fprintf(stderr, "ERROR: posix_memalign failed to allocate the read-ahead "
+                        "buffers in fw_uring_open\n");
+        goto error2;
+    }
+    pUring->pBuffers = (uint8_t*)pVoid;
+
+    pUring->pChunks = (fw_uring_chunk_t*)calloc(depth, sizeof(fw_uring_chunk_t));
+    if(NULL == pUring->pChunks)
+    {
+        fprintf(stderr, "ERROR: calloc failed to allocate the chunks in "
+                        "fw_uring_open\n");
+        goto error3;
+    }
+    for(i = 0; i < depth; i++)
+    {
+        pUring->pChunks[i].pData = pUring->pBuffers + (size_t)i * pUring->chunk_size;
+    }
+
+    ret = io_uring_queue_init(depth, &(pUring->ring), 0);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: io_uring_queue_init failed in fw_uring_open (%s)\n",
+                        strerror(-ret));
+        goto error4;
+    }
+
+    pIObuffer = (uint8_t*)av_malloc(FW_URING_AVIO_BUFFER_SIZE);
+    if(NULL == pIObuffer)
+    {
+        fprintf(stderr, "ERROR: av_malloc failed to allocate the AVIOContext buffer "
+                        "in fw_uring_open\n");
+        goto error5;
+    }
+
+    pUring->pIOCtx = avio_alloc_context(pIObuffer, FW_URING_AVIO_BUFFER_SIZE, 0, pUring,
+                                        fw_uring_read_packet, NULL, fw_uring_seek);
+    if(NULL == pUring->pIOCtx)
+    {
+        fprintf(stderr, "ERROR: avio_alloc_context failed in fw_uring_open\n");
+        av_free(pIObuffer);
+        goto error5;
+    }
+
+    /*Start reading ahead before the demuxer asks for anything*/
+    ret = fw_uring_fill(pUring);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: fw_uring_fill failed in fw_uring_open\n");
+        goto error6;
+    }
+
+    *ppUring = pUring;
+    return 0;
+
+error6:
+    while(pUring->inflight > 0)
+    {
+        if(fw_uring_reap(pUring) < 0)
+        {
+            break;
+        }
+    }
+    av_free(pUring->pIOCtx->buffer);
+    av_free(pUring->pIOCtx);
+error5:
+    io_uring_queue_exit(&(pUring->ring));
+error4:
+    free(pUring->pChunks);
+error3:
+    free(pUring->pBuffers);
+error2:
+    close(pUring->fd);
+error1:
+    free(pUring);
+error0:
+    *ppUring = NULL;
+    return -1;
+}
+
+AVIOContext* fw_uring_avio(fw_uring_t *pUring)
+{
+    return pUring->pIOCtx;
+}
+
+const fw_uring_stats_t* fw_uring_stats(fw_uring_t *pUring)
+{
+    return &(pUring->stats);
+}
+
+/*
+    Wait for the reads in flight, and free everything, including the
+    AVIOContext
+*/
+void fw_uring_close(fw_uring_t **ppUring)
+{
+    fw_uring_t *pUring = *ppUring;
+
+    if(NULL == pUring)
+    {
+        return;
+    }
+
+    while(pUring->inflight > 0)
+    {
+        if(fw_uring_reap(pUring) < 0)
+        {
+            break;
+        }
+    }
+    io_uring_queue_exit(&(pUring->ring));
+
+    /*the demuxer may have replaced the buffer*/
+    av_free(pUring->pIOCtx->buffer);
+    av_free(pUring->pIOCtx);
+
+    free(pUring->pChunks);
+    free(pUring->pBuffers);
+    close(pUring->fd);
+    free(pUring);
+
+    *ppUring = NULL;
+}
@@ -2,6 +2,10 @@
 #include <string.h>
 #include "ffmpegwrapper.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 enum Motion_Est_ID fw_video_get_me_method(char * method_name)
 {
     enum Motion_Est_ID me_method = 0;
@@ -46,6 +50,186 @@ enum Motion_Est_ID fw_video_get_me_method(char * method_name)
     return me_method;
 }
 
+/*
+    The SwsContext flags of a rescaler algorithm, or 0 if the name is not
+    recognized
+*/
+int fw_video_get_sws_flags(char *scaler_name)
+{
+    int sws_flags = 0;
+
+    if(0 == strcasecmp(scaler_name, "fast_bilinear"))
+    {
+        sws_flags = SWS_FAST_BILINEAR;
+    }
+    else if(0 == strcasecmp(scaler_name, "bilinear"))
+    {
+        sws_flags = SWS_BILINEAR;
+    }
+    else if(0 == strcasecmp(scaler_name, "bicubic"))
+    {
+        sws_flags = SWS_BICUBIC;
+    }
+    else if(0 == strcasecmp(scaler_name, "lanczos"))
+    {
+        sws_flags = SWS_LANCZOS;
+    }
+    else if(0 == strcasecmp(scaler_name, "area"))
+    {
+        sws_flags = SWS_AREA;
+    }
+
+    return sws_flags;
+}
+
+/*
+    The row kernels of the same-size YUV420P/NV12 conversions
+*/
+static void fw_video_interleave_c(  const uint8_t   *pU,
+                                    const uint8_t   *pV,
+                                    uint8_t         *pUV,
+                                    int             count)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        pUV[2*i]     = pU[i];
+        pUV[2*i + 1] = pV[i];
+    }
+}
+
+static void fw_video_deinterleave_c(const uint8_t   *pUV,
+                                    uint8_t         *pU,
+                                    uint8_t         *pV,
+                                    int             count)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        pU[i] = pUV[2*i];
+        pV[i] = pUV[2*i + 1];
+    }
+}
+
+#if defined(__SSE2__)
+/*16 samples of U and of V per iteration, the rows need not be aligned*/
+static void fw_video_interleave_sse2(   const uint8_t   *pU,
+                                        const uint8_t   *pV,
+                                        uint8_t         *pUV,
+                                        int             count)
+{
+    int i;
+    __m128i u;
+    __m128i v;
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        u = _mm_loadu_si128((const __m128i*)(pU + i));
+        v = _mm_loadu_si128((const __m128i*)(pV + i));
+        _mm_storeu_si128((__m128i*)(pUV + 2*i),      _mm_unpacklo_epi8(u, v));
+        _mm_storeu_si128((__m128i*)(pUV + 2*i + 16), _mm_unpackhi_epi8(u, v));
+    }
+
+    fw_video_interleave_c(pU + i, pV + i, pUV + 2*i, count - i);
+}
+
+static void fw_video_deinterleave_sse2( const uint8_t   *pUV,
+                                        uint8_t         *pU,
+                                        uint8_t         *pV,
+                                        int             count)
+{
+    int i;
+    __m128i uv_lo;
+    __m128i uv_hi;
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        uv_lo = _mm_loadu_si128((const __m128i*)(pUV + 2*i));
+        uv_hi = _mm_loadu_si128((const __m128i*)(pUV + 2*i + 16));
+        /*U is the low byte of every 16 bit pair, V the high byte*/
+        _mm_storeu_si128((__m128i*)(pU + i),
+                         _mm_packus_epi16(_mm_and_si128(uv_lo, mask),
+                                          _mm_and_si128(uv_hi, mask)));
+        _mm_storeu_si128((__m128i*)(pV + i),
+                         _mm_packus_epi16(_mm_srli_epi16(uv_lo, 8),
+                                          _mm_srli_epi16(uv_hi, 8)));
+    }
+
+    fw_video_deinterleave_c(pUV + 2*i, pU + i, pV + i, count - i);
+}
+#endif
+
+/*
+    Returns 1 if the kernels below convert pix_fmt_src to pix_fmt_dst
+*/
+static int fw_video_fast_convertible(enum AVPixelFormat pix_fmt_src,
+                                     enum AVPixelFormat pix_fmt_dst)
+{
+    return ((AV_PIX_FMT_YUV420P == pix_fmt_src) || (AV_PIX_FMT_NV12 == pix_fmt_src)) &&
+           ((AV_PIX_FMT_YUV420P == pix_fmt_dst) || (AV_PIX_FMT_NV12 == pix_fmt_dst));
+}
+
+/*
+    Convert a YUV420P or NV12 frame to a YUV420P or NV12 frame of the same
+    size, the luma plane is the same in both formats
+*/
+static void fw_video_fast_convert(  fw_video_preproc_t  *preproc_p,
+                                    AVFrame             *pFrame_src,
+                                    AVFrame             *pFrame_dst)
+{
+    int row;
+    int width           = preproc_p->width;
+    int height          = preproc_p->height;
+    int chroma_width    = (width + 1)/2;
+    int chroma_height   = (height + 1)/2;
+
+    av_image_copy_plane(pFrame_dst->data[0], pFrame_dst->linesize[0],
+                        pFrame_src->data[0], pFrame_src->linesize[0],
+                        width, height);
+
+    if(preproc_p->pix_fmt_src == preproc_p->pix_fmt_dst)
+    {
+        if(AV_PIX_FMT_NV12 == preproc_p->pix_fmt_src)
+        {
+            av_image_copy_plane(pFrame_dst->data[1], pFrame_dst->linesize[1],
+                                pFrame_src->data[1], pFrame_src->linesize[1],
+                                2*chroma_width, chroma_height);
+        }
+        else
+        {
+            av_image_copy_plane(pFrame_dst->data[1], pFrame_dst->linesize[1],
+                                pFrame_src->data[1], pFrame_src->linesize[1],
+                                chroma_width, chroma_height);
+            av_image_copy_plane(pFrame_dst->data[2], pFrame_dst->linesize[2],
+                                pFrame_src->data[2], pFrame_src->linesize[2],
+                                chroma_width, chroma_height);
+        }
+    }
+    else if(AV_PIX_FMT_NV12 == preproc_p->pix_fmt_dst)
+    {
+        for(row = 0; row < chroma_height; row++)
+        {
+            preproc_p->interleave(pFrame_src->data[1] + row*pFrame_src->linesize[1],
+                                  pFrame_src->data[2] + row*pFrame_src->linesize[2],
+                                  pFrame_dst->data[1] + row*pFrame_dst->linesize[1],
+                                  chroma_width);
+        }
+    }
+    else
+    {
+        for(row = 0; row < chroma_height; row++)
+        {
+            preproc_p->deinterleave(pFrame_src->data[1] + row*pFrame_src->linesize[1],
+                                    pFrame_dst->data[1] + row*pFrame_dst->linesize[1],
+                                    pFrame_dst->data[2] + row*pFrame_dst->linesize[2],
+                                    chroma_width);
+        }
+    }
+}
+
 /*
     For non-matching parameters,
         pick the desired parameter
@@ -84,6 +268,7 @@ int fw_video_init_preproc(   AVCodecContext     *pCodecCtx_src,
     enum AVPixelFormat pixfmt_dst;
     
     struct SwsContext   *pSwsCtx = NULL;
+    int                 sws_flags = SWS_BILINEAR;
     
     fw_video_preproc_t  *preproc_p = NULL;
     
@@ -193,6 +378,14 @@ int fw_video_init_preproc(   AVCodecContext     *pCodecCtx_src,
         av_opt_set(pCodecCtx_dst->priv_data, "preset", "slow", 0);
     }
     
+    /*The user-specified codec options override the settings above*/
+    ret = fw_set_codec_opts(pCodecCtx_dst, eparams->codec_opts);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: fw_set_codec_opts failed in fw_video_init_preproc\n");
+        goto error0;
+    }
+    
     /*Open the codec context*/
     ret = avcodec_open2(pCodecCtx_dst, pCodec_dst, NULL);
     if (ret < 0) 
@@ -201,14 +394,33 @@ int fw_video_init_preproc(   AVCodecContext     *pCodecCtx_src,
         goto error0;
     }
     
-    /*Allocate the rescaler*/
-    pSwsCtx = sws_getContext(   pCodecCtx_src->width, pCodecCtx_src->height, pixfmt_src,
-                                pCodecCtx_dst->width, pCodecCtx_dst->height, pixfmt_dst,
-                                SWS_BILINEAR, NULL, NULL, NULL);
-    if(NULL == pSwsCtx)
+    /*Set the user-specified or default rescaler algorithm*/
+    if(NULL != eparams->scaler)
     {
-        fprintf(stderr, "ERROR: sws_getContext failed in fw_video_init_preproc\n");
-        goto error0;
+        sws_flags = fw_video_get_sws_flags(eparams->scaler);
+        if(0 == sws_flags)
+        {
+            fprintf(stderr, "WARNING fw_video_init_preproc: the rescaler algorithm "
+                            "\"%s\" was not recognized. Defaulting to bilinear.\n", 
+                            eparams->scaler);
+            sws_flags = SWS_BILINEAR;
+        }
+    }
+    
+    /*Allocate the rescaler, unless the frames only change between YUV420P and NV12*/
+    if( (0 == eparams->fast_convert) ||
+        (pCodecCtx_src->width  != pCodecCtx_dst->width) ||
+        (pCodecCtx_src->height != pCodecCtx_dst->height) ||
+        (0 == fw_video_fast_convertible(pixfmt_src, pixfmt_dst)))
+    {
+        pSwsCtx = sws_getContext(   pCodecCtx_src->width, pCodecCtx_src->height, pixfmt_src,
+                                    pCodecCtx_dst->width, pCodecCtx_dst->height, pixfmt_dst,
+                                    sws_flags, NULL, NULL, NULL);
+        if(NULL == pSwsCtx)
+        {
+            fprintf(stderr, "ERROR: sws_getContext failed in fw_video_init_preproc\n");
+            goto error0;
+        }
     }
     
     /*Allocate space for the preprocessor*/
@@ -227,6 +439,20 @@ int fw_video_init_preproc(   AVCodecContext     *pCodecCtx_src,
     preproc_p->height       = pCodecCtx_dst->height;
     preproc_p->pSwsCtx      = pSwsCtx;
     
+    /*Pick the kernels for the cpu. SSE2 is the baseline of x86-64, so the
+    check only matters for 32 bit x86 builds, and there is no wider variant*/
+    preproc_p->interleave   = fw_video_interleave_c;
+    preproc_p->deinterleave = fw_video_deinterleave_c;
+    preproc_p->path         = (NULL == pSwsCtx)? "c" : "swscale";
+#if defined(__SSE2__)
+    if((NULL == pSwsCtx) && (0 != (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)))
+    {
+        preproc_p->interleave   = fw_video_interleave_sse2;
+        preproc_p->deinterleave = fw_video_deinterleave_sse2;
+        preproc_p->path         = "sse2";
+    }
+#endif
+    
     /*Set the p_preproc_state output variable*/
     *p_preproc_state = preproc_p;
     return 0;
@@ -328,13 +554,20 @@ int fw_video_preproc(   void    *preproc_state,
         goto exit0;
     }
 
-    sws_scale( 	preproc_p->pSwsCtx,
-		        (const uint8_t * const*)pFrame_src->data,
-		        pFrame_src->linesize,
-		        0,
-		        pFrame_src->height,
-		        pFrame_dst->data,
-		        pFrame_dst->linesize);
+    if(NULL == preproc_p->pSwsCtx)
+    {
+        fw_video_fast_convert(preproc_p, pFrame_src, pFrame_dst);
+    }
+    else
+    {
+        sws_scale( 	preproc_p->pSwsCtx,
+		            (const uint8_t * const*)pFrame_src->data,
+		            pFrame_src->linesize,
+		            0,
+		            pFrame_src->height,
+		            pFrame_dst->data,
+		            pFrame_dst->linesize);
+    }
     
     /*Increment the PTS value*/
     if((0 == pFrame_src->pts) || (AV_NOPTS_VALUE == pFrame_src->pts))
@@ -354,6 +587,15 @@ exit0:
     return ret;
 }
 
+/*
+    The conversion path of the preprocessor, "swscale" or the kernels of the
+    same-size YUV420P/NV12 conversions ("c" or "sse2")
+*/
+const char* fw_video_preproc_path(void *preproc_state)
+{
+    return ((fw_video_preproc_t*)preproc_state)->path;
+}
+
 /*
     This function should only be called when the frame_consumed flag is set
     for the last frame in the input stream
@@ -372,8 +614,11 @@ void fw_video_free_preproc(void **p_preproc_state)
 {
     fw_video_preproc_t  *preproc_p = (fw_video_preproc_t*)(*p_preproc_state);
     
-    /*Free the image rescaler*/
-    sws_freeContext(preproc_p->pSwsCtx);
+    /*Free the image rescaler, if there is one*/
+    if(NULL != preproc_p->pSwsCtx)
+    {
+        sws_freeContext(preproc_p->pSwsCtx);
+    }
     
     /*Free the fw_video_preproc_t object*/
     free(preproc_p);
@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ffmpegwrapper.h"
+
+#define FW_Y4M_MAGIC        "YUV4MPEG2 "
+#define FW_Y4M_FRAME_MAGIC  "FRAME"
+
+/*
+    Parse the stream header of a y4m file (without the magic). Returns 1 for a
+    colorspace that the reader does not map.
+*/
+static int fw_y4m_parse_header(char                 *header,
+                               int                  *pWidth,
+                               int                  *pHeight,
+                               AVRational           *pFramerate,
+                               enum AVPixelFormat   *pPix_fmt)
+{
+    char *token;
+    char *saveptr;
+    char *endptr;
+
+    *pWidth  = 0;
+    *pHeight = 0;
+    pFramerate->num = 25;
+    pFramerate->den = 1;
+    /*the colorspace defaults to 4:2:0*/
+    *pPix_fmt = AV_PIX_FMT_YUV420P;
+
+    for(token = strtok_r(header, " ", &saveptr);
+        NULL != token;
+        token = strtok_r(NULL, " ", &saveptr))
+    {
+        switch(token[0])
+        {
+            case 'W':
+                *pWidth = (int)strtol(token + 1, NULL, 10);
+                break;
+
+            case 'H':
+                *pHeight = (int)strtol(token + 1, NULL, 10);
+                break;
+
+            case 'F':
+                pFramerate->num = (int)strtol(token + 1, &endptr, 10);
+                pFramerate->den = (':' == *endptr)? (int)strtol(endptr + 1, NULL, 10) : 0;
+                break;
+
+            case 'C':
+                if(0 == strcmp(token + 1, "420") ||
+                   0 == strcmp(token + 1, "420jpeg") ||
+                   0 == strcmp(token + 1, "420mpeg2") ||
+                   0 == strcmp(token + 1, "420paldv"))
+                {
+                    *pPix_fmt = AV_PIX_FMT_YUV420P;
+                }
+                else if(0 == strcmp(token + 1, "422"))
+                {
+                    *pPix_fmt = AV_PIX_FMT_YUV422P;
+                }
+                else if(0 == strcmp(token + 1, "444"))
+                {
+                    *pPix_fmt = AV_PIX_FMT_YUV444P;
+                }
+                else if(0 == strcmp(token + 1, "mono"))
+                {
+                    *pPix_fmt = AV_PIX_FMT_GRAY8;
+                }
+                else
+                {
+                    /*high bit depth and alpha are left to the rawvideo decoder*/
+                    return 1;
+                }
+                break;
+
+            default:
+                /*the interlacing, aspect ratio and X parameters do not change the
+                layout of the frames*/
+                break;
+        }
+    }
+
+    if((*pWidth <= 0) || (*pHeight <= 0) || (pFramerate->num <= 0) ||
+       (pFramerate->den <= 0))
+    {
+        fprintf(stderr, "ERROR: invalid stream header in fw_y4m_parse_header\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    Map the y4m file filename, and build an AVFrame for every frame of the file,
+    with data pointers straight into the mapping. Returns 1, without opening
+    anything, if the file is not a y4m file that the reader can map, so that
+    the caller can decode it instead.
+*/
+int fw_y4m_open(char *filename, fw_y4m_t *pY4m)
+{
+    int ret;
+    int fd;
+    struct stat file_stat;
+
+    char        magic[sizeof(FW_Y4M_MAGIC) - 1];
+    char        header[1024];
+    uint8_t     *pHeader_end;
+    size_t      offset;
+
+    int                 width;
+    int                 height;
+    AVRational          framerate;
+    enum AVPixelFormat  pix_fmt;
+    int                 chroma_width;
+    int                 chroma_height;
+    size_t              frame_size;
+
+    AVCodecContext  *pCodecCtx;
+    AVFrame         **pFrameArray = NULL;
+    AVFrame         *pFrame;
+    void            *pVoid;
+    uint64_t        frames_space = 0;
+    uint64_t        frm_i = 0;
+
+    memset(pY4m, 0, sizeof(fw_y4m_t));
+
+    fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        fprintf(stderr, "ERROR: open failed to open \"%s\" in fw_y4m_open ", filename);
+        perror("");
+        goto error0;
+    }
+
+    /*Check the magic before mapping (and reading in) the whole file*/
+    ret = pread(fd, magic, sizeof(magic), 0);
+    if((sizeof(magic) != ret) || (0 != memcmp(magic, FW_Y4M_MAGIC, sizeof(magic))))
+    {
+        close(fd);
+        return 1;
+    }
+
+    ret = fstat(fd, &file_stat);
+    if(ret < 0)
+    {
+        perror("ERROR: fstat failed in fw_y4m_open");
+        goto error1;
+    }
+    pY4m->map_size = (size_t)file_stat.st_size;
+
+    /*Read the whole file in at init, so that no job takes a page fault on it*/
+    pVoid = mmap(NULL, pY4m->map_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if(MAP_FAILED == pVoid)
+    {
+        perror("ERROR: mmap failed in fw_y4m_open");
+        goto error1;
+    }
+    pY4m->pMap = (uint8_t*)pVoid;
+    close(fd);
+
+    /*Parse the stream header*/
+    pHeader_end = (uint8_t*)memchr(pY4m->pMap, '\n', pY4m->map_size);
+    if((NULL == pHeader_end) ||
+       ((size_t)(pHeader_end - pY4m->pMap) - sizeof(magic) >= sizeof(header)))
+    {
+        fprintf(stderr, "ERROR: the stream header of \"%s\" is too long or not "
+                        "terminated in fw_y4m_open\n", filename);
+        goto error2;
+    }
+    offset = (size_t)(pHeader_end - pY4m->pMap) - sizeof(magic);
+    memcpy(header, pY4m->pMap + sizeof(magic), offset);
+    header[offset] = '\0';
+
+    ret = fw_y4m_parse_header(header, &width, &height, &framerate, &pix_fmt);
+    if(0 != ret)
+    {
+        munmap(pY4m->pMap, pY4m->map_size);
+        memset(pY4m, 0, sizeof(fw_y4m_t));
+        return ret;
+    }
+
+    chroma_width  = (AV_PIX_FMT_YUV444P == pix_fmt)? width : (width + 1)/2;
+    chroma_height = (AV_PIX_FMT_YUV420P == pix_fmt)? (height + 1)/2 : height;
+    if(AV_PIX_FMT_GRAY8 == pix_fmt)
+    {
+        chroma_width  = 0;
+        chroma_height = 0;
+    }
+    frame_size = (size_t)width*height + 2*(size_t)chroma_width*chroma_height;
+
+    /*Build a frame for every FRAME header followed by a whole frame*/
+    offset = (size_t)(pHeader_end - pY4m->pMap) + 1;
+    while(offset < pY4m->map_size)
+    {
+        if((pY4m->map_size - offset < sizeof(FW_Y4M_FRAME_MAGIC) - 1) ||
+           (0 != memcmp(pY4m->pMap + offset, FW_Y4M_FRAME_MAGIC,
+                        sizeof(FW_Y4M_FRAME_MAGIC) - 1)))
+        {
+            fprintf(stderr, "ERROR: no frame header at offset %zu of \"%s\" in "
+                            "fw_y4m_open\n", offset, filename);
+            goto error3;
+        }
+
+        pHeader_end = (uint8_t*)memchr(pY4m->pMap + offset, '\n',
+                                       pY4m->map_size - offset);
+        if((NULL == pHeader_end) ||
+           ((size_t)(pY4m->pMap + pY4m->map_size - (pHeader_end + 1)) < frame_size))
+        {
+            fprintf(stderr, "WARNING: the last frame of \"%s\" is truncated, and was "
+                            "dropped in fw_y4m_open\n", filename);
+            break;
+        }
+        offset = (size_t)(pHeader_end - pY4m->pMap) + 1;
+
+        if(frm_i == frames_space)
+        {
+            frames_space += 128;
+
+            pVoid = realloc(pFrameArray, frames_space*sizeof(AVFrame*));
+            if(NULL == pVoid)
+            {
+                fprintf(stderr, "ERROR: realloc failed to allocate space for the "
+                                "array of AVFrame pointers in fw_y4m_open\n");
+                goto error3;
+            }
+            pFrameArray = (AVFrame**)pVoid;
+        }
+
+        pFrame = avcodec_alloc_frame();
+        if(NULL == pFrame)
+        {
+            fprintf(stderr, "ERROR: avcodec_alloc_frame failed to allocate memory "
+                            "for a new AVFrame object in fw_y4m_open\n");
+            goto error3;
+        }
+
+        /*The planes follow each other in the mapping*/
+        pFrame->format      = pix_fmt;
+        pFrame->width       = width;
+        pFrame->height      = height;
+        /*the video preprocessor numbers the frames*/
+        pFrame->pts         = AV_NOPTS_VALUE;
+        pFrame->data[0]     = pY4m->pMap + offset;
+        pFrame->linesize[0] = width;
+        if(AV_PIX_FMT_GRAY8 != pix_fmt)
+        {
+            pFrame->data[1]     = pFrame->data[0] + (size_t)width*height;
+            pFrame->data[2]     = pFrame->data[1] + (size_t)chroma_width*chroma_height;
+            pFrame->linesize[1] = chroma_width;
+            pFrame->linesize[2] = chroma_width;
+        }
+
+        pFrameArray[frm_i++] = pFrame;
+        offset += frame_size;
+    }
+
+    /*A codec context describes the frames to the encoder, like the one of a
+    decoder*/
+    pCodecCtx = avcodec_alloc_context3(NULL);
+    if(NULL == pCodecCtx)
+    {
+        fprintf(stderr, "ERROR: avcodec_alloc_context3 failed to allocate memory"
+                        "for a codec context in fw_y4m_open\n");
+        goto error3;
+    }
+    pCodecCtx->codec_type   = AVMEDIA_TYPE_VIDEO;
+    pCodecCtx->width        = width;
+    pCodecCtx->height       = height;
+    pCodecCtx->pix_fmt      = pix_fmt;
+    pCodecCtx->time_base.num= framerate.den;
+    pCodecCtx->time_base.den= framerate.num;
+
+    pY4m->pCodecCtx         = pCodecCtx;
+    pY4m->pFrameArray       = pFrameArray;
+    pY4m->frames_available  = frm_i;
+
+    return 0;
+
+error3:
+    while(frm_i > 0)
+    {
+        frm_i--;
+        avcodec_free_frame(&(pFrameArray[frm_i]));
+    }
+    free(pFrameArray);
+error2:
+    munmap(pY4m->pMap, pY4m->map_size);
+    memset(pY4m, 0, sizeof(fw_y4m_t));
+    return -1;
+error1:
+    close(fd);
+error0:
+    return -1;
+}
+
+/*
+    Free the frames (their data is in the mapping) and unmap the file
+*/
+void fw_y4m_close(fw_y4m_t *pY4m)
+{
+    uint64_t frm_i;
+
+    for(frm_i = 0; frm_i < pY4m->frames_available; frm_i++)
+    {
+        avcodec_free_frame(&(pY4m->pFrameArray[frm_i]));
+    }
+    free(pY4m->pFrameArray);
+
+    av_free(pY4m->pCodecCtx);
+
+    if(NULL != pY4m->pMap)
+    {
+        munmap(pY4m->pMap, pY4m->map_size);
+    }
+
+    memset(pY4m, 0, sizeof(fw_y4m_t));
+}
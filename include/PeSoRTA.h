@@ -32,4 +32,14 @@
         - close any files
     */
 
+    int workload_set_quality(void *state, int level) __attribute__((weak));
+    /*
+        - optional, only workloads that can trade output quality for a lower job 
+          cost define it, check that it is not NULL before calling it
+        - set the quality level of the following jobs, 0 is full quality and 
+          higher levels are cheaper
+        - levels beyond the lowest quality of the workload are clamped to it
+        - returns the level in effect, or -1 on error
+    */
+
 #endif
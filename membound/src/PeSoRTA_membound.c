@@ -28,105 +28,34 @@ char *workload_name(void)
 "-j: number of jobs \n"\
 */
 static int PeSoRTA_membound_parse_config(   char    *configfile_name, 
+                                            PeSoRTA_config_t *config_p,
                                             char    **datafile_name_p,
                                             int32_t *graph_index_p,
                                             int64_t *loop_iterations_p,
                                             int32_t *job_count_p)
 {
     int ret;
-    FILE *configfile_p;
 
-	/*parsing variables*/
-    char *optstring = "d:g:i:j:";
-    int  opt;
-    char *optarg;
-
-    char * const default_filename = "./membound_input.dat";
-    char *datafile_name = default_filename;
-    int32_t graph_index = 0;
-    int64_t loop_iterations = 1000000;
-    int32_t job_count = 10000;
-
-    /*Open the config file*/
-    configfile_p = fopen(configfile_name, "r");
-    if(NULL == configfile_p)
+    PeSoRTA_config_schema_t schema[] =
     {
-        fprintf(stderr, "ERROR: PeSoRTA_membound_parse_config) fopen failed\n");
-        goto error0;
-    }
-
-    /*Parse the file, line by line*/
-    while(!feof(configfile_p))
+        {'d', PeSoRTA_CONFIG_STRING, datafile_name_p, "./membound_input.dat",
+                                                            0.0, 0.0, NULL},
+        {'g', PeSoRTA_CONFIG_INT32, graph_index_p, "0",    0.0, INT32_MAX, NULL},
+        {'i', PeSoRTA_CONFIG_INT64, loop_iterations_p, "1000000", 1.0, INT64_MAX, NULL},
+        {'j', PeSoRTA_CONFIG_INT32, job_count_p, "10000",  0.0, INT32_MAX, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
+
+    /*the data file name points into the loaded config file*/
+    ret = PeSoRTA_config_load(configfile_name, schema, config_p);
+    if(ret < 0)
     {
-        ret = PeSoRTA_getconfigopt(configfile_p, optstring, &opt, &optarg);
-        if(ret == -1)
-        {
-            if(!feof(configfile_p))
-            {
-                fprintf(stderr, "ERROR: PeSoRTA_membound_parse_config) "
-                                "PeSoRTA_getconfigopt failed\n");
-                goto error1;
-            }
-            else
-            {
-                continue;
-            }
-        }
-        
-        if(opt == -1)
-        {
-                fprintf(stderr, "ERROR: PeSoRTA_membound_parse_config) config file "
-                                "contains bad line:\n\t\"%s\"\n", optarg);
-                free(optarg);
-                goto error1;
-        }
+        fprintf(stderr, "ERROR: PeSoRTA_membound_parse_config) PeSoRTA_config_load "
+                        "failed\n");
+        return -1;
+    }
 
-        if(optarg == NULL)
-        {
-            fprintf(stderr, "ERROR: PeSoRTA_membound_parse_config) config file contains "
-                            "valid option (%c) without argument!\n", (int)opt);
-            ret = -1;
-            goto error1;
-        }
-    
-        switch(opt)
-        {
-            case 'd':
-                datafile_name = optarg;
-                break;
-            case 'g':
-                graph_index = (int32_t)strtol(optarg, NULL, 0);
-                free(optarg);
-                break;
-            case 'i':
-                loop_iterations = (int64_t)strtoll(optarg, NULL, 0);
-                free(optarg);
-                break;
-            case 'j':
-                job_count = (int32_t)strtol(optarg, NULL, 0);
-                free(optarg);
-                break;
-        }/*switch(opt)*/
-    }/*while(!feof(configfile_p))*/    
-    
-    /*Set the output variables*/
-    *datafile_name_p = datafile_name;
-    *graph_index_p = graph_index;
-    *loop_iterations_p = loop_iterations;
-    *job_count_p = job_count;
-    
-    fclose(configfile_p);
-    
     return 0;
-    
-error1:
-    if(default_filename != datafile_name)
-    {
-        free(datafile_name);
-    }
-    fclose(configfile_p);
-error0:
-    return -1;
 }
 
 /*
@@ -143,6 +72,7 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
     int32_t graph_index;
     int64_t loop_iterations;
     int32_t job_count;
+    PeSoRTA_config_t config = {NULL, 0};
     
     PeSoRTA_membound_t *workload_state = NULL;
     
@@ -160,6 +90,7 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
     if(NULL != configfile)
     {
         ret = PeSoRTA_membound_parse_config(configfile,
+                                            &config,
                                             &datafile_name,
                                             &graph_index,
                                             &loop_iterations,
@@ -191,13 +122,13 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
     *state_p = workload_state;
     *job_count_p = job_count;
     
-    /*Free temporarily allocated memory*/
-    free(datafile_name);
+    /*Free the config file, which holds the data file name*/
+    PeSoRTA_config_unload(&config);
     
     return 0;
 
 error2:
-    free(datafile_name);
+    PeSoRTA_config_unload(&config);
 error1:
     free(workload_state);
 error0:
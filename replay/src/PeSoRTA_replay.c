@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <float.h>
+#include "PeSoRTA.h"
+#include "PeSoRTA_helper.h"
+
+#include "loadgen_calib.h"
+
+typedef struct PeSoRTA_replay_s
+{
+    /*recorded job times, converted to microseconds at initialization*/
+    double  *trace;
+    int32_t trace_length;
+    char    *trace_name;
+
+    /*conversion of the recorded values*/
+    double  unit_us;
+    double  scale;
+    /*number of trace entries the position advances by per job*/
+    double  warp;
+    double  position;
+
+    int32_t work_func_state;
+    /*job kernel of the load generator and its calibration*/
+    loadgen_kernel_t kernel;
+    int32_t kernel_type;
+    size_t  walk_kb;
+    loadgen_calib_t calib;
+    char    *calib_cache_name;
+    double  calib_tolerance;
+	//variables for the scheduler
+	long    jobs_remaining;
+    /*the loaded config file, which holds the option strings*/
+    PeSoRTA_config_t config;
+} PeSoRTA_replay_t;
+
+/*
+    - a simple function that returns the name and any description of the workload as a static string
+*/
+char *workload_name(void)
+{
+    return "replay";
+}
+
+static int PeSoRTA_replay_parse_unit(char *unit, void *dest)
+{
+    double *unit_us_p = (double*)dest;
+
+    if(0 == strcmp(unit, "ns"))
+    {
+        *unit_us_p = 0.001;
+    }
+    else if(0 == strcmp(unit, "us"))
+    {
+        *unit_us_p = 1.0;
+    }
+    else if(0 == strcmp(unit, "ms"))
+    {
+        *unit_us_p = 1000.0;
+    }
+    else if(0 == strcmp(unit, "s"))
+    {
+        *unit_us_p = 1000000.0;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int PeSoRTA_replay_parse_kernel(char *optarg, void *dest)
+{
+    return loadgen_kernel_parse(optarg, (int32_t*)dest);
+}
+
+/*
+"-T: trace file, one job time per line (file name).\n"\
+"-u: unit of the recorded job times (ns, us, ms or s, default ns).\n"\
+"-S: scale factor applied to every recorded job time (positive number).\n"\
+"-W: time warp, number of trace entries to advance per job (positive number).\n"\
+"-o: initial trace index (positive number of entries).\n"\
+"-j: number of jobs, the trace wraps around (positive integer, default: one pass).\n"\
+"-k: job kernel (lcg, fma, walk, branchy or mix, default lcg).\n"\
+"-w: size of the array of the walk kernel (kB).\n"\
+"-c: calibration cache file (file name).\n"\
+"-t: tolerance of the online iteration-count correction (fraction, 0 disables).\n"\
+*/
+static int PeSoRTA_replay_parse_config(char *configfile_name, PeSoRTA_replay_t *workload_state)
+{
+    int ret = 0;
+
+    /*a negative number of jobs derives the number of jobs from the trace length*/
+    PeSoRTA_config_schema_t schema[] =
+    {
+        {'T', PeSoRTA_CONFIG_STRING, &(workload_state->trace_name), NULL,
+                                                    0.0, 0.0, NULL},
+        {'u', PeSoRTA_CONFIG_CALLBACK, &(workload_state->unit_us), "ns",
+                                                    0.0, 0.0, PeSoRTA_replay_parse_unit},
+        {'S', PeSoRTA_CONFIG_DOUBLE, &(workload_state->scale), "1",
+                                                    DBL_MIN, HUGE_VAL, NULL},
+        {'W', PeSoRTA_CONFIG_DOUBLE, &(workload_state->warp), "1",
+                                                    DBL_MIN, HUGE_VAL, NULL},
+        {'o', PeSoRTA_CONFIG_DOUBLE, &(workload_state->position), "0",
+                                                    0.0, HUGE_VAL, NULL},
+        {'j', PeSoRTA_CONFIG_INT64, &(workload_state->jobs_remaining), "-1",
+                                                    0.0, 0.0, NULL},
+        {'k', PeSoRTA_CONFIG_CALLBACK, &(workload_state->kernel_type), "lcg",
+                                                    0.0, 0.0, PeSoRTA_replay_parse_kernel},
+        {'w', PeSoRTA_CONFIG_INT64, &(workload_state->walk_kb), NULL,
+                                                    1.0, INT64_MAX, NULL},
+        {'c', PeSoRTA_CONFIG_STRING, &(workload_state->calib_cache_name), NULL,
+                                                    0.0, 0.0, NULL},
+        {'t', PeSoRTA_CONFIG_DOUBLE, &(workload_state->calib_tolerance), "0",
+                                                    0.0, HUGE_VAL, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
+
+    /*Initialize the options without a default in the schema*/
+    workload_state->trace_name = NULL;
+    workload_state->walk_kb = LOADGEN_WALK_DEFAULT_KB;
+    workload_state->calib_cache_name = NULL;
+
+    ret = PeSoRTA_config_load(configfile_name, schema, &(workload_state->config));
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_replay_parse_config) PeSoRTA_config_load "
+                        "failed\n");
+        goto error0;
+    }
+
+    if(NULL == workload_state->trace_name)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_replay_parse_config) config file does not "
+                        "contain a trace file (T option)\n");
+        goto error1;
+    }
+
+    return 0;
+
+error1:
+    PeSoRTA_config_unload(&(workload_state->config));
+error0:
+    return -1;
+}
+
+/*
+    Read the trace and convert every recorded job time to microseconds, so that
+    perform_job only has to look up the next value.
+*/
+static int PeSoRTA_replay_load_trace(PeSoRTA_replay_t *workload_state)
+{
+    int ret;
+    int32_t i;
+    double  job_length;
+
+    ret = PeSoRTA_vector_readCSVF(  workload_state->trace_name,
+                                    &(workload_state->trace_length),
+                                    &(workload_state->trace));
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_replay_load_trace) PeSoRTA_vector_readCSVF "
+                        "failed to read \"%s\"\n", workload_state->trace_name);
+        return -1;
+    }
+
+    if(workload_state->trace_length <= 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_replay_load_trace) trace \"%s\" is empty\n",
+                        workload_state->trace_name);
+        return -1;
+    }
+
+    for(i = 0; i < workload_state->trace_length; i++)
+    {
+        job_length = workload_state->trace[i]
+                        * workload_state->unit_us * workload_state->scale;
+        /*lines that could not be parsed are read as 0*/
+        workload_state->trace[i] = (isfinite(job_length) && (job_length > 0.0))?
+                                        job_length : 0.0;
+    }
+
+    workload_state->position = fmod(workload_state->position,
+                                     (double)workload_state->trace_length);
+
+    /*by default the trace is replayed once*/
+    if(workload_state->jobs_remaining < 0)
+    {
+        workload_state->jobs_remaining
+            = (long)ceil(((double)workload_state->trace_length
+                            - workload_state->position) / workload_state->warp);
+    }
+
+    return 0;
+}
+
+/*
+    allocate space for the relevant data structures
+    read the config file to determine the trace and its conversion
+    load the trace and callibrate the load generator
+*/
+int workload_init(char *configfile, void **state_p, long *job_count_p)
+{
+    int ret = 0;
+
+    PeSoRTA_replay_t *workload_state;
+
+    /*allocate space for the workload state*/
+    workload_state = calloc(1, sizeof(PeSoRTA_replay_t));
+    if(NULL == workload_state)
+    {
+        fprintf(stderr, "ERROR: (replay) workload_init) malloc failed to allocate "
+                        "space for the workload state");
+        perror("");
+        ret = -1;
+        goto error0;
+    }
+
+    *state_p = workload_state;
+
+    /*read the config file*/
+    ret = PeSoRTA_replay_parse_config(configfile, workload_state);
+    if(ret == -1)
+    {
+        fprintf(stderr, "ERROR: (replay) workload_init) PeSoRTA_replay_parse_config "
+                        "failed\n");
+        ret = -1;
+        goto error0;
+    }
+
+    ret = PeSoRTA_replay_load_trace(workload_state);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (replay) workload_init) PeSoRTA_replay_load_trace "
+                        "failed\n");
+        ret = -1;
+        goto error0;
+    }
+
+    ret = loadgen_kernel_init(  &(workload_state->kernel),
+                                workload_state->kernel_type,
+                                workload_state->walk_kb);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (replay) workload_init) loadgen_kernel_init "
+                        "failed\n");
+        ret = -1;
+        goto error0;
+    }
+
+    ret = loadgen_calib_init(   &(workload_state->calib),
+                                &(workload_state->kernel),
+                                workload_state->calib_cache_name,
+                                workload_state->calib_tolerance);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (replay) workload_init) loadgen_calib_init "
+                        "failed\n");
+        ret = -1;
+        goto error0;
+    }
+
+    /*set return values*/
+    *job_count_p = workload_state->jobs_remaining;
+
+error0:
+    return ret;
+}
+
+/*
+    Replay the next recorded job as a calibrated busy loop of the same length
+*/
+int perform_job(void *state)
+{
+    int ret = 0;
+
+    PeSoRTA_replay_t *workload_state = (PeSoRTA_replay_t*)state;
+    double job_length;
+
+    /*If there are no more jobs left, just return 1*/
+    if(workload_state->jobs_remaining <= 0)
+    {
+        return 1;
+    }
+
+    /*job length in microseconds*/
+    job_length = workload_state->trace[(int32_t)workload_state->position];
+
+    workload_state->work_func_state
+        = loadgen_calib_run(&(workload_state->calib),
+            job_length,
+            workload_state->work_func_state);
+
+    /*advance, wrapping around at the end of the trace*/
+    workload_state->position += workload_state->warp;
+    while(workload_state->position >= (double)workload_state->trace_length)
+    {
+        workload_state->position -= (double)workload_state->trace_length;
+    }
+
+    (workload_state->jobs_remaining)--;
+    /*Set ret to 1 if there are no more jobs left*/
+    ret = (workload_state->jobs_remaining <= 0);
+    return ret;
+}
+
+int workload_uninit(void *state)
+{
+    PeSoRTA_replay_t *workload_state = (PeSoRTA_replay_t*)state;
+
+    if(NULL != workload_state)
+    {
+        loadgen_calib_free(&(workload_state->calib));
+        loadgen_kernel_free(&(workload_state->kernel));
+        if(NULL != workload_state->trace)
+        {
+            free(workload_state->trace);
+        }
+        PeSoRTA_config_unload(&(workload_state->config));
+        free(workload_state);
+    }
+
+    return 0;
+}
@@ -1,19 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
+#include <math.h>
+#include <float.h>
 #include "PeSoRTA.h"
 #include "PeSoRTA_helper.h"
 
-#include "loadgen.h"
+#include "loadgen_calib.h"
 #include "sqrwav.h"
 
 typedef struct PeSoRTA_sqrwav_s
 {
     struct sqrwav_struct sqrwav;
     int32_t  work_func_state;
+    /*job kernel of the load generator and its calibration*/
+    loadgen_kernel_t kernel;
+    int32_t kernel_type;
+    size_t  walk_kb;
+    loadgen_calib_t calib;
+    char    *calib_cache_name;
+    double  calib_tolerance;
 	//variables for the scheduler
 	unsigned long jobs_remaining;
+    /*the loaded config file, which holds the option strings*/
+    PeSoRTA_config_t config;
 } PeSoRTA_sqrwav_t;
 
 /*
@@ -24,6 +36,152 @@ char *workload_name(void)
     return "sqrwav";
 }
 
+static int PeSoRTA_sqrwav_parse_shape(char *name, void *dest)
+{
+    int32_t *shape_p = (int32_t*)dest;
+
+    if(0 == strcmp(name, "square"))
+    {
+        *shape_p = SQRWAV_SHAPE_SQUARE;
+    }
+    else if(0 == strcmp(name, "levels"))
+    {
+        *shape_p = SQRWAV_SHAPE_LEVELS;
+    }
+    else if(0 == strcmp(name, "markov"))
+    {
+        *shape_p = SQRWAV_SHAPE_MARKOV;
+    }
+    else if(0 == strcmp(name, "sine"))
+    {
+        *shape_p = SQRWAV_SHAPE_SINE;
+    }
+    else if(0 == strcmp(name, "sawtooth"))
+    {
+        *shape_p = SQRWAV_SHAPE_SAWTOOTH;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int PeSoRTA_sqrwav_parse_noise(char *name, void *dest)
+{
+    int32_t *noise_type_p = (int32_t*)dest;
+
+    if(0 == strcmp(name, "uniform"))
+    {
+        *noise_type_p = SQRWAV_NOISE_UNIFORM;
+    }
+    else if(0 == strcmp(name, "pareto"))
+    {
+        *noise_type_p = SQRWAV_NOISE_PARETO;
+    }
+    else if(0 == strcmp(name, "lognormal"))
+    {
+        *noise_type_p = SQRWAV_NOISE_LOGNORMAL;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    "<length in jobs> <computation time in ms>"
+*/
+static int PeSoRTA_sqrwav_parse_level(char *optarg, void *dest)
+{
+    struct sqrwav_struct *sqrwav_p = (struct sqrwav_struct*)dest;
+    char    *endptr;
+    uint64_t length;
+    double  value_ms;
+
+    errno = 0;
+    length = (uint64_t)strtoul(optarg, &endptr, 10);
+    if(errno || (endptr == optarg))
+    {
+        return -1;
+    }
+
+    optarg = endptr;
+    value_ms = strtod(optarg, &endptr);
+    if(errno || (endptr == optarg) || (value_ms < 0.0))
+    {
+        return -1;
+    }
+
+    return sqrwav_add_level(sqrwav_p, length, (uint64_t)(1000.0 * value_ms));
+}
+
+/*
+    whitespace or comma separated list of transition weights
+*/
+static int PeSoRTA_sqrwav_parse_transitions(char *optarg, void *dest)
+{
+    struct sqrwav_struct *sqrwav_p = (struct sqrwav_struct*)dest;
+    char    *endptr;
+    double  row[SQRWAV_MAX_LEVELS];
+    int32_t row_length = 0;
+
+    while(1)
+    {
+        while((' ' == *optarg) || ('\t' == *optarg) || (',' == *optarg))
+        {
+            optarg++;
+        }
+        if('\0' == *optarg)
+        {
+            break;
+        }
+
+        if(row_length >= SQRWAV_MAX_LEVELS)
+        {
+            return -1;
+        }
+
+        errno = 0;
+        row[row_length] = strtod(optarg, &endptr);
+        if(errno || (endptr == optarg))
+        {
+            return -1;
+        }
+        optarg = endptr;
+        row_length++;
+    }
+
+    return sqrwav_add_transition_row(sqrwav_p, row, row_length);
+}
+
+/*
+    nominal value in ms, stored in microseconds
+*/
+static int PeSoRTA_sqrwav_parse_ms(char *optarg, void *dest)
+{
+    char    *endptr;
+    double  value_ms;
+
+    errno = 0;
+    value_ms = strtod(optarg, &endptr);
+    if(errno || (endptr == optarg) || ('\0' != *endptr) || (value_ms < 0.0))
+    {
+        return -1;
+    }
+
+    *((uint64_t*)dest) = (uint64_t)(1000.0 * value_ms);
+    return 0;
+}
+
+static int PeSoRTA_sqrwav_parse_kernel(char *optarg, void *dest)
+{
+    return loadgen_kernel_parse(optarg, (int32_t*)dest);
+}
+
 /*
 "-j: number of jobs, (positive integer)\n"\
 "-P: period of sqare-wave (number of jobs)\n"\
@@ -32,186 +190,101 @@ char *workload_name(void)
 "-M: Maximum nominal value (computation time in ms).\n"\
 "-m: minimum nominal value (computation time in ms).\n"\
 "-N: noise ratio (fraction of the nominal value).\n"\
+"-S: shape (square, levels, markov, sine or sawtooth, default square).\n"\
+"-L: add a level: \"<length in jobs> <computation time in ms>\" (levels and markov).\n"\
+"    For the markov shape, the length is the minimum dwell time in the mode.\n"\
+"-T: add the next row of the markov transition matrix (list of weights).\n"\
+"-n: noise distribution (uniform, pareto or lognormal, default uniform).\n"\
+"-a: noise shape parameter (pareto: tail index, lognormal: sigma).\n"\
+"-k: job kernel (lcg, fma, walk, branchy or mix, default lcg).\n"\
+"-w: size of the array of the walk kernel (kB).\n"\
+"-c: calibration cache file (file name).\n"\
+"-t: tolerance of the online iteration-count correction (fraction, 0 disables).\n"\
 */
 static int PeSoRTA_sqrwav_parse_config(char *configfile_name, PeSoRTA_sqrwav_t *workload_state)
 {
     int ret = 0;
-    FILE *configfile_p;
+    char   *problem;
+    struct sqrwav_struct *sqrwav_p = &(workload_state->sqrwav);
 
-	//parsing variables
-    char *optstring = "j:P:D:d:M:m:N:";
-    int  opt;
-    char *optarg;
-    
-    double temp_d;
-    
-    /*Initialize workload_state->p*/
-    workload_state->jobs_remaining = 10000; 
-    
-    workload_state->sqrwav.period = 10000;
-    workload_state->sqrwav.duty_cycle = 0.5;
-    workload_state->sqrwav.minimum_nominal_value = (uint64_t)(1*ipms);
-    workload_state->sqrwav.maximum_nominal_value = (uint64_t)(5*ipms);
-    workload_state->sqrwav.noise_ratio = 0.2;
-    workload_state->sqrwav.index = 0;
-    workload_state->sqrwav.rangen_state = 0;
-    
-    /*Open the config file*/
-    configfile_p = fopen(configfile_name, "r");
-    if(NULL == configfile_p)
+    /*the nominal values are kept in microseconds and converted to iterations per 
+    job, a noise parameter of 0 selects the default of the noise distribution*/
+    PeSoRTA_config_schema_t schema[] =
     {
-        fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) fopen failed to open file "
-                        "\"%s\" :", configfile_name);
-        perror("");
-        ret = -1;
+        {'j', PeSoRTA_CONFIG_INT64, &(workload_state->jobs_remaining), "10000",
+                                                    0.0, INT64_MAX, NULL},
+        {'P', PeSoRTA_CONFIG_INT64, &(sqrwav_p->period), "10000",
+                                                    1.0, INT64_MAX, NULL},
+        {'D', PeSoRTA_CONFIG_DOUBLE, &(sqrwav_p->duty_cycle), "0.5", 0.0, 1.0, NULL},
+        {'d', PeSoRTA_CONFIG_INT64, &(sqrwav_p->index), "0", 0.0, INT64_MAX, NULL},
+        {'M', PeSoRTA_CONFIG_CALLBACK, &(sqrwav_p->maximum_nominal_value), "5",
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_ms},
+        {'m', PeSoRTA_CONFIG_CALLBACK, &(sqrwav_p->minimum_nominal_value), "1",
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_ms},
+        {'N', PeSoRTA_CONFIG_DOUBLE, &(sqrwav_p->noise_ratio), "0.2",
+                                                    0.0, HUGE_VAL, NULL},
+        {'S', PeSoRTA_CONFIG_CALLBACK, &(sqrwav_p->shape), "square",
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_shape},
+        {'L', PeSoRTA_CONFIG_CALLBACK, sqrwav_p, NULL,
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_level},
+        {'T', PeSoRTA_CONFIG_CALLBACK, sqrwav_p, NULL,
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_transitions},
+        {'n', PeSoRTA_CONFIG_CALLBACK, &(sqrwav_p->noise_type), "uniform",
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_noise},
+        {'a', PeSoRTA_CONFIG_DOUBLE, &(sqrwav_p->noise_param), NULL,
+                                                    DBL_MIN, HUGE_VAL, NULL},
+        {'k', PeSoRTA_CONFIG_CALLBACK, &(workload_state->kernel_type), "lcg",
+                                                    0.0, 0.0, PeSoRTA_sqrwav_parse_kernel},
+        {'w', PeSoRTA_CONFIG_INT64, &(workload_state->walk_kb), NULL,
+                                                    1.0, INT64_MAX, NULL},
+        {'c', PeSoRTA_CONFIG_STRING, &(workload_state->calib_cache_name), NULL,
+                                                    0.0, 0.0, NULL},
+        {'t', PeSoRTA_CONFIG_DOUBLE, &(workload_state->calib_tolerance), "0",
+                                                    0.0, HUGE_VAL, NULL},
+        PeSoRTA_CONFIG_SCHEMA_END
+    };
+
+    /*Initialize the options without a default in the schema*/
+    sqrwav_p->rangen_state = 0;
+    sqrwav_p->level_count = 0;
+    sqrwav_p->transition_rows = 0;
+    sqrwav_p->mode = 0;
+    sqrwav_p->noise_param = 0.0;
+
+    workload_state->walk_kb = LOADGEN_WALK_DEFAULT_KB;
+    workload_state->calib_cache_name = NULL;
+
+    ret = PeSoRTA_config_load(configfile_name, schema, &(workload_state->config));
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) PeSoRTA_config_load "
+                        "failed\n");
         goto error0;
     }
 
-    /*Parse the file, line by line*/
-    while(!feof(configfile_p))
+    if(0.0 == workload_state->sqrwav.noise_param)
     {
-        ret = PeSoRTA_getconfigopt(configfile_p, optstring, &opt, &optarg);
-        if(ret == -1)
-        {
-            if(!feof(configfile_p))
-            {
-                fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) "
-                                "PeSoRTA_getconfigopt failed\n");
-                goto error1;
-            }
-            else
-            {
-                ret = 0;
-                continue;
-            }
-        }
-        
-        if(opt == -1)
-        {
-                fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) config file "
-                                "contains bad line:\n\t\"%s\"\n", optarg);                
-                ret = -1;
-                free(optarg);
-                goto error1;
-        }
+        workload_state->sqrwav.noise_param 
+            = (SQRWAV_NOISE_LOGNORMAL == workload_state->sqrwav.noise_type)? 
+                0.5 : 2.5;
+    }
 
-        if(optarg == NULL)
-        {
-            fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) config file contains "
-                            "valid option (%c) without argument!\n", (int)opt);
-            ret = -1;
-            goto error1;
-        }
-        
-        switch(opt)
-        {
-            case 'j':
-				errno = 0;
-				workload_state->jobs_remaining = strtoul(optarg, NULL, 10);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to "
-					                "parse the j option\n");
-					ret = -1;
-			        free(optarg);
-					goto error1;
-				}
-				break;
-
-            case 'P':
-                errno = 0;
-                workload_state->sqrwav.period 
-                    = (uint64_t)strtoul(optarg, NULL, 10);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to parse " 
-					                "the P option\n");
-					ret = -1;
-			        free(optarg);
-					goto error1;
-				}
-                break;
-
-            case 'D':
-                errno = 0;
-                workload_state->sqrwav.duty_cycle 
-                    = (double)strtod(optarg, NULL);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to parse "
-					                "the D option\n");
-					ret = -1;
-			        free(optarg);
-					goto error1;
-				}
-                break;
-
-            case 'd':
-                errno = 0;
-                workload_state->sqrwav.index 
-                    = (uint64_t)strtoul(optarg, NULL, 10);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to parse "
-					                "the d option\n");
-					ret = -1;
-			        free(optarg);
-					goto error1;
-				}
-                break;
-
-            case 'M':
-                errno = 0;
-                temp_d = (double)strtod(optarg, NULL);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to "
-					                "parse the M option\n");
-					ret = -1;
-                    free(optarg);
-					goto error1;
-				}
-                workload_state->sqrwav.maximum_nominal_value 
-                    = (uint64_t)(ipms * temp_d);
-                break;
-
-            case 'm':
-                errno = 0;
-                temp_d = (double)strtod(optarg, NULL);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to "
-					                "parse the m option\n");
-					ret = -1;
-    		        free(optarg);
-					goto error1;
-				}
-                workload_state->sqrwav.minimum_nominal_value
-                    = (uint64_t)(ipms * temp_d);
-                break;
-
-            case 'N':
-                errno = 0;
-                workload_state->sqrwav.noise_ratio 
-                    = (double)strtod(optarg, NULL);
-				if(errno)
-				{
-                    fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) Failed to "
-					                "parse the N option\n");
-					ret = -1;
-                    free(optarg);
-					goto error1;
-				}
-                break;
-        }
-        
-        free(optarg);
-    };
+    ret = sqrwav_check(&(workload_state->sqrwav), &problem);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: PeSoRTA_sqrwav_parse_config) inconsistent "
+                        "parameters: %s\n", problem);
+        goto error1;
+    }
+
+    /*the markov shape starts with the full dwell time of the first mode*/
+    workload_state->sqrwav.dwell_remaining = workload_state->sqrwav.level_length[0];
+    return 0;
 
 error1:
-    fclose(configfile_p);
+    PeSoRTA_config_unload(&(workload_state->config));
 error0:
-    return ret;
+    return -1;
 }
 
 /*
@@ -226,14 +299,8 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
     
     PeSoRTA_sqrwav_t *workload_state;
 
-    /*callibrate the load generator*/
-    /*warmup run*/
-    callibrate(3000);
-    /*callibration run*/
-    callibrate(30000000);
-        
     /*allocate space for the workload state*/
-    workload_state = malloc(sizeof(PeSoRTA_sqrwav_t));
+    workload_state = calloc(1, sizeof(PeSoRTA_sqrwav_t));
     if(NULL == workload_state)
     {
         fprintf(stderr, "ERROR: (sqrwav) workload_init) malloc failed to allocate "
@@ -256,6 +323,31 @@ int workload_init(char *configfile, void **state_p, long *job_count_p)
         ret = -1;
         goto error0;   
     }
+
+    /*callibrate the load generator on every cpu, after the config file has been 
+    parsed so that the calibration cache can be used*/
+    ret = loadgen_kernel_init(  &(workload_state->kernel),
+                                workload_state->kernel_type,
+                                workload_state->walk_kb);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (sqrwav) workload_init) loadgen_kernel_init "
+                        "failed\n");
+        ret = -1;
+        goto error0;
+    }
+
+    ret = loadgen_calib_init(   &(workload_state->calib),
+                                &(workload_state->kernel),
+                                workload_state->calib_cache_name,
+                                workload_state->calib_tolerance);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (sqrwav) workload_init) loadgen_calib_init "
+                        "failed\n");
+        ret = -1;
+        goto error0;
+    }
     
     /*set return values*/
     *state_p = workload_state;
@@ -288,10 +380,12 @@ int perform_job(void *state)
     }
 //fprintf(stderr, "actually doing some work!\n");
 
+    /*job length in microseconds*/
     job_length = sqrwav_next(sqrwav_p);
 
     workload_state->work_func_state
-        = work_function(job_length, 
+        = loadgen_calib_run(&(workload_state->calib),
+            (double)job_length,
             workload_state->work_func_state);
     
     workload_state->work_func_state = work_func_state;
@@ -308,6 +402,9 @@ int workload_uninit(void *state)
     
     if(NULL != workload_state)
     {
+        loadgen_calib_free(&(workload_state->calib));
+        loadgen_kernel_free(&(workload_state->kernel));
+        PeSoRTA_config_unload(&(workload_state->config));
         free(workload_state);
     }
     
@@ -31,7 +31,7 @@ static int32_t work_function(long count, int32_t workfunc_state)
     work_function(iterations);\
 }
 
-static long callibrate(long count)
+static inline long callibrate(long count)
 {
     int ret;
     struct timespec start_ts, stop_ts;
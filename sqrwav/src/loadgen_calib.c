@@ -0,0 +1,719 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "loadgen_calib.h"
+
+#define LOADGEN_CALIB_FREQ_PATH "/sys/devices/system/cpu/cpu%i/cpufreq/scaling_cur_freq"
+
+/*iterations of the warmup and the callibration runs*/
+#define LOADGEN_CALIB_WARMUP_COUNT  (3000000)
+#define LOADGEN_CALIB_COUNT         (30000000)
+
+/*
+    Round a frequency to the nearest LOADGEN_CALIB_FREQ_BUCKET_KHZ
+*/
+static int64_t loadgen_calib_bucket(int64_t freq_khz)
+{
+    return ((freq_khz + (LOADGEN_CALIB_FREQ_BUCKET_KHZ / 2)) /
+                LOADGEN_CALIB_FREQ_BUCKET_KHZ) * LOADGEN_CALIB_FREQ_BUCKET_KHZ;
+}
+
+/*
+    Returns the current frequency bucket of the given CPU in kHz, or 0 if the
+    frequency can not be determined (no cpufreq support)
+*/
+static int64_t loadgen_calib_get_freq(int32_t cpu)
+{
+    int64_t ret = 0;
+    FILE *filep;
+    char path[128];
+    long long freq_khz;
+
+    snprintf(path, sizeof(path), LOADGEN_CALIB_FREQ_PATH, cpu);
+
+    filep = fopen(path, "r");
+    if(NULL == filep)
+    {
+        goto exit0;
+    }
+
+    if(1 == fscanf(filep, "%lli", &freq_khz))
+    {
+        ret = (int64_t)freq_khz;
+    }
+
+    fclose(filep);
+exit0:
+    return loadgen_calib_bucket(ret);
+}
+
+/*
+    Returns the frequency bucket read from an open scaling_cur_freq file, or 0.
+    Only the helper thread calls this.
+*/
+static int64_t loadgen_calib_read_freq(int fd)
+{
+    char buf[32];
+    ssize_t length;
+
+    length = pread(fd, buf, sizeof(buf) - 1, 0);
+    if(length <= 0)
+    {
+        return 0;
+    }
+    buf[length] = '\0';
+
+    return loadgen_calib_bucket((int64_t)strtoll(buf, NULL, 10));
+}
+
+/*
+    The helper thread, publishes the frequency bucket of every CPU that is
+    followed in cpu_freq_now
+*/
+static void* loadgen_calib_freq_thread(void *arg)
+{
+    loadgen_calib_t *calib_p = (loadgen_calib_t*)arg;
+    struct timespec period = {0, LOADGEN_CALIB_FREQ_PERIOD_NS};
+    int32_t cpu;
+    int64_t freq_khz;
+
+    while(0 == __atomic_load_n(&(calib_p->freq_stop), __ATOMIC_ACQUIRE))
+    {
+        for(cpu = 0; cpu < calib_p->cpu_count; cpu++)
+        {
+            if(calib_p->cpu_freq_fd[cpu] < 0)
+            {
+                continue;
+            }
+
+            freq_khz = loadgen_calib_read_freq(calib_p->cpu_freq_fd[cpu]);
+            if(freq_khz > 0)
+            {
+                __atomic_store_n(&(calib_p->cpu_freq_now[cpu]), freq_khz,
+                                 __ATOMIC_RELAXED);
+            }
+        }
+
+        nanosleep(&period, NULL);
+    }
+
+    return NULL;
+}
+
+/*
+    Open the scaling_cur_freq files of the calibrated CPUs and start the helper
+    thread. Without cpufreq support the calibrations at initialization are kept.
+*/
+static void loadgen_calib_start_freq_thread(loadgen_calib_t *calib_p)
+{
+    int ret;
+    int32_t cpu;
+    int32_t opened = 0;
+    char path[128];
+
+    for(cpu = 0; cpu < calib_p->cpu_count; cpu++)
+    {
+        calib_p->cpu_freq_now[cpu] = calib_p->cpu_freq_khz[cpu];
+        if(calib_p->cpu_ipms[cpu] <= 0.0)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), LOADGEN_CALIB_FREQ_PATH, cpu);
+        calib_p->cpu_freq_fd[cpu] = open(path, O_RDONLY);
+        opened += (calib_p->cpu_freq_fd[cpu] >= 0);
+    }
+
+    if(0 == opened)
+    {
+        return;
+    }
+
+    ret = pthread_create(&(calib_p->freq_thread), NULL, loadgen_calib_freq_thread,
+                         calib_p);
+    if(0 != ret)
+    {
+        fprintf(stderr, "WARNING: loadgen_calib_init) pthread_create failed to start "
+                        "the frequency thread (%s), the calibrations will not follow "
+                        "the frequency\n", strerror(ret));
+        return;
+    }
+    calib_p->freq_thread_running = 1;
+}
+
+/*
+    Returns the iterations per millisecond of the kernel, measured over count
+    iterations, or a negative value on error
+*/
+static double loadgen_calib_measure(loadgen_kernel_t *kernel_p, long count)
+{
+    int ret;
+    struct timespec start_ts, stop_ts;
+    double interval;
+
+    ret = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_ts);
+    if(ret == -1)
+    {
+        return -1.0;
+    }
+
+    loadgen_kernel_run(kernel_p, count, 0);
+
+    ret = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stop_ts);
+    if(ret == -1)
+    {
+        return -1.0;
+    }
+
+    interval = ((stop_ts.tv_sec - start_ts.tv_sec) * 1000000000.0) +
+               (stop_ts.tv_nsec - start_ts.tv_nsec);
+    if(interval <= 0.0)
+    {
+        return -1.0;
+    }
+
+    return (((double)count)/interval)*1000000.0;
+}
+
+/*
+    Returns the size of the array of the walk and mix kernels in kB (rounded
+    up), or 0 for the kernels without an array. The cost of an iteration
+    depends on the level of the memory hierarchy the array fits in.
+*/
+static int64_t loadgen_calib_walk_kb(loadgen_kernel_t *kernel_p)
+{
+    if(NULL == kernel_p->walk_array)
+    {
+        return 0;
+    }
+
+    return (int64_t)((kernel_p->walk_entries * sizeof(uint32_t) + 1023) / 1024);
+}
+
+static double loadgen_calib_lookup( loadgen_calib_t *calib_p,
+                                    int32_t         kernel,
+                                    int64_t         walk_kb,
+                                    int32_t         cpu,
+                                    int64_t         freq_khz)
+{
+    int32_t i;
+
+    for(i = 0; i < calib_p->entry_count; i++)
+    {
+        if( (calib_p->entries[i].kernel == kernel) &&
+            (calib_p->entries[i].walk_kb == walk_kb) &&
+            (calib_p->entries[i].cpu == cpu) &&
+            (calib_p->entries[i].freq_khz == freq_khz))
+        {
+            return calib_p->entries[i].ipms;
+        }
+    }
+
+    return -1.0;
+}
+
+static int loadgen_calib_add(   loadgen_calib_t *calib_p,
+                                int32_t         kernel,
+                                int64_t         walk_kb,
+                                int32_t         cpu,
+                                int64_t         freq_khz,
+                                double          ipms_value)
+{
+    loadgen_calib_entry_t *entries;
+
+    entries = realloc(  calib_p->entries,
+                        (calib_p->entry_count + 1) * sizeof(loadgen_calib_entry_t));
+    if(NULL == entries)
+    {
+        fprintf(stderr, "ERROR: loadgen_calib_add) realloc failed to allocate space "
+                        "for a new calibration entry\n");
+        return -1;
+    }
+
+    entries[calib_p->entry_count].kernel = kernel;
+    entries[calib_p->entry_count].walk_kb = walk_kb;
+    entries[calib_p->entry_count].cpu = cpu;
+    entries[calib_p->entry_count].freq_khz = freq_khz;
+    entries[calib_p->entry_count].ipms = ipms_value;
+
+    calib_p->entries = entries;
+    (calib_p->entry_count)++;
+
+    return 0;
+}
+
+/*
+    The cache file contains one line per entry:
+    "<kernel>[:<array size in kB>] <cpu> <frequency in kHz> <ipms>".
+    The walk and mix kernels carry the size of their array. Lines without the
+    kernel name (older cache files) are lcg entries, and walk or mix lines
+    without the size are skipped. Lines starting with '#' are ignored. A
+    missing cache file is not an error.
+*/
+static int loadgen_calib_load(loadgen_calib_t *calib_p, char *cache_filename)
+{
+    int ret = 0;
+    FILE *filep;
+
+    char    *line = NULL;
+    size_t  line_size = 0;
+
+    char    kernel_name[32];
+    char    *size_str;
+    int     fields;
+    int32_t kernel;
+    long long walk_kb;
+    int     cpu;
+    long long freq_khz;
+    double  ipms_value;
+
+    filep = fopen(cache_filename, "r");
+    if(NULL == filep)
+    {
+        if(ENOENT == errno)
+        {
+            goto exit0;
+        }
+
+        fprintf(stderr, "ERROR: loadgen_calib_load) fopen failed to open the cache "
+                        "file \"%s\" ", cache_filename);
+        perror("");
+        ret = -1;
+        goto exit0;
+    }
+
+    while(getline(&line, &line_size, filep) > 0)
+    {
+        if('#' == line[0])
+        {
+            continue;
+        }
+
+        walk_kb = 0;
+        fields = sscanf(line, "%31s %i %lli %lf", 
+                        kernel_name, &cpu, &freq_khz, &ipms_value);
+        if(4 == fields)
+        {
+            size_str = strchr(kernel_name, ':');
+            if(NULL != size_str)
+            {
+                *size_str = '\0';
+                walk_kb = strtoll(size_str + 1, NULL, 10);
+            }
+        }
+
+        if((4 == fields) && (0 == loadgen_kernel_parse(kernel_name, &kernel)))
+        {
+            /*current format, the walk and mix kernels need the size*/
+            if( ((LOADGEN_KERNEL_WALK == kernel) || (LOADGEN_KERNEL_MIX == kernel)) &&
+                (walk_kb <= 0))
+            {
+                continue;
+            }
+        }
+        else if(3 == sscanf(line, "%i %lli %lf", &cpu, &freq_khz, &ipms_value))
+        {
+            kernel = LOADGEN_KERNEL_LCG;
+            walk_kb = 0;
+        }
+        else
+        {
+            continue;
+        }
+
+        if(ipms_value <= 0.0)
+        {
+            continue;
+        }
+
+        /*entries of older cache files hold the exact frequency*/
+        freq_khz = loadgen_calib_bucket(freq_khz);
+        if(loadgen_calib_lookup(calib_p, kernel, walk_kb, cpu, freq_khz) > 0.0)
+        {
+            continue;
+        }
+
+        ret = loadgen_calib_add(calib_p, kernel, walk_kb, cpu, freq_khz, ipms_value);
+        if(ret < 0)
+        {
+            goto exit1;
+        }
+    }
+
+exit1:
+    free(line);
+    fclose(filep);
+exit0:
+    return ret;
+}
+
+static int loadgen_calib_save(loadgen_calib_t *calib_p, char *cache_filename)
+{
+    int ret = 0;
+    FILE *filep;
+    int32_t i;
+    char kernel_name[32];
+
+    filep = fopen(cache_filename, "w");
+    if(NULL == filep)
+    {
+        fprintf(stderr, "ERROR: loadgen_calib_save) fopen failed to open the cache "
+                        "file \"%s\" ", cache_filename);
+        perror("");
+        ret = -1;
+        goto exit0;
+    }
+
+    fprintf(filep, "# kernel[:walk_kb] cpu freq_khz ipms\n");
+    for(i = 0; i < calib_p->entry_count; i++)
+    {
+        if(calib_p->entries[i].walk_kb > 0)
+        {
+            snprintf(kernel_name, sizeof(kernel_name), "%s:%lli",
+                    loadgen_kernel_name(calib_p->entries[i].kernel),
+                    (long long)calib_p->entries[i].walk_kb);
+        }
+        else
+        {
+            snprintf(kernel_name, sizeof(kernel_name), "%s",
+                    loadgen_kernel_name(calib_p->entries[i].kernel));
+        }
+
+        ret = fprintf(  filep, "%s %i %lli %f\n",
+                        kernel_name,
+                        calib_p->entries[i].cpu,
+                        (long long)calib_p->entries[i].freq_khz,
+                        calib_p->entries[i].ipms);
+        if(ret < 0)
+        {
+            perror("ERROR: loadgen_calib_save) fprintf failed");
+            ret = -1;
+            goto exit1;
+        }
+    }
+    ret = 0;
+
+exit1:
+    fclose(filep);
+exit0:
+    return ret;
+}
+
+int loadgen_calib_init( loadgen_calib_t  *calib_p,
+                        loadgen_kernel_t *kernel_p,
+                        char             *cache_filename,
+                        double           tolerance)
+{
+    int ret;
+
+    int32_t cpu_count;
+    int32_t cpu;
+    int32_t calibrated_cpus = 0;
+    int     cache_dirty = 0;
+
+    cpu_set_t   original_mask;
+    cpu_set_t   cpu_mask;
+
+    int64_t freq_khz;
+    double  ipms_cpu;
+    double  ipms_sum = 0.0;
+
+    memset(calib_p, 0, sizeof(loadgen_calib_t));
+    calib_p->kernel = kernel_p;
+    calib_p->walk_kb = loadgen_calib_walk_kb(kernel_p);
+
+    cpu_count = (int32_t)sysconf(_SC_NPROCESSORS_CONF);
+    if(cpu_count <= 0)
+    {
+        cpu_count = 1;
+    }
+    cpu_count = (cpu_count > CPU_SETSIZE)? CPU_SETSIZE : cpu_count;
+
+    calib_p->cpu_ipms = (double*)malloc(cpu_count * sizeof(double));
+    if(NULL == calib_p->cpu_ipms)
+    {
+        fprintf(stderr, "ERROR: loadgen_calib_init) malloc failed to allocate the "
+                        "per-cpu calibration table\n");
+        goto error0;
+    }
+    calib_p->cpu_count = cpu_count;
+
+    calib_p->cpu_freq_khz = (int64_t*)calloc(cpu_count, sizeof(int64_t));
+    calib_p->cpu_freq_now = (int64_t*)calloc(cpu_count, sizeof(int64_t));
+    calib_p->cpu_freq_fd  = (int*)malloc(cpu_count * sizeof(int));
+    if( (NULL == calib_p->cpu_freq_khz) || (NULL == calib_p->cpu_freq_now) ||
+        (NULL == calib_p->cpu_freq_fd))
+    {
+        fprintf(stderr, "ERROR: loadgen_calib_init) failed to allocate the "
+                        "per-cpu frequency tables\n");
+        goto error1;
+    }
+    for(cpu = 0; cpu < cpu_count; cpu++)
+    {
+        calib_p->cpu_freq_fd[cpu] = -1;
+    }
+
+    /*Load previous measurements*/
+    if(NULL != cache_filename)
+    {
+        ret = loadgen_calib_load(calib_p, cache_filename);
+        if(ret < 0)
+        {
+            fprintf(stderr, "ERROR: loadgen_calib_init) loadgen_calib_load failed\n");
+            goto error1;
+        }
+    }
+
+    ret = sched_getaffinity(0, sizeof(cpu_set_t), &original_mask);
+    if(ret < 0)
+    {
+        perror("ERROR: loadgen_calib_init) sched_getaffinity failed");
+        goto error1;
+    }
+
+    /*Measure every cpu that the process may run on*/
+    for(cpu = 0; cpu < cpu_count; cpu++)
+    {
+        calib_p->cpu_ipms[cpu] = -1.0;
+
+        if(!CPU_ISSET(cpu, &original_mask))
+        {
+            continue;
+        }
+
+        CPU_ZERO(&cpu_mask);
+        CPU_SET(cpu, &cpu_mask);
+        ret = sched_setaffinity(0, sizeof(cpu_set_t), &cpu_mask);
+        if(ret < 0)
+        {
+            continue;
+        }
+
+        /*warmup run, which also gives the governor a chance to settle*/
+        loadgen_calib_measure(kernel_p, LOADGEN_CALIB_WARMUP_COUNT);
+        freq_khz = loadgen_calib_get_freq(cpu);
+
+        ipms_cpu = loadgen_calib_lookup(calib_p, kernel_p->type, calib_p->walk_kb,
+                                        cpu, freq_khz);
+        if(ipms_cpu <= 0.0)
+        {
+            /*callibration run*/
+            ipms_cpu = loadgen_calib_measure(kernel_p, LOADGEN_CALIB_COUNT);
+            if(ipms_cpu <= 0.0)
+            {
+                fprintf(stderr, "ERROR: loadgen_calib_init) callibration of the %s "
+                                "kernel failed on cpu %i\n", 
+                                loadgen_kernel_name(kernel_p->type), cpu);
+                goto error2;
+            }
+
+            ret = loadgen_calib_add(calib_p, kernel_p->type, calib_p->walk_kb,
+                                    cpu, freq_khz, ipms_cpu);
+            if(ret < 0)
+            {
+                goto error2;
+            }
+            cache_dirty = 1;
+        }
+
+        calib_p->cpu_ipms[cpu] = ipms_cpu;
+        calib_p->cpu_freq_khz[cpu] = freq_khz;
+        ipms_sum += ipms_cpu;
+        calibrated_cpus++;
+    }
+
+    ret = sched_setaffinity(0, sizeof(cpu_set_t), &original_mask);
+    if(ret < 0)
+    {
+        perror("ERROR: loadgen_calib_init) sched_setaffinity failed to restore the "
+               "original affinity mask");
+        goto error1;
+    }
+
+    if(0 == calibrated_cpus)
+    {
+        fprintf(stderr, "ERROR: loadgen_calib_init) failed to callibrate any cpu\n");
+        goto error1;
+    }
+    calib_p->default_ipms = ipms_sum / (double)calibrated_cpus;
+
+    /*Store the new measurements*/
+    if((NULL != cache_filename) && (0 != cache_dirty))
+    {
+        ret = loadgen_calib_save(calib_p, cache_filename);
+        if(ret < 0)
+        {
+            fprintf(stderr, "WARNING: loadgen_calib_init) failed to save the "
+                            "calibration cache \"%s\"\n", cache_filename);
+        }
+    }
+
+    calib_p->tolerance = tolerance;
+    calib_p->correction = 1.0;
+    calib_p->adjustments = 0;
+
+    loadgen_calib_start_freq_thread(calib_p);
+
+    return 0;
+
+error2:
+    sched_setaffinity(0, sizeof(cpu_set_t), &original_mask);
+error1:
+    free(calib_p->cpu_ipms);
+    free(calib_p->cpu_freq_khz);
+    free(calib_p->cpu_freq_now);
+    free(calib_p->cpu_freq_fd);
+    free(calib_p->entries);
+error0:
+    memset(calib_p, 0, sizeof(loadgen_calib_t));
+    return -1;
+}
+
+void loadgen_calib_free(loadgen_calib_t *calib_p)
+{
+    int32_t cpu;
+
+    if(0 != calib_p->freq_thread_running)
+    {
+        __atomic_store_n(&(calib_p->freq_stop), 1, __ATOMIC_RELEASE);
+        pthread_join(calib_p->freq_thread, NULL);
+    }
+    for(cpu = 0; (NULL != calib_p->cpu_freq_fd) && (cpu < calib_p->cpu_count); cpu++)
+    {
+        if(calib_p->cpu_freq_fd[cpu] >= 0)
+        {
+            close(calib_p->cpu_freq_fd[cpu]);
+        }
+    }
+
+    free(calib_p->cpu_ipms);
+    free(calib_p->cpu_freq_khz);
+    free(calib_p->cpu_freq_now);
+    free(calib_p->cpu_freq_fd);
+    free(calib_p->entries);
+    memset(calib_p, 0, sizeof(loadgen_calib_t));
+}
+
+/*
+    Switch to the calibration of the frequency bucket that the helper thread
+    last read for the cpu, if it changed and there is one. This only reads
+    memory, the job does no I/O.
+*/
+static void loadgen_calib_check_freq(loadgen_calib_t *calib_p, int32_t cpu)
+{
+    int64_t  freq_khz;
+    double   ipms_cpu;
+
+    freq_khz = __atomic_load_n(&(calib_p->cpu_freq_now[cpu]), __ATOMIC_RELAXED);
+    if((0 == freq_khz) || (freq_khz == calib_p->cpu_freq_khz[cpu]))
+    {
+        return;
+    }
+
+    /*Without a calibration for the new bucket, the last one is kept*/
+    calib_p->cpu_freq_khz[cpu] = freq_khz;
+    ipms_cpu = loadgen_calib_lookup(calib_p, calib_p->kernel->type, calib_p->walk_kb,
+                                    cpu, freq_khz);
+    if(ipms_cpu > 0.0)
+    {
+        calib_p->cpu_ipms[cpu] = ipms_cpu;
+        (calib_p->freq_switches)++;
+    }
+}
+
+/*
+    Convert a job length in microseconds to work_function iterations, using the
+    calibration of the cpu the caller is currently running on, at the frequency
+    it currently runs at
+*/
+long loadgen_calib_iterations(loadgen_calib_t *calib_p, double us)
+{
+    int cpu;
+    double ipms_cpu = calib_p->default_ipms;
+
+    cpu = sched_getcpu();
+    if( (cpu >= 0) && (cpu < calib_p->cpu_count) &&
+        (calib_p->cpu_ipms[cpu] > 0.0))
+    {
+        loadgen_calib_check_freq(calib_p, cpu);
+        ipms_cpu = calib_p->cpu_ipms[cpu];
+    }
+
+    return (long)(ipms_cpu * calib_p->correction * us / 1000.0);
+}
+
+/*
+    Adjust the correction factor if the measured length of the last job was not
+    within the tolerance of its target length
+*/
+void loadgen_calib_feedback(loadgen_calib_t *calib_p,
+                            double          target_us,
+                            double          measured_us)
+{
+    double error;
+    double correction;
+
+    if( (calib_p->tolerance <= 0.0) || (target_us <= 0.0) || (measured_us <= 0.0))
+    {
+        return;
+    }
+
+    error = (target_us / measured_us) - 1.0;
+    if((error < calib_p->tolerance) && (error > -(calib_p->tolerance)))
+    {
+        return;
+    }
+
+    correction = calib_p->correction * (1.0 + (LOADGEN_CALIB_GAIN * error));
+    correction = (correction < LOADGEN_CALIB_MIN_CORRECTION)?
+                    LOADGEN_CALIB_MIN_CORRECTION : correction;
+    correction = (correction > LOADGEN_CALIB_MAX_CORRECTION)?
+                    LOADGEN_CALIB_MAX_CORRECTION : correction;
+
+    calib_p->correction = correction;
+    (calib_p->adjustments)++;
+}
+
+/*
+    Run the kernel for the given number of microseconds. If the online 
+    correction is enabled, the thread cpu time of the run is measured and fed back
+    into the correction factor.
+*/
+int32_t loadgen_calib_run(  loadgen_calib_t *calib_p,
+                            double          us,
+                            int32_t         workfunc_state)
+{
+    long iterations;
+    int  closed_loop = (calib_p->tolerance > 0.0);
+
+    struct timespec start_ts, stop_ts;
+    double measured_us;
+
+    iterations = loadgen_calib_iterations(calib_p, us);
+
+    if(closed_loop)
+    {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_ts);
+    }
+
+    workfunc_state = loadgen_kernel_run(calib_p->kernel, iterations, workfunc_state);
+
+    if(closed_loop)
+    {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stop_ts);
+        measured_us = ((stop_ts.tv_sec - start_ts.tv_sec) * 1000000.0) +
+                      ((stop_ts.tv_nsec - start_ts.tv_nsec) / 1000.0);
+        loadgen_calib_feedback(calib_p, us, measured_us);
+    }
+
+    return workfunc_state;
+}
@@ -0,0 +1,102 @@
+#ifndef LOADGEN_CALIB_INCLUDE
+#define LOADGEN_CALIB_INCLUDE
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "loadgen_kernel.h"
+
+/*
+    Calibration of the load generator.
+
+    The number of kernel iterations per millisecond (ipms) is measured
+    separately on every CPU the process is allowed to run on, and is keyed by the
+    kernel (and the size of its array for the walk and mix kernels) and the
+    frequency the CPU was running at during the measurement. Measurements can be
+    cached in a text file, so that later runs on the same CPU and at the same
+    frequency skip the callibration runs. Frequencies are rounded to buckets of
+    LOADGEN_CALIB_FREQ_BUCKET_KHZ, since the frequency that is reported under
+    intel_pstate or amd-pstate hardly ever repeats exactly.
+
+    While jobs run, a helper thread reads the frequency of every CPU every
+    LOADGEN_CALIB_FREQ_PERIOD_NS from the scaling_cur_freq files, which are
+    opened at initialization, so the jobs themselves do no I/O. A CPU that
+    changed to a frequency with a calibration switches to it at the next job.
+    Otherwise it keeps its last calibration and the closed-loop correction has
+    to make up for the difference.
+
+    Optionally, the iteration count of every job can be corrected online, based
+    on the measured CPU time of the previous jobs (closed loop).
+*/
+
+/*width of the frequency buckets the calibrations are keyed by (100MHz)*/
+#define LOADGEN_CALIB_FREQ_BUCKET_KHZ   (100000)
+/*time between two reads of the frequencies by the helper thread (10ms)*/
+#define LOADGEN_CALIB_FREQ_PERIOD_NS    (10000000)
+
+/*gain of the closed-loop correction*/
+#define LOADGEN_CALIB_GAIN          (0.5)
+/*bounds on the closed-loop correction factor*/
+#define LOADGEN_CALIB_MIN_CORRECTION    (0.25)
+#define LOADGEN_CALIB_MAX_CORRECTION    (4.0)
+
+    typedef struct loadgen_calib_entry_s
+    {
+        int32_t kernel;
+        /*size of the array of the walk and mix kernels (0 for the others)*/
+        int64_t walk_kb;
+        int32_t cpu;
+        int64_t freq_khz;
+        double  ipms;
+    } loadgen_calib_entry_t;
+
+    typedef struct loadgen_calib_s
+    {
+        /*the calibrated kernel*/
+        loadgen_kernel_t        *kernel;
+        int64_t                 walk_kb;
+
+        /*entries loaded from or to be saved to the cache file*/
+        loadgen_calib_entry_t   *entries;
+        int32_t                 entry_count;
+
+        /*ipms of every CPU at the frequency measured at initialization
+        (negative for CPUs that are not in the affinity mask)*/
+        double                  *cpu_ipms;
+        int32_t                 cpu_count;
+        double                  default_ipms;
+
+        /*the last frequency bucket seen on every CPU*/
+        int64_t                 *cpu_freq_khz;
+        uint64_t                freq_switches;
+
+        /*the helper thread that follows the frequencies: the open
+        scaling_cur_freq files and the last bucket read from them*/
+        int                     *cpu_freq_fd;
+        int64_t                 *cpu_freq_now;
+        pthread_t               freq_thread;
+        int                     freq_thread_running;
+        int                     freq_stop;
+
+        /*closed-loop correction*/
+        double                  tolerance;
+        double                  correction;
+        uint64_t                adjustments;
+    } loadgen_calib_t;
+
+    int  loadgen_calib_init(loadgen_calib_t  *calib_p,
+                            loadgen_kernel_t *kernel_p,
+                            char             *cache_filename,
+                            double           tolerance);
+    void loadgen_calib_free(loadgen_calib_t *calib_p);
+
+    long loadgen_calib_iterations(loadgen_calib_t *calib_p, double us);
+    void loadgen_calib_feedback(loadgen_calib_t *calib_p,
+                                double          target_us,
+                                double          measured_us);
+
+    int32_t loadgen_calib_run(  loadgen_calib_t *calib_p,
+                                double          us,
+                                int32_t         workfunc_state);
+
+#endif
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOADGEN_X86
+#endif
+
+#include "loadgen.h"
+#include "loadgen_kernel.h"
+
+static char *loadgen_kernel_names[LOADGEN_KERNEL_COUNT] =
+    {"lcg", "fma", "walk", "branchy", "mix"};
+
+int loadgen_kernel_parse(char *name, int32_t *type_p)
+{
+    int32_t i;
+
+    for(i = 0; i < LOADGEN_KERNEL_COUNT; i++)
+    {
+        if(0 == strcmp(name, loadgen_kernel_names[i]))
+        {
+            *type_p = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+char* loadgen_kernel_name(int32_t type)
+{
+    if((type < 0) || (type >= LOADGEN_KERNEL_COUNT))
+    {
+        return "unknown";
+    }
+    return loadgen_kernel_names[type];
+}
+
+/*
+    8 independent multiply-add chains, enough to keep two FMA ports busy. Every
+    chain converges to 1.0, so the values never become denormal or overflow.
+*/
+#define LOADGEN_FMA_MUL (0.999999)
+#define LOADGEN_FMA_ADD (0.000001)
+
+#ifdef LOADGEN_X86
+__attribute__((target("avx2,fma")))
+static int32_t loadgen_kernel_fma_avx(long count, int32_t workfunc_state)
+{
+    long i;
+    int32_t j;
+    double  result[4];
+    __m256d mul = _mm256_set1_pd(LOADGEN_FMA_MUL);
+    __m256d add = _mm256_set1_pd(LOADGEN_FMA_ADD);
+    __m256d a[8];
+    __m256d sum;
+
+    for(j = 0; j < 8; j++)
+    {
+        a[j] = _mm256_set1_pd(1.0 + (double)((workfunc_state + j) & 0xff) * 1.0e-9);
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        a[0] = _mm256_fmadd_pd(a[0], mul, add);
+        a[1] = _mm256_fmadd_pd(a[1], mul, add);
+        a[2] = _mm256_fmadd_pd(a[2], mul, add);
+        a[3] = _mm256_fmadd_pd(a[3], mul, add);
+        a[4] = _mm256_fmadd_pd(a[4], mul, add);
+        a[5] = _mm256_fmadd_pd(a[5], mul, add);
+        a[6] = _mm256_fmadd_pd(a[6], mul, add);
+        a[7] = _mm256_fmadd_pd(a[7], mul, add);
+    }
+
+    sum = a[0];
+    for(j = 1; j < 8; j++)
+    {
+        sum = _mm256_add_pd(sum, a[j]);
+    }
+    _mm256_storeu_pd(result, sum);
+    return workfunc_state ^ (int32_t)(
+                (result[0] + result[1] + result[2] + result[3]) * 1.0e6);
+}
+#endif
+
+static int32_t loadgen_kernel_fma_scalar(long count, int32_t workfunc_state)
+{
+    long i;
+    int32_t j;
+    double  a[8];
+    double  sum = 0.0;
+
+    for(j = 0; j < 8; j++)
+    {
+        a[j] = 1.0 + (double)((workfunc_state + j) & 0xff) * 1.0e-9;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        for(j = 0; j < 8; j++)
+        {
+            a[j] = (a[j] * LOADGEN_FMA_MUL) + LOADGEN_FMA_ADD;
+        }
+    }
+
+    for(j = 0; j < 8; j++)
+    {
+        sum += a[j];
+    }
+    return workfunc_state ^ (int32_t)(sum * 1.0e6);
+}
+
+static int32_t loadgen_kernel_walk(loadgen_kernel_t *kernel_p,
+                                   long             count,
+                                   int32_t          workfunc_state)
+{
+    long i;
+    uint32_t index = kernel_p->walk_index;
+    uint32_t *walk_array = kernel_p->walk_array;
+
+    /*every load depends on the previous one*/
+    for(i = 0; i < count; i++)
+    {
+        index = walk_array[index];
+    }
+
+    kernel_p->walk_index = index;
+    return workfunc_state ^ (int32_t)index;
+}
+
+static int32_t loadgen_kernel_branchy(long count, int32_t workfunc_state)
+{
+    long i;
+    uint32_t x = (uint32_t)workfunc_state;
+    int32_t  acc = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        x = (x * 1664525u) + 1013904223u;
+        /*the top bit of the LCG is effectively random, the volatile asm keeps the
+        compiler from turning the branch into a conditional move*/
+        if(x & 0x80000000u)
+        {
+            __asm__ __volatile__("");
+            acc += (int32_t)(x >> 7);
+        }
+        else
+        {
+            acc ^= (int32_t)x;
+        }
+    }
+
+    return workfunc_state ^ acc;
+}
+
+static int32_t loadgen_kernel_run_single(loadgen_kernel_t *kernel_p,
+                                         int32_t          type,
+                                         long             count,
+                                         int32_t          workfunc_state)
+{
+    switch(type)
+    {
+        case LOADGEN_KERNEL_FMA:
+#ifdef LOADGEN_X86
+            if(kernel_p->have_fma)
+            {
+                return loadgen_kernel_fma_avx(count, workfunc_state);
+            }
+#endif
+            return loadgen_kernel_fma_scalar(count, workfunc_state);
+
+        case LOADGEN_KERNEL_WALK:
+            return loadgen_kernel_walk(kernel_p, count, workfunc_state);
+
+        case LOADGEN_KERNEL_BRANCHY:
+            return loadgen_kernel_branchy(count, workfunc_state);
+
+        default:
+            return work_function(count, workfunc_state);
+    }
+}
+
+int32_t loadgen_kernel_run( loadgen_kernel_t *kernel_p,
+                            long             count,
+                            int32_t          workfunc_state)
+{
+    int32_t type;
+    long    chunk;
+
+    if(LOADGEN_KERNEL_MIX != kernel_p->type)
+    {
+        return loadgen_kernel_run_single(kernel_p, kernel_p->type, count,
+                                         workfunc_state);
+    }
+
+    type = LOADGEN_KERNEL_LCG;
+    while(count > 0)
+    {
+        chunk = (count > LOADGEN_MIX_CHUNK)? LOADGEN_MIX_CHUNK : count;
+        workfunc_state = loadgen_kernel_run_single(kernel_p, type, chunk,
+                                                   workfunc_state);
+        count -= chunk;
+        type = (type + 1) % LOADGEN_KERNEL_MIX;
+    }
+
+    return workfunc_state;
+}
+
+/*
+    Allocate the walk array as a single random cycle (Sattolo's algorithm), so the
+    walk visits every entry and the hardware prefetcher can not follow it
+*/
+static int loadgen_kernel_init_walk(loadgen_kernel_t *kernel_p, size_t walk_kb)
+{
+    size_t   i, j;
+    uint32_t temp;
+    uint64_t rangen_state = 1;
+
+    kernel_p->walk_entries = (walk_kb * 1024) / sizeof(uint32_t);
+    if(kernel_p->walk_entries < 2)
+    {
+        kernel_p->walk_entries = 2;
+    }
+
+    kernel_p->walk_array = (uint32_t*)malloc(kernel_p->walk_entries * sizeof(uint32_t));
+    if(NULL == kernel_p->walk_array)
+    {
+        fprintf(stderr, "ERROR: loadgen_kernel_init_walk) malloc failed to allocate "
+                        "the walk array (%zu kB)\n", walk_kb);
+        return -1;
+    }
+
+    for(i = 0; i < kernel_p->walk_entries; i++)
+    {
+        kernel_p->walk_array[i] = (uint32_t)i;
+    }
+
+    for(i = kernel_p->walk_entries - 1; i > 0; i--)
+    {
+        rangen_state = (rangen_state * 6364136223846793005) + 1442695040888963407;
+        j = (size_t)((rangen_state >> 33) % i);
+
+        temp = kernel_p->walk_array[i];
+        kernel_p->walk_array[i] = kernel_p->walk_array[j];
+        kernel_p->walk_array[j] = temp;
+    }
+
+    kernel_p->walk_index = 0;
+    return 0;
+}
+
+int loadgen_kernel_init(loadgen_kernel_t *kernel_p,
+                        int32_t          type,
+                        size_t           walk_kb)
+{
+    memset(kernel_p, 0, sizeof(loadgen_kernel_t));
+
+    if((type < 0) || (type >= LOADGEN_KERNEL_COUNT))
+    {
+        fprintf(stderr, "ERROR: loadgen_kernel_init) unknown kernel %i\n", type);
+        return -1;
+    }
+    kernel_p->type = type;
+
+#ifdef LOADGEN_X86
+    kernel_p->have_fma = __builtin_cpu_supports("avx2") &&
+                         __builtin_cpu_supports("fma");
+#endif
+
+    if((LOADGEN_KERNEL_WALK == type) || (LOADGEN_KERNEL_MIX == type))
+    {
+        if(loadgen_kernel_init_walk(kernel_p, walk_kb) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void loadgen_kernel_free(loadgen_kernel_t *kernel_p)
+{
+    free(kernel_p->walk_array);
+    memset(kernel_p, 0, sizeof(loadgen_kernel_t));
+}
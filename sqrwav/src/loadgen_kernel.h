@@ -0,0 +1,60 @@
+#ifndef LOADGEN_KERNEL_INCLUDE
+#define LOADGEN_KERNEL_INCLUDE
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Job kernels of the load generator.
+
+    Every kernel executes a given number of iterations and stresses a different
+    resource of the CPU:
+    - lcg:     the scalar integer LCG of work_function (one ALU port)
+    - fma:     independent AVX2 FMA chains (scalar fallback without AVX2/FMA)
+    - walk:    dependent random walk through an array (cache resident if the
+               array fits)
+    - branchy: loop with data dependent, unpredictable branches
+    - mix:     all of the above, interleaved in chunks of LOADGEN_MIX_CHUNK
+               iterations
+    The cost of an iteration differs between the kernels, so every kernel needs
+    its own calibration.
+*/
+
+#define LOADGEN_KERNEL_LCG      (0)
+#define LOADGEN_KERNEL_FMA      (1)
+#define LOADGEN_KERNEL_WALK     (2)
+#define LOADGEN_KERNEL_BRANCHY  (3)
+#define LOADGEN_KERNEL_MIX      (4)
+#define LOADGEN_KERNEL_COUNT    (5)
+
+/*default size of the array of the walk kernel*/
+#define LOADGEN_WALK_DEFAULT_KB (16)
+/*iterations per kernel before the mix kernel switches to the next one*/
+#define LOADGEN_MIX_CHUNK       (1024)
+
+    typedef struct loadgen_kernel_s
+    {
+        int32_t     type;
+
+        /*fma kernel: use the AVX2/FMA code path*/
+        int         have_fma;
+
+        /*walk kernel: cyclic permutation of the array indices*/
+        uint32_t    *walk_array;
+        size_t      walk_entries;
+        uint32_t    walk_index;
+    } loadgen_kernel_t;
+
+    int     loadgen_kernel_parse(char *name, int32_t *type_p);
+    char*   loadgen_kernel_name(int32_t type);
+
+    int     loadgen_kernel_init(loadgen_kernel_t *kernel_p,
+                                int32_t          type,
+                                size_t           walk_kb);
+    void    loadgen_kernel_free(loadgen_kernel_t *kernel_p);
+
+    int32_t loadgen_kernel_run( loadgen_kernel_t *kernel_p,
+                                long             count,
+                                int32_t          workfunc_state);
+
+#endif
@@ -2,14 +2,55 @@
 #define SQRWAV_HEADER
 
 #include <stdint.h>
+#include <math.h>
+
+/*
+This file needs to be linked with -lm
+*/
+
+/*shape of the nominal value*/
+#define SQRWAV_SHAPE_SQUARE     (0)
+#define SQRWAV_SHAPE_LEVELS     (1)
+#define SQRWAV_SHAPE_MARKOV     (2)
+#define SQRWAV_SHAPE_SINE       (3)
+#define SQRWAV_SHAPE_SAWTOOTH   (4)
+
+/*distribution of the noise*/
+#define SQRWAV_NOISE_UNIFORM    (0)
+#define SQRWAV_NOISE_PARETO     (1)
+#define SQRWAV_NOISE_LOGNORMAL  (2)
+
+/*maximum number of phases (levels shape) or modes (markov shape)*/
+#define SQRWAV_MAX_LEVELS       (16)
+/*heavy-tailed noise is truncated at this multiple of noise_ratio*nominal_value*/
+#define SQRWAV_MAX_NOISE_FACTOR (100.0)
 
 struct sqrwav_struct
 {
+    int32_t     shape;
+
+    /*square, sine and sawtooth shapes*/
     uint64_t    period;
     double      duty_cycle;
     uint64_t    minimum_nominal_value;
-    uint64_t    maximum_nominal_value;    
+    uint64_t    maximum_nominal_value;
+
+    /*levels and markov shapes: the nominal value of every level, and its length
+    (levels) or minimum dwell time (markov) in jobs*/
+    int32_t     level_count;
+    uint64_t    level_value[SQRWAV_MAX_LEVELS];
+    uint64_t    level_length[SQRWAV_MAX_LEVELS];
+
+    /*markov shape: cumulative transition probabilities, one row per mode*/
+    int32_t     transition_rows;
+    double      transition_cdf[SQRWAV_MAX_LEVELS][SQRWAV_MAX_LEVELS];
+    int32_t     mode;
+    uint64_t    dwell_remaining;
+
+    int32_t     noise_type;
     double      noise_ratio;
+    /*pareto: tail index alpha, lognormal: sigma*/
+    double      noise_param;
 
     int64_t    index;
     uint64_t   rangen_state;
@@ -17,35 +58,262 @@ struct sqrwav_struct
 
 #define LCG_MAX (double)(~((uint64_t)0))
 
+static inline uint64_t sqrwav_lcg(struct sqrwav_struct *sqrwav_p)
+{
+    //generate the next random number (Knuth's 64bit LCG taken from wikipedia)
+    sqrwav_p->rangen_state = (sqrwav_p->rangen_state) * 6364136223846793005
+                                + 1442695040888963407;
+    return sqrwav_p->rangen_state;
+}
+
+/*uniform random number in (0, 1)*/
+static inline double sqrwav_uniform(struct sqrwav_struct *sqrwav_p)
+{
+    return ((double)(sqrwav_lcg(sqrwav_p) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/*
+    Add a level (phase or mode) with the given length in jobs and nominal value.
+    Returns -1 if there is no space left.
+*/
+static inline int sqrwav_add_level(struct sqrwav_struct *sqrwav_p,
+                                   uint64_t             length,
+                                   uint64_t             nominal_value)
+{
+    if(sqrwav_p->level_count >= SQRWAV_MAX_LEVELS)
+    {
+        return -1;
+    }
+
+    sqrwav_p->level_length[sqrwav_p->level_count] = length;
+    sqrwav_p->level_value[sqrwav_p->level_count] = nominal_value;
+    (sqrwav_p->level_count)++;
+    return 0;
+}
+
+/*
+    Add the next row of the markov transition matrix. The probabilities are
+    normalized, so only their ratios matter. Returns -1 if the row is invalid or
+    there is no space left.
+*/
+static inline int sqrwav_add_transition_row(struct sqrwav_struct *sqrwav_p,
+                                            double               *row,
+                                            int32_t              row_length)
+{
+    int32_t i;
+    double  sum = 0.0;
+    double  cumulative = 0.0;
+
+    if( (sqrwav_p->transition_rows >= SQRWAV_MAX_LEVELS) ||
+        (row_length > SQRWAV_MAX_LEVELS))
+    {
+        return -1;
+    }
+
+    for(i = 0; i < row_length; i++)
+    {
+        if(row[i] < 0.0)
+        {
+            return -1;
+        }
+        sum += row[i];
+    }
+    if(sum <= 0.0)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < SQRWAV_MAX_LEVELS; i++)
+    {
+        cumulative += (i < row_length)? (row[i] / sum) : 0.0;
+        sqrwav_p->transition_cdf[sqrwav_p->transition_rows][i] = cumulative;
+    }
+
+    (sqrwav_p->transition_rows)++;
+    return 0;
+}
+
+/*
+    Check that the parameters are consistent with the shape. Returns -1 and a
+    static description of the problem otherwise.
+*/
+static inline int sqrwav_check(struct sqrwav_struct *sqrwav_p, char **problem_p)
+{
+    int32_t i;
+
+    switch(sqrwav_p->shape)
+    {
+        case SQRWAV_SHAPE_LEVELS:
+        case SQRWAV_SHAPE_MARKOV:
+            if(0 == sqrwav_p->level_count)
+            {
+                *problem_p = "no levels are defined";
+                return -1;
+            }
+            for(i = 0; i < sqrwav_p->level_count; i++)
+            {
+                if(0 == sqrwav_p->level_length[i])
+                {
+                    *problem_p = "a level has a length of 0 jobs";
+                    return -1;
+                }
+            }
+            if( (SQRWAV_SHAPE_MARKOV == sqrwav_p->shape) &&
+                (sqrwav_p->transition_rows != sqrwav_p->level_count))
+            {
+                *problem_p = "the number of transition rows and levels differ";
+                return -1;
+            }
+            break;
+
+        default:
+            if(0 == sqrwav_p->period)
+            {
+                *problem_p = "the period is 0";
+                return -1;
+            }
+            break;
+    }
+
+    if( (SQRWAV_NOISE_UNIFORM != sqrwav_p->noise_type) &&
+        (sqrwav_p->noise_param <= 0.0))
+    {
+        *problem_p = "the noise parameter must be positive";
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline uint64_t sqrwav_nominal_levels(struct sqrwav_struct *sqrwav_p)
+{
+    int32_t  i;
+    uint64_t total_length = 0;
+    uint64_t aliased_index;
+
+    for(i = 0; i < sqrwav_p->level_count; i++)
+    {
+        total_length += sqrwav_p->level_length[i];
+    }
+
+    aliased_index = (sqrwav_p->index) % total_length;
+    for(i = 0; i < (sqrwav_p->level_count - 1); i++)
+    {
+        if(aliased_index < sqrwav_p->level_length[i])
+        {
+            break;
+        }
+        aliased_index -= sqrwav_p->level_length[i];
+    }
+
+    return sqrwav_p->level_value[i];
+}
+
+static inline uint64_t sqrwav_nominal_markov(struct sqrwav_struct *sqrwav_p)
+{
+    int32_t i;
+    double  u;
+
+    /*stay in the current mode for at least its dwell time, then draw the next*/
+    if(0 == sqrwav_p->dwell_remaining)
+    {
+        u = sqrwav_uniform(sqrwav_p);
+        for(i = 0; i < (sqrwav_p->level_count - 1); i++)
+        {
+            if(u < sqrwav_p->transition_cdf[sqrwav_p->mode][i])
+            {
+                break;
+            }
+        }
+        sqrwav_p->mode = i;
+        sqrwav_p->dwell_remaining = sqrwav_p->level_length[i];
+    }
+    (sqrwav_p->dwell_remaining)--;
+
+    return sqrwav_p->level_value[sqrwav_p->mode];
+}
+
+static inline double sqrwav_noise(struct sqrwav_struct *sqrwav_p, double max_noise)
+{
+    double u1, u2;
+    double x;
+
+    switch(sqrwav_p->noise_type)
+    {
+        case SQRWAV_NOISE_PARETO:
+            /*pareto distributed with x_m = 1, shifted to start at 0*/
+            u1 = sqrwav_uniform(sqrwav_p);
+            x = pow(u1, -1.0 / sqrwav_p->noise_param) - 1.0;
+            break;
+
+        case SQRWAV_NOISE_LOGNORMAL:
+            /*Box-Muller*/
+            u1 = sqrwav_uniform(sqrwav_p);
+            u2 = sqrwav_uniform(sqrwav_p);
+            x = exp(sqrwav_p->noise_param * sqrt(-2.0 * log(u1)) *
+                    cos(2.0 * M_PI * u2));
+            break;
+
+        default:
+            return (max_noise * (double)(sqrwav_lcg(sqrwav_p)))/LCG_MAX;
+    }
+
+    x = (x > SQRWAV_MAX_NOISE_FACTOR)? SQRWAV_MAX_NOISE_FACTOR : x;
+    return max_noise * x;
+}
+
 static uint64_t inline sqrwav_next(struct sqrwav_struct *sqrwav_p)
 {
     uint64_t aliased_index;
     uint64_t duty_cycle_length;
     uint64_t nominal_value;
+    double   phase;
 
     double max_noise, noise;
 
     uint64_t output;
 
-    duty_cycle_length = 
-        (uint64_t)(sqrwav_p->duty_cycle * (double)sqrwav_p->period);
+    switch(sqrwav_p->shape)
+    {
+        case SQRWAV_SHAPE_LEVELS:
+            nominal_value = sqrwav_nominal_levels(sqrwav_p);
+            break;
 
-    aliased_index = (sqrwav_p->index) % (sqrwav_p->period);
-    nominal_value = (aliased_index < duty_cycle_length)?
-                    sqrwav_p->maximum_nominal_value:
-                    sqrwav_p->minimum_nominal_value;
-    (sqrwav_p->index)++;
+        case SQRWAV_SHAPE_MARKOV:
+            nominal_value = sqrwav_nominal_markov(sqrwav_p);
+            break;
 
-    //generate the next random number (Knuth's 64bit LCG taken from wikipedia)
-    sqrwav_p->rangen_state = (sqrwav_p->rangen_state) * 6364136223846793005
-                                + 1442695040888963407;
+        case SQRWAV_SHAPE_SINE:
+        case SQRWAV_SHAPE_SAWTOOTH:
+            aliased_index = (sqrwav_p->index) % (sqrwav_p->period);
+            phase = (double)aliased_index / (double)sqrwav_p->period;
+            if(SQRWAV_SHAPE_SINE == sqrwav_p->shape)
+            {
+                phase = 0.5 + (0.5 * sin(2.0 * M_PI * phase));
+            }
+            nominal_value = (uint64_t)(
+                (double)sqrwav_p->minimum_nominal_value + (phase *
+                ((double)sqrwav_p->maximum_nominal_value -
+                 (double)sqrwav_p->minimum_nominal_value)));
+            break;
+
+        default:
+            duty_cycle_length =
+                (uint64_t)(sqrwav_p->duty_cycle * (double)sqrwav_p->period);
+
+            aliased_index = (sqrwav_p->index) % (sqrwav_p->period);
+            nominal_value = (aliased_index < duty_cycle_length)?
+                            sqrwav_p->maximum_nominal_value:
+                            sqrwav_p->minimum_nominal_value;
+            break;
+    }
+    (sqrwav_p->index)++;
 
     max_noise = sqrwav_p->noise_ratio * (double)nominal_value;
-    noise = (max_noise * (double)(sqrwav_p->rangen_state))/LCG_MAX;
+    noise = sqrwav_noise(sqrwav_p, max_noise);
 
-    output = nominal_value + noise;    
+    output = nominal_value + noise;
     return output;
 }
 
 #endif
-
@@ -0,0 +1,449 @@
+// workload_sweep
+//
+// a generic program to run a PeSoRTA workload on every point of a parameter sweep,
+// and to write one table with the job time statistics of all the points
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <stdint.h>
+
+#include <errno.h>
+
+#include <sched.h>
+
+#include <sys/mman.h>
+
+#include <sys/types.h>
+
+#include <time.h>
+
+#include "PeSoRTA.h"
+#include "PeSoRTA_helper.h"
+
+/*results of one point of the sweep, shared with the worker processes*/
+typedef struct sweep_result_s
+{
+    /*0: not run, 1: done, -1: failed*/
+    int32_t     status;
+    int32_t     cpu;
+    PeSoRTA_job_stats_t stats;
+} sweep_result_t;
+
+typedef struct sweep_shared_s
+{
+    /*the next point to be claimed by a worker*/
+    int64_t         next_point;
+    sweep_result_t  results[];
+} sweep_shared_t;
+
+/*what a worker needs to run the points*/
+typedef struct sweep_worker_s
+{
+    PeSoRTA_sweep_t *sweep_p;
+    sweep_shared_t  *shared_p;
+    unsigned char   jflag;
+    long            maxjobs;
+} sweep_worker_t;
+
+char *usage_string
+	= "[-j <maxjobs>] [-r] [ -R <workload root directory>] [-C <sweep config file>] "
+	  "[-L <results file>] [-N <worker processes>] [-P]";
+char *optstring = "j:rR:C:L:N:P";
+
+/*
+    Write the config file of the point to a temporary file, run the workload on it
+    and collect the job time statistics
+*/
+static int run_point(   PeSoRTA_sweep_t *sweep_p,
+                        int64_t         point,
+                        unsigned char   jflag,
+                        long            maxjobs,
+                        sweep_result_t  *result_p)
+{
+    int ret;
+
+    char    config_name[4096];
+    char    *tmpdir;
+    int     fd;
+    FILE    *config_h;
+
+    void    *workload_state = NULL;
+    long    possiblejobs;
+    long    jobs;
+    uint64_t *log_mem;
+
+    /*write the config file of the point*/
+    tmpdir = getenv("TMPDIR");
+    tmpdir = (NULL == tmpdir)? "/tmp" : tmpdir;
+    snprintf(config_name, sizeof(config_name), "%s/PeSoRTA_sweep_XXXXXX", tmpdir);
+
+    fd = mkstemp(config_name);
+    if(fd < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) run_point) mkstemp failed to create \"%s\" ",
+                        workload_name(), config_name);
+        perror("");
+        goto error0;
+    }
+
+    config_h = fdopen(fd, "w");
+    if(NULL == config_h)
+    {
+        perror("ERROR: run_point) fdopen failed");
+        close(fd);
+        goto error1;
+    }
+
+    ret = PeSoRTA_sweep_write(sweep_p, point, config_h);
+    if((0 != fclose(config_h)) || (ret < 0))
+    {
+        fprintf(stderr, "ERROR: (%s) run_point) failed to write the config file of "
+                        "point %lli\n", workload_name(), (long long)point);
+        goto error1;
+    }
+
+    /*Initialize the workload*/
+    ret = workload_init(config_name, &workload_state, &possiblejobs);
+    unlink(config_name);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) run_point) workload_init failed for point "
+                        "%lli\n", workload_name(), (long long)point);
+        goto error0;
+    }
+
+    /*Check if the workload returned a valid possiblejobs*/
+    if(possiblejobs < 0)
+    {
+        /*Set it to an arbitrarily high value*/
+        possiblejobs = 10000;
+    }
+
+    /*Check the number of jobs*/
+    if(jflag == 0)
+    {
+        maxjobs = possiblejobs;
+    }
+
+	/*Allocate space for the timing log_mem*/
+    log_mem = (uint64_t*)malloc(((maxjobs > 0)? maxjobs : 1) * sizeof(uint64_t));
+    if(NULL == log_mem)
+    {
+        fprintf(stderr, "ERROR: failed to allocate memory for timing log_mem\n");
+        perror("ERROR: malloc failed in run_point");
+        goto error2;
+    }
+
+	/* the main job loop */
+    ret = PeSoRTA_run_jobs(perform_job, workload_state, maxjobs, log_mem, &jobs);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: run_point) (%s) perform_job returned -1 for job "
+                        "%li of point %lli\n", workload_name(), jobs, (long long)point);
+        goto error3;
+    }
+
+    /*summarize the job times*/
+    memset(result_p, 0, sizeof(sweep_result_t));
+    result_p->cpu = sched_getcpu();
+    PeSoRTA_summarize_jobs(log_mem, jobs, &(result_p->stats));
+	free(log_mem);
+
+    /*a workload that could not complete its output fails the point too*/
+    if(workload_uninit(workload_state) < 0)
+    {
+        fprintf(stderr, "ERROR: run_point) (%s) workload_uninit failed for point "
+                        "%lli\n", workload_name(), (long long)point);
+        goto error0;
+    }
+    result_p->status = 1;
+    return 0;
+
+error3:
+	free(log_mem);
+error2:
+    workload_uninit(workload_state);
+    goto error0;
+error1:
+    unlink(config_name);
+error0:
+    result_p->status = -1;
+    return -1;
+}
+
+/*
+    Run points, until there are none left
+*/
+static void run_points(void *arg)
+{
+    sweep_worker_t  *worker_p = (sweep_worker_t*)arg;
+    PeSoRTA_sweep_t *sweep_p = worker_p->sweep_p;
+    sweep_shared_t  *shared_p = worker_p->shared_p;
+    int64_t         point;
+
+    while(1)
+    {
+        point = __atomic_fetch_add(&(shared_p->next_point), 1, __ATOMIC_RELAXED);
+        if(point >= sweep_p->point_count)
+        {
+            break;
+        }
+
+        run_point(sweep_p, point, worker_p->jflag, worker_p->maxjobs,
+                  &(shared_p->results[point]));
+    }
+}
+
+static int write_results(   char            *results_name,
+                            PeSoRTA_sweep_t *sweep_p,
+                            sweep_shared_t  *shared_p)
+{
+    FILE    *results_h;
+    int64_t point;
+    int32_t axis;
+    char    value[256];
+    sweep_result_t *result_p;
+
+    results_h = fopen(results_name, "w");
+    if(NULL == results_h)
+    {
+        fprintf(stderr, "ERROR: Failed to open results file \"%s\"!\n", results_name);
+        perror("ERROR: fopen failed in write_results");
+        return -1;
+    }
+
+    fprintf(results_h, "point,");
+    for(axis = 0; axis < sweep_p->axis_count; axis++)
+    {
+        fprintf(results_h, "-%c,", sweep_p->axes[axis].opt);
+    }
+    fprintf(results_h, "status,cpu,jobs,total_ns,mean_ns,min_ns,p50_ns,p99_ns,max_ns\n");
+
+    for(point = 0; point < sweep_p->point_count; point++)
+    {
+        result_p = &(shared_p->results[point]);
+
+        fprintf(results_h, "%lli,", (long long)point);
+        for(axis = 0; axis < sweep_p->axis_count; axis++)
+        {
+            PeSoRTA_sweep_value(sweep_p, axis, point, value, sizeof(value));
+            fprintf(results_h, "%s,", value);
+        }
+
+        if(1 != result_p->status)
+        {
+            fprintf(results_h, "failed,,,,,,,,\n");
+            continue;
+        }
+
+        fprintf(results_h, "ok,%i,%li,%lu,%.1f,%lu,%lu,%lu,%lu\n",
+                result_p->cpu, result_p->stats.jobs, result_p->stats.total_ns,
+                (result_p->stats.jobs > 0)?
+                    ((double)result_p->stats.total_ns/(double)result_p->stats.jobs) : 0.0,
+                result_p->stats.min_ns, result_p->stats.p50_ns, result_p->stats.p99_ns,
+                result_p->stats.max_ns);
+    }
+
+    if(0 != fclose(results_h))
+    {
+        perror("ERROR: fclose failed in write_results");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main (int argc, char * const * argv)
+{
+	int ret;
+
+    /*variables for parsing options*/
+	unsigned char jflag = 0;
+	long maxjobs = 0;
+    unsigned char rflag = 0;
+    unsigned char pflag = 0;
+    int worker_count = 1;
+
+    char *workload_root_dir = "./";
+    char *config_file = "config";
+    char *results_name = "sweep.csv";
+
+    /*working directory*/
+    char    cwd_name[4096];
+
+    /*the sweep and its results*/
+    PeSoRTA_sweep_t sweep;
+    sweep_shared_t  *shared_p;
+    size_t          shared_size;
+    int64_t         point;
+    int64_t         failed = 0;
+    sweep_worker_t  worker;
+
+	/* process input arguments */
+	while ((ret = getopt(argc, argv, optstring)) != -1)
+	{
+		switch(ret)
+		{
+			case 'j':
+				errno = 0;
+				maxjobs = strtol(optarg, NULL, 10);
+				if(errno)
+				{
+					perror("Failed to parse the j option");
+					exit(EXIT_FAILURE);
+				}
+				jflag = 1;
+				break;
+
+            case 'r':
+                rflag = 1;
+                break;
+
+            case 'R':
+                workload_root_dir = optarg;
+                break;
+
+            case 'C':
+                config_file = optarg;
+                break;
+
+            case 'L':
+                results_name = optarg;
+                break;
+
+            case 'N':
+                worker_count = (int)strtol(optarg, NULL, 10);
+                if(worker_count < 1)
+                {
+                    fprintf(stderr, "ERROR: the number of workers must be positive\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'P':
+                pflag = 1;
+                break;
+
+			default:
+				fprintf(stderr, "ERROR: Bad option %c!\nUsage %s %s!\n",
+				                (char)ret, argv[0], usage_string);
+				ret = -EINVAL;
+				goto exit0;
+		}
+	}
+
+	if(optind != argc)
+	{
+		fprintf(stderr, "ERROR: Usage %s %s!\n", argv[0], usage_string);
+		ret = -EINVAL;
+		goto exit0;
+	}
+
+    /*Save the current working directory*/
+    if(NULL == getcwd(cwd_name, sizeof(cwd_name)))
+    {
+        fprintf(stderr, "ERROR: (%s) main)  getcwd failed ", workload_name());
+        perror("");
+        ret = -1;
+        goto exit0;
+    }
+
+    /*Cheange to the desired working directory*/
+    ret = chdir(workload_root_dir);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) main)  getcwd failed to change the current working "
+                        "directory to the desired directory \"%s\" ",
+                        workload_name(), workload_root_dir);
+        perror("");
+        ret = -1;
+        goto exit0;
+    }
+
+    /*Expand the sweep*/
+    ret = PeSoRTA_sweep_load(config_file, &sweep);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) main) PeSoRTA_sweep_load failed\n",
+                        workload_name());
+        goto exit0;
+    }
+
+    /*the results are written by the worker processes*/
+    shared_size = sizeof(sweep_shared_t) + sweep.point_count * sizeof(sweep_result_t);
+    shared_p = (sweep_shared_t*)mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == shared_p)
+    {
+        perror("ERROR: mmap failed in main");
+        ret = -1;
+        goto exit1;
+    }
+
+    fprintf(stderr, "%s: running %lli points on %i worker(s)\n", workload_name(),
+                    (long long)sweep.point_count, worker_count);
+
+    worker.sweep_p  = &sweep;
+    worker.shared_p = shared_p;
+    worker.jflag    = jflag;
+    worker.maxjobs  = maxjobs;
+
+    if(1 == worker_count)
+    {
+        /*run every point in this process*/
+        if((rflag == 1) && (PeSoRTA_set_realtime() < 0))
+        {
+            ret = -1;
+            goto exit2;
+        }
+        run_points(&worker);
+        if(rflag == 1)
+        {
+            munlockall();
+        }
+    }
+    else
+    {
+        /*the points of a crashed worker remain unfinished, and are reported as
+        failed below*/
+        PeSoRTA_run_workers(run_points, &worker, rflag, worker_count, pflag);
+    }
+
+    /*Cheange back to the original working directory*/
+    ret = chdir(cwd_name);
+    if(ret < 0)
+    {
+        fprintf(stderr, "ERROR: (%s) main)  getcwd failed to change the current working "
+                        "directory to the desired directory \"%s\" ",
+                        workload_name(), cwd_name);
+        perror("");
+        ret = -1;
+        goto exit2;
+    }
+
+    ret = write_results(results_name, &sweep, shared_p);
+
+    for(point = 0; point < sweep.point_count; point++)
+    {
+        failed += (1 != shared_p->results[point].status);
+    }
+    if(failed > 0)
+    {
+        fprintf(stderr, "ERROR: (%s) main) %lli of %lli points failed\n",
+                        workload_name(), (long long)failed,
+                        (long long)sweep.point_count);
+        ret = -1;
+    }
+
+    /*undo everything*/
+exit2:
+    munmap(shared_p, shared_size);
+exit1:
+    PeSoRTA_sweep_free(&sweep);
+exit0:
+	return (ret < 0)? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -50,8 +50,9 @@ static __inline__ uint64_t getns(void)
 #include "PeSoRTA.h"
 
 char *usage_string 
-	= "[-j <maxjobs>] [-r] [ -R <workload root directory>] [-C <config file>] [-L <output file>]";
-char *optstring = "j:rR:C:L:";
+	= "[-j <maxjobs>] [-r] [ -R <workload root directory>] [-C <config file>] [-L <output file>] "
+	  "[-Q <quality level>] [-B <job budget (ns)>]";
+char *optstring = "j:rR:C:L:Q:B:";
 
 int main (int argc, char * const * argv)
 {
@@ -66,6 +67,15 @@ int main (int argc, char * const * argv)
     char *config_file = "config";
     char *logfile_name = "timing.csv";
 
+    /*quality control, with a budget the level is raised by one after every job
+    over the budget, and lowered by one (down to the -Q level) after every job
+    under half the budget*/
+    unsigned char Qflag = 0;
+    int base_level = 0;
+    int level = 0;
+    uint64_t budget_ns = 0;
+    int *level_mem = NULL;
+
     /*working directory*/
     void    *buffer_p = NULL;
     char    *cwd_name_buffer = NULL;
@@ -120,6 +130,28 @@ int main (int argc, char * const * argv)
 
             case 'L':
                 logfile_name = optarg;
+                break;
+
+            case 'Q':
+				errno = 0;
+				base_level = (int)strtol(optarg, NULL, 10);
+				if(errno || (base_level < 0))
+				{
+					fprintf(stderr, "ERROR: Failed to parse the Q option\n");
+					exit(EXIT_FAILURE);
+				}
+                Qflag = 1;
+                break;
+
+            case 'B':
+				errno = 0;
+				budget_ns = strtoull(optarg, NULL, 10);
+				if(errno)
+				{
+					perror("Failed to parse the B option");
+					exit(EXIT_FAILURE);
+				}
+                Qflag = 1;
                 break;
                 
 			default:
@@ -193,6 +225,15 @@ int main (int argc, char * const * argv)
         goto exit0;
     }
     
+    /*Check if the workload has quality levels*/
+    if((Qflag == 1) && (NULL == workload_set_quality))
+    {
+        fprintf(stderr, "ERROR: (%s) main) the workload has no quality levels "
+                        "(workload_set_quality)\n", workload_name());
+        goto exit1;
+    }
+    level = base_level;
+
     /*Check if the workload returned a valid possiblejobs*/
     if(possiblejobs < 0)
     {
@@ -215,6 +256,17 @@ int main (int argc, char * const * argv)
         goto exit1;
     }
 
+    if(Qflag == 1)
+    {
+        level_mem = (int*)malloc(maxjobs * sizeof(int));
+        if(NULL == level_mem)
+        {
+            fprintf(stderr, "ERROR: failed to allocate memory for the quality levels\n");
+            perror("ERROR: malloc failed in main");
+            goto exit2;
+        }
+    }
+
     if(rflag == 1)
     {
         ret = mlockall(MCL_CURRENT);
@@ -246,6 +298,22 @@ int main (int argc, char * const * argv)
 	/* the main job loop */
 	for(jobi = 0; jobi < maxjobs; jobi++)
 	{
+	    /*set the quality level of the next job, outside of the timed section*/
+	    if(Qflag == 1)
+	    {
+	        ret = workload_set_quality(workload_state, level);
+	        if(ret < 0)
+	        {
+                fprintf(stderr, "ERROR: main) (%s) workload_set_quality failed for "
+                                "level %i\n", workload_name(), level);
+                maxjobs = jobi;
+                break;
+	        }
+	        /*the workload clamps the level to its lowest quality*/
+	        level = ret;
+	        level_mem[jobi] = level;
+	    }
+
 	    /*run and time the next job*/
 		ns_start = getns();
 		ret = perform_job(workload_state);
@@ -270,6 +338,19 @@ int main (int argc, char * const * argv)
         ns_diff = ns_end - ns_start;
 
         log_mem[jobi] = ns_diff;
+
+        /*adapt the quality level to the cost of the job*/
+        if(budget_ns > 0)
+        {
+            if(ns_diff > budget_ns)
+            {
+                level++;
+            }
+            else if((ns_diff < budget_ns/2) && (level > base_level))
+            {
+                level--;
+            }
+        }
 	}
 
     /*Cheange back to the original working directory*/
@@ -296,7 +377,15 @@ int main (int argc, char * const * argv)
     /*write the log_mem out to file*/
     for(jobi = 0; jobi < maxjobs; jobi++)
     {
-        ret = fprintf(logfile_h, "%lu,\n", log_mem[jobi]);
+        if(Qflag == 1)
+        {
+            /*the job time and the quality level of the job*/
+            ret = fprintf(logfile_h, "%lu,%i,\n", log_mem[jobi], level_mem[jobi]);
+        }
+        else
+        {
+            ret = fprintf(logfile_h, "%lu,\n", log_mem[jobi]);
+        }
         if(ret < 0)
         {
             fprintf(stderr, "ERROR: Failed to write log index %li to log file!\n", jobi);
@@ -314,6 +403,7 @@ exit3:
         munlockall();
     }
 exit2:
+	free(level_mem);
 	free(log_mem);
 exit1:    
     workload_uninit(workload_state);